@@ -47,6 +47,7 @@
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
 #include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Dynamics/b2WorldSnapshot.h>
 
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
 
@@ -22,9 +22,10 @@
 #include <memory.h>
 #include <stddef.h>
 #include <string.h>
+#include <mutex>
 #include <new> // For placement new
 
-int32 b2BlockAllocator::s_blockSizes[b2_blockSizes] =
+static constexpr int32 s_blockSizes[b2_blockSizes] =
 {
 	16,		// 0
 	32,		// 1
@@ -41,8 +42,28 @@ int32 b2BlockAllocator::s_blockSizes[b2_blockSizes] =
 	512,	// 12
 	640,	// 13
 };
-uint8 b2BlockAllocator::s_blockSizeLookup[b2_maxBlockSize + 1];
-bool b2BlockAllocator::s_blockSizeLookupInitialized;
+
+// Maps an allocation size to its size class. Built at compile time so that
+// allocators may be constructed concurrently without racing on a lazy init.
+struct b2BlockSizeLookup
+{
+	constexpr b2BlockSizeLookup() : values()
+	{
+		int32 j = 0;
+		for (int32 i = 1; i <= b2_maxBlockSize; ++i)
+		{
+			if (i > s_blockSizes[j])
+			{
+				++j;
+			}
+			values[i] = (uint8)j;
+		}
+	}
+
+	uint8 values[b2_maxBlockSize + 1];
+};
+
+static constexpr b2BlockSizeLookup s_blockSizeLookup;
 
 struct b2Chunk
 {
@@ -55,6 +76,40 @@ struct b2Block
 	b2Block* next;
 };
 
+struct b2BlockAllocatorLock
+{
+	std::mutex mutex;
+};
+
+// The cache bound to the calling thread, see b2BlockAllocatorCache.
+static thread_local b2BlockAllocatorCache* s_currentCache = NULL;
+
+// Locks the depot of a thread-safe allocator for the current scope. Does
+// nothing when the allocator is single-threaded.
+class b2DepotLock
+{
+public:
+	b2DepotLock(b2BlockAllocatorLock* lock)
+	{
+		m_mutex = lock ? &lock->mutex : NULL;
+		if (m_mutex)
+		{
+			m_mutex->lock();
+		}
+	}
+
+	~b2DepotLock()
+	{
+		if (m_mutex)
+		{
+			m_mutex->unlock();
+		}
+	}
+
+private:
+	std::mutex* m_mutex;
+};
+
 b2BlockAllocator::b2BlockAllocator()
 {
 	b2Assert((uint32)b2_blockSizes < UCHAR_MAX);
@@ -66,43 +121,77 @@ b2BlockAllocator::b2BlockAllocator()
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
 
-	if (s_blockSizeLookupInitialized == false)
-	{
-		int32 j = 0;
-		for (int32 i = 1; i <= b2_maxBlockSize; ++i)
-		{
-			b2Assert(j < b2_blockSizes);
-			if (i <= s_blockSizes[j])
-			{
-				s_blockSizeLookup[i] = (uint8)j;
-			}
-			else
-			{
-				++j;
-				s_blockSizeLookup[i] = (uint8)j;
-			}
-		}
+	memset(m_allocationCounts, 0, sizeof(m_allocationCounts));
+	memset(m_freeCounts, 0, sizeof(m_freeCounts));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
 
-		s_blockSizeLookupInitialized = true;
-	}
+	m_lock = NULL;
+	m_cacheCount = 0;
 }
 
 b2BlockAllocator::~b2BlockAllocator()
 {
+	b2Assert(m_cacheCount == 0);
+
 	for (int32 i = 0; i < m_chunkCount; ++i)
 	{
 		b2Free(m_chunks[i].blocks);
 	}
 
 	b2Free(m_chunks);
+	SetThreadSafe(false);
 }
 
 uint32 b2BlockAllocator::GetNumGiantAllocations() const
 {
+	b2DepotLock lock(m_lock);
 	return m_giants.GetList().GetLength();
 }
 
+void b2BlockAllocator::SetThreadSafe(bool flag)
+{
+	b2Assert(m_cacheCount == 0);
+	if (flag && m_lock == NULL)
+	{
+		m_lock = new (b2Alloc(sizeof(b2BlockAllocatorLock))) b2BlockAllocatorLock;
+	}
+	else if (!flag && m_lock)
+	{
+		m_lock->~b2BlockAllocatorLock();
+		b2Free(m_lock);
+		m_lock = NULL;
+	}
+}
+
+void b2BlockAllocator::GetStats(b2BlockAllocatorStats* stats) const
+{
+	b2DepotLock lock(m_lock);
+	for (int32 i = 0; i < b2_blockSizes; ++i)
+	{
+		stats->blockSizes[i] = s_blockSizes[i];
+		stats->allocations[i] = m_allocationCounts[i];
+		stats->frees[i] = m_freeCounts[i];
+		stats->chunks[i] = m_chunkCounts[i];
+	}
+	stats->giantAllocations = m_giants.GetList().GetLength();
+}
+
 void* b2BlockAllocator::Allocate(int32 size)
+{
+	if (m_lock)
+	{
+		b2BlockAllocatorCache* cache = s_currentCache;
+		if (cache && cache->m_allocator == this)
+		{
+			return cache->Allocate(size);
+		}
+	}
+
+	b2DepotLock lock(m_lock);
+	return AllocateFromDepot(size);
+}
+
+void* b2BlockAllocator::AllocateFromDepot(int32 size)
 {
 	if (size == 0)
 		return NULL;
@@ -114,53 +203,103 @@ void* b2BlockAllocator::Allocate(int32 size)
 		return m_giants.Allocate(size);
 	}
 
-	int32 index = s_blockSizeLookup[size];
+	int32 index = s_blockSizeLookup.values[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
 
-	if (m_freeLists[index])
+	if (m_freeLists[index] == NULL)
 	{
-		b2Block* block = m_freeLists[index];
-		m_freeLists[index] = block->next;
-		return block;
+		AddChunk(index);
 	}
-	else
+
+	b2Block* block = m_freeLists[index];
+	m_freeLists[index] = block->next;
+	++m_allocationCounts[index];
+	return block;
+}
+
+void b2BlockAllocator::AddChunk(int32 index)
+{
+	if (m_chunkCount == m_chunkSpace)
 	{
-		if (m_chunkCount == m_chunkSpace)
-		{
-			b2Chunk* oldChunks = m_chunks;
-			m_chunkSpace += b2_chunkArrayIncrement;
-			m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
-			memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(b2Chunk));
-			memset(m_chunks + m_chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
-			b2Free(oldChunks);
-		}
+		b2Chunk* oldChunks = m_chunks;
+		m_chunkSpace += b2_chunkArrayIncrement;
+		m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
+		memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(b2Chunk));
+		memset(m_chunks + m_chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
+		b2Free(oldChunks);
+	}
 
-		b2Chunk* chunk = m_chunks + m_chunkCount;
-		chunk->blocks = (b2Block*)b2Alloc(b2_chunkSize);
+	b2Chunk* chunk = m_chunks + m_chunkCount;
+	chunk->blocks = (b2Block*)b2Alloc(b2_chunkSize);
 #if DEBUG
-		memset(chunk->blocks, 0xcd, b2_chunkSize);
+	memset(chunk->blocks, 0xcd, b2_chunkSize);
 #endif
-		int32 blockSize = s_blockSizes[index];
-		chunk->blockSize = blockSize;
-		int32 blockCount = b2_chunkSize / blockSize;
-		b2Assert(blockCount * blockSize <= b2_chunkSize);
-		for (int32 i = 0; i < blockCount - 1; ++i)
-		{
-			b2Block* block = (b2Block*)((int8*)chunk->blocks + blockSize * i);
-			b2Block* next = (b2Block*)((int8*)chunk->blocks + blockSize * (i + 1));
-			block->next = next;
-		}
-		b2Block* last = (b2Block*)((int8*)chunk->blocks + blockSize * (blockCount - 1));
-		last->next = NULL;
+	int32 blockSize = s_blockSizes[index];
+	chunk->blockSize = blockSize;
+	int32 blockCount = b2_chunkSize / blockSize;
+	b2Assert(blockCount * blockSize <= b2_chunkSize);
+	for (int32 i = 0; i < blockCount - 1; ++i)
+	{
+		b2Block* block = (b2Block*)((int8*)chunk->blocks + blockSize * i);
+		b2Block* next = (b2Block*)((int8*)chunk->blocks + blockSize * (i + 1));
+		block->next = next;
+	}
+	b2Block* last = (b2Block*)((int8*)chunk->blocks + blockSize * (blockCount - 1));
+	last->next = m_freeLists[index];
 
-		m_freeLists[index] = chunk->blocks->next;
-		++m_chunkCount;
+	m_freeLists[index] = chunk->blocks;
+	++m_chunkCount;
+	++m_chunkCounts[index];
+}
+
+int32 b2BlockAllocator::TakeBatch(int32 index, int32 count, b2Block** head)
+{
+	b2Assert(0 < count);
 
-		return chunk->blocks;
+	if (m_freeLists[index] == NULL)
+	{
+		AddChunk(index);
+	}
+
+	b2Block* block = m_freeLists[index];
+	b2Block* tail = NULL;
+	int32 taken = 0;
+	*head = block;
+	while (block && taken < count)
+	{
+		tail = block;
+		block = block->next;
+		++taken;
 	}
+
+	tail->next = NULL;
+	m_freeLists[index] = block;
+	return taken;
+}
+
+void b2BlockAllocator::ReturnBatch(int32 index, b2Block* head, b2Block* tail)
+{
+	tail->next = m_freeLists[index];
+	m_freeLists[index] = head;
 }
 
 void b2BlockAllocator::Free(void* p, int32 size)
+{
+	if (m_lock)
+	{
+		b2BlockAllocatorCache* cache = s_currentCache;
+		if (cache && cache->m_allocator == this)
+		{
+			cache->Free(p, size);
+			return;
+		}
+	}
+
+	b2DepotLock lock(m_lock);
+	FreeToDepot(p, size);
+}
+
+void b2BlockAllocator::FreeToDepot(void* p, int32 size)
 {
 	if (size == 0)
 	{
@@ -175,9 +314,23 @@ void b2BlockAllocator::Free(void* p, int32 size)
 		return;
 	}
 
-	int32 index = s_blockSizeLookup[size];
+	int32 index = s_blockSizeLookup.values[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
 
+	ValidateBlock(p, index);
+
+#if DEBUG
+	memset(p, 0xfd, s_blockSizes[index]);
+#endif
+
+	b2Block* block = (b2Block*)p;
+	block->next = m_freeLists[index];
+	m_freeLists[index] = block;
+	++m_freeCounts[index];
+}
+
+void b2BlockAllocator::ValidateBlock(void* p, int32 index) const
+{
 #if B2_ASSERT_ENABLED
 	// Verify the memory address and size is valid.
 	int32 blockSize = s_blockSizes[index];
@@ -200,19 +353,16 @@ void b2BlockAllocator::Free(void* p, int32 size)
 	}
 
 	b2Assert(found);
+#else
+	B2_NOT_USED(p);
+	B2_NOT_USED(index);
 #endif // B2_ASSERT_ENABLED
-
-#if DEBUG
-	memset(p, 0xfd, s_blockSizes[index]);
-#endif
-
-	b2Block* block = (b2Block*)p;
-	block->next = m_freeLists[index];
-	m_freeLists[index] = block;
 }
 
 void b2BlockAllocator::Clear()
 {
+	b2Assert(m_cacheCount == 0);
+
 	for (int32 i = 0; i < m_chunkCount; ++i)
 	{
 		b2Free(m_chunks[i].blocks);
@@ -222,4 +372,163 @@ void b2BlockAllocator::Clear()
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+
+	memset(m_allocationCounts, 0, sizeof(m_allocationCounts));
+	memset(m_freeCounts, 0, sizeof(m_freeCounts));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+}
+
+b2BlockAllocatorCache::b2BlockAllocatorCache(b2BlockAllocator* allocator)
+{
+	b2Assert(allocator->IsThreadSafe());
+
+	m_allocator = allocator;
+	memset(m_freeLists, 0, sizeof(m_freeLists));
+	memset(m_cachedCounts, 0, sizeof(m_cachedCounts));
+	memset(m_pendingAllocations, 0, sizeof(m_pendingAllocations));
+	memset(m_pendingFrees, 0, sizeof(m_pendingFrees));
+
+	{
+		b2DepotLock lock(m_allocator->m_lock);
+		++m_allocator->m_cacheCount;
+	}
+
+	// Bind to the calling thread.
+	m_previous = s_currentCache;
+	s_currentCache = this;
+}
+
+b2BlockAllocatorCache::~b2BlockAllocatorCache()
+{
+	Flush();
+
+	{
+		b2DepotLock lock(m_allocator->m_lock);
+		--m_allocator->m_cacheCount;
+	}
+
+	b2Assert(s_currentCache == this);
+	s_currentCache = m_previous;
+}
+
+b2BlockAllocatorCache* b2BlockAllocatorCache::GetCurrent()
+{
+	return s_currentCache;
+}
+
+void b2BlockAllocatorCache::Publish(int32 index)
+{
+	m_allocator->m_allocationCounts[index] += m_pendingAllocations[index];
+	m_allocator->m_freeCounts[index] += m_pendingFrees[index];
+	m_pendingAllocations[index] = 0;
+	m_pendingFrees[index] = 0;
+}
+
+void* b2BlockAllocatorCache::Allocate(int32 size)
+{
+	if (size == 0)
+		return NULL;
+
+	b2Assert(0 < size);
+
+	if (size > b2_maxBlockSize)
+	{
+		b2DepotLock lock(m_allocator->m_lock);
+		return m_allocator->AllocateFromDepot(size);
+	}
+
+	int32 index = s_blockSizeLookup.values[size];
+	b2Assert(0 <= index && index < b2_blockSizes);
+
+	if (m_freeLists[index] == NULL)
+	{
+		// Refill from the shared allocator and publish our counters while
+		// we hold the lock anyway.
+		b2DepotLock lock(m_allocator->m_lock);
+		m_cachedCounts[index] = m_allocator->TakeBatch(
+			index, b2_blockCacheBatchSize, &m_freeLists[index]);
+		Publish(index);
+	}
+
+	b2Block* block = m_freeLists[index];
+	m_freeLists[index] = block->next;
+	--m_cachedCounts[index];
+	++m_pendingAllocations[index];
+	return block;
+}
+
+void b2BlockAllocatorCache::Free(void* p, int32 size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	b2Assert(0 < size);
+
+	if (size > b2_maxBlockSize)
+	{
+		b2DepotLock lock(m_allocator->m_lock);
+		m_allocator->FreeToDepot(p, size);
+		return;
+	}
+
+	int32 index = s_blockSizeLookup.values[size];
+	b2Assert(0 <= index && index < b2_blockSizes);
+
+#if B2_ASSERT_ENABLED
+	{
+		// Other threads may be adding chunks.
+		b2DepotLock lock(m_allocator->m_lock);
+		m_allocator->ValidateBlock(p, index);
+	}
+#endif // B2_ASSERT_ENABLED
+
+#if DEBUG
+	memset(p, 0xfd, s_blockSizes[index]);
+#endif
+
+	b2Block* block = (b2Block*)p;
+	block->next = m_freeLists[index];
+	m_freeLists[index] = block;
+	++m_cachedCounts[index];
+	++m_pendingFrees[index];
+
+	if (m_cachedCounts[index] >= 2 * b2_blockCacheBatchSize)
+	{
+		// Keep one batch for this thread and hand the rest back.
+		b2Block* head = m_freeLists[index];
+		b2Block* tail = head;
+		for (int32 i = 1; i < b2_blockCacheBatchSize; ++i)
+		{
+			tail = tail->next;
+		}
+		m_freeLists[index] = tail->next;
+		m_cachedCounts[index] -= b2_blockCacheBatchSize;
+
+		b2DepotLock lock(m_allocator->m_lock);
+		m_allocator->ReturnBatch(index, head, tail);
+		Publish(index);
+	}
+}
+
+void b2BlockAllocatorCache::Flush()
+{
+	b2DepotLock lock(m_allocator->m_lock);
+	for (int32 index = 0; index < b2_blockSizes; ++index)
+	{
+		b2Block* head = m_freeLists[index];
+		if (head)
+		{
+			b2Block* tail = head;
+			while (tail->next)
+			{
+				tail = tail->next;
+			}
+			m_allocator->ReturnBatch(index, head, tail);
+		}
+		m_freeLists[index] = NULL;
+		m_cachedCounts[index] = 0;
+		Publish(index);
+	}
 }
@@ -27,12 +27,39 @@ const int32 b2_maxBlockSize = 640;
 const int32 b2_blockSizes = 14;
 const int32 b2_chunkArrayIncrement = 128;
 
+/// Number of blocks moved between a b2BlockAllocatorCache and its shared
+/// allocator in one locked transfer.
+const int32 b2_blockCacheBatchSize = 32;
+
 struct b2Block;
 struct b2Chunk;
+struct b2BlockAllocatorLock;
+class b2BlockAllocatorCache;
+
+/// Allocation counters of a b2BlockAllocator, one entry per size class.
+struct b2BlockAllocatorStats
+{
+	/// Size in bytes of the blocks in each size class.
+	int32 blockSizes[b2_blockSizes];
+	/// Number of blocks handed out by each size class.
+	uint32 allocations[b2_blockSizes];
+	/// Number of blocks returned to each size class.
+	uint32 frees[b2_blockSizes];
+	/// Number of chunks carved into blocks of each size class.
+	int32 chunks[b2_blockSizes];
+	/// Number of live allocations larger than b2_maxBlockSize.
+	uint32 giantAllocations;
+};
 
 /// This is a small object allocator used for allocating small
 /// objects that persist for more than one time step.
 /// See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
+///
+/// By default the allocator must only be used from one thread. After
+/// SetThreadSafe(true) it acts as a shared depot: threads that own a
+/// b2BlockAllocatorCache bound to it allocate from per-thread free lists
+/// and only lock the depot to move whole batches of blocks, while threads
+/// without a cache lock on every call.
 class b2BlockAllocator
 {
 public:
@@ -50,7 +77,38 @@ public:
 	/// Returns the number of allocations larger than the max block size.
 	uint32 GetNumGiantAllocations() const;
 
+	/// Enable/disable locking so the allocator can be shared between
+	/// threads. This must not be changed while caches are bound to it.
+	void SetThreadSafe(bool flag);
+	bool IsThreadSafe() const { return m_lock != NULL; }
+
+	/// Get the per size class allocation counters. Counts made by a
+	/// b2BlockAllocatorCache are included once it has exchanged a batch
+	/// with the allocator or been flushed.
+	void GetStats(b2BlockAllocatorStats* stats) const;
+
 private:
+	friend class b2BlockAllocatorCache;
+
+	// Allocate / free without consulting the calling thread's cache.
+	// The caller holds the lock when the allocator is thread-safe.
+	void* AllocateFromDepot(int32 size);
+	void FreeToDepot(void* p, int32 size);
+
+	// Carve a new chunk into blocks of the size class and push them on
+	// the depot free list.
+	void AddChunk(int32 index);
+
+	// Move up to count blocks of the size class off the depot free list.
+	// Returns the number of blocks moved into *head.
+	int32 TakeBatch(int32 index, int32 count, b2Block** head);
+
+	// Push a linked batch of blocks back on the depot free list.
+	void ReturnBatch(int32 index, b2Block* head, b2Block* tail);
+
+	// Assert that p is a block of the size class owned by this allocator.
+	void ValidateBlock(void* p, int32 index) const;
+
 	b2Chunk* m_chunks;
 	int32 m_chunkCount;
 	int32 m_chunkSpace;
@@ -60,9 +118,54 @@ private:
 	// Record giant allocations--ones bigger than the max block size
 	b2TrackedBlockAllocator m_giants;
 
-	static int32 s_blockSizes[b2_blockSizes];
-	static uint8 s_blockSizeLookup[b2_maxBlockSize + 1];
-	static bool s_blockSizeLookupInitialized;
+	uint32 m_allocationCounts[b2_blockSizes];
+	uint32 m_freeCounts[b2_blockSizes];
+	int32 m_chunkCounts[b2_blockSizes];
+
+	// Only allocated while the allocator is thread-safe.
+	b2BlockAllocatorLock* m_lock;
+	int32 m_cacheCount;
+};
+
+/// A per-thread front end of a thread-safe b2BlockAllocator. Construct one
+/// on each worker thread; while it is alive, calls to the allocator made
+/// from that thread are served from the cache's free lists without taking
+/// the allocator's lock. The cache must be destroyed on the thread that
+/// created it and before the allocator.
+class b2BlockAllocatorCache
+{
+public:
+	b2BlockAllocatorCache(b2BlockAllocator* allocator);
+	~b2BlockAllocatorCache();
+
+	/// Allocate a block from this thread's free lists.
+	void* Allocate(int32 size);
+
+	/// Return a block to this thread's free lists.
+	void Free(void* p, int32 size);
+
+	/// Return all cached blocks and counters to the shared allocator.
+	void Flush();
+
+	/// Get the cache bound to the calling thread, or NULL.
+	static b2BlockAllocatorCache* GetCurrent();
+
+private:
+	friend class b2BlockAllocator;
+
+	// Add the counters made since the last exchange to the allocator.
+	// The caller holds the allocator's lock.
+	void Publish(int32 index);
+
+	b2BlockAllocator* m_allocator;
+	b2BlockAllocatorCache* m_previous;
+
+	b2Block* m_freeLists[b2_blockSizes];
+	int32 m_cachedCounts[b2_blockSizes];
+
+	// Counters not yet published to the allocator.
+	uint32 m_pendingAllocations[b2_blockSizes];
+	uint32 m_pendingFrees[b2_blockSizes];
 };
 
 #endif
@@ -156,6 +156,10 @@ typedef unsigned long long uint64;
 #define b2_baumgarte				0.2f
 #define b2_toiBaugarte				0.75f
 
+/// The initial capacity of the world's dense body table. The table doubles
+/// whenever it fills up.
+#define b2_minBodyBufferCapacity	64
+
 
 // Particle
 
@@ -193,6 +197,19 @@ typedef unsigned long long uint64;
 /// The initial size of particle data buffers.
 #define b2_minParticleSystemBufferCapacity	256
 
+/// The width of the tiles, in particle strides, used to re-triangulate
+/// separated clusters of changed particles with independent Voronoi diagrams.
+#define b2_voronoiTileStride	32
+
+/// The number of intra-group contacts above which ComputeDepth() splits a
+/// group's relaxation across worker threads, and spreads the smaller groups
+/// being updated across them once they hold that many together.
+#define b2_minParallelDepthContacts	8192
+
+/// The number of contacts per thread above which b2WorldSnapshot::Restore()
+/// creates the saved contacts on worker threads.
+#define b2_minParallelRestoreContacts	2048
+
 /// The time into the future that collisions against barrier particles will be detected.
 #define b2_barrierCollisionTime 2.5f
 
@@ -22,36 +22,108 @@
 
 b2StackAllocator::b2StackAllocator()
 {
-	m_index = 0;
+	m_inlineSegment.data = m_data;
+	m_inlineSegment.size = b2_stackSize;
+	m_inlineSegment.index = 0;
+	m_inlineSegment.prev = NULL;
+	m_inlineSegment.next = NULL;
+	m_segment = &m_inlineSegment;
+
 	m_allocation = 0;
 	m_maxAllocation = 0;
+	m_heapAllocationCount = 0;
+
+	m_entries = m_inlineEntries;
 	m_entryCount = 0;
+	m_entryCapacity = b2_maxStackEntries;
 }
 
 b2StackAllocator::~b2StackAllocator()
 {
-	b2Assert(m_index == 0);
+	b2Assert(m_allocation == 0);
 	b2Assert(m_entryCount == 0);
+
+	b2StackSegment* segment = m_inlineSegment.next;
+	while (segment)
+	{
+		b2StackSegment* next = segment->next;
+		b2Free(segment);
+		segment = next;
+	}
+
+	if (m_entries != m_inlineEntries)
+	{
+		b2Free(m_entries);
+	}
+}
+
+void b2StackAllocator::AdvanceSegment(int32 size)
+{
+	b2StackSegment* next = m_segment->next;
+	if (next && next->size < size)
+	{
+		// Too small; drop it and everything after it. They are all empty.
+		m_segment->next = NULL;
+		while (next)
+		{
+			b2StackSegment* n = next->next;
+			b2Free(next);
+			next = n;
+		}
+	}
+
+	if (next == NULL)
+	{
+		// Grow geometrically so a large scene settles on a few segments.
+		int32 segmentSize = b2Max(2 * m_segment->size, size);
+		next = (b2StackSegment*)b2Alloc(sizeof(b2StackSegment) + segmentSize);
+		next->data = (char*)(next + 1);
+		next->size = segmentSize;
+		next->index = 0;
+		next->prev = m_segment;
+		next->next = NULL;
+		m_segment->next = next;
+		++m_heapAllocationCount;
+	}
+
+	b2Assert(next->index == 0);
+	m_segment = next;
+}
+
+void b2StackAllocator::GrowEntries()
+{
+	int32 newCapacity = 2 * m_entryCapacity;
+	b2StackEntry* entries =
+		(b2StackEntry*)b2Alloc(newCapacity * sizeof(b2StackEntry));
+	memcpy(entries, m_entries, m_entryCount * sizeof(b2StackEntry));
+	if (m_entries != m_inlineEntries)
+	{
+		b2Free(m_entries);
+	}
+	m_entries = entries;
+	m_entryCapacity = newCapacity;
+	++m_heapAllocationCount;
 }
 
 void* b2StackAllocator::Allocate(int32 size)
 {
-	b2Assert(m_entryCount < b2_maxStackEntries);
-	const int32 roundedSize = (size + ALIGN_MASK) & ~ALIGN_MASK;
-	b2StackEntry* entry = m_entries + m_entryCount;
-	entry->size = roundedSize;
-	if (m_index + roundedSize > b2_stackSize)
+	if (m_entryCount == m_entryCapacity)
 	{
-		entry->data = (char*)b2Alloc(roundedSize);
-		entry->usedMalloc = true;
+		GrowEntries();
 	}
-	else
+
+	const int32 roundedSize = (size + ALIGN_MASK) & ~ALIGN_MASK;
+	if (m_segment->index + roundedSize > m_segment->size)
 	{
-		entry->data = m_data + m_index;
-		entry->usedMalloc = false;
-		m_index += roundedSize;
+		AdvanceSegment(roundedSize);
 	}
 
+	b2StackEntry* entry = m_entries + m_entryCount;
+	entry->size = roundedSize;
+	entry->data = m_segment->data + m_segment->index;
+	entry->segment = m_segment;
+	m_segment->index += roundedSize;
+
 	m_allocation += roundedSize;
 	m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
 	++m_entryCount;
@@ -65,31 +137,35 @@ void* b2StackAllocator::Reallocate(void* p, int32 size)
 	b2StackEntry* entry = m_entries + m_entryCount - 1;
 	b2Assert(p == entry->data);
 	B2_NOT_USED(p);
-	int32 incrementSize = size - entry->size;
+	const int32 roundedSize = (size + ALIGN_MASK) & ~ALIGN_MASK;
+	int32 incrementSize = roundedSize - entry->size;
 	if (incrementSize > 0)
 	{
-		if (entry->usedMalloc)
-		{
-			void* data = b2Alloc(size);
-			memcpy(data, entry->data, entry->size);
-			b2Free(entry->data);
-			entry->data = (char*)data;
-		}
-		else if (m_index + incrementSize > b2_stackSize)
+		b2Assert(entry->segment == m_segment);
+		if (m_segment->index + incrementSize <= m_segment->size)
 		{
-			void* data = b2Alloc(size);
-			memcpy(data, entry->data, entry->size);
-			m_index -= entry->size;
-			entry->data = (char*)data;
-			entry->usedMalloc = true;
+			// Grow in place.
+			m_segment->index += incrementSize;
+			entry->size = roundedSize;
+			m_allocation += incrementSize;
+			m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
 		}
 		else
 		{
-			m_index += incrementSize;
+			// Move the block to the next segment, then release its old
+			// space. The old segment is left behind, possibly empty.
+			b2StackSegment* oldSegment = m_segment;
+			AdvanceSegment(roundedSize);
+			memcpy(m_segment->data, entry->data, entry->size);
+			oldSegment->index -= entry->size;
+
+			entry->data = m_segment->data;
+			entry->segment = m_segment;
+			entry->size = roundedSize;
+			m_segment->index = roundedSize;
 			m_allocation += incrementSize;
 			m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
 		}
-		entry->size = size;
 	}
 
 	return entry->data;
@@ -100,21 +176,41 @@ void b2StackAllocator::Free(void* p)
 	b2Assert(m_entryCount > 0);
 	b2StackEntry* entry = m_entries + m_entryCount - 1;
 	b2Assert(p == entry->data);
-	if (entry->usedMalloc)
-	{
-		b2Free(p);
-	}
-	else
-	{
-		m_index -= entry->size;
-	}
+	B2_NOT_USED(p);
+	b2Assert(entry->segment == m_segment);
+	m_segment->index -= entry->size;
 	m_allocation -= entry->size;
 	--m_entryCount;
 
-	p = NULL;
+	// Step back over segments that are now empty.
+	while (m_segment->index == 0 && m_segment->prev)
+	{
+		m_segment = m_segment->prev;
+	}
 }
 
 int32 b2StackAllocator::GetMaxAllocation() const
 {
 	return m_maxAllocation;
 }
+
+void b2StackAllocator::ResetMaxAllocation()
+{
+	m_maxAllocation = m_allocation;
+}
+
+int32 b2StackAllocator::GetHeapAllocationCount() const
+{
+	return m_heapAllocationCount;
+}
+
+int32 b2StackAllocator::GetCapacity() const
+{
+	int32 capacity = 0;
+	for (const b2StackSegment* segment = &m_inlineSegment; segment;
+		 segment = segment->next)
+	{
+		capacity += segment->size;
+	}
+	return capacity;
+}
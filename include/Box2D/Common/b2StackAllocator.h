@@ -24,16 +24,33 @@
 const int32 b2_stackSize = 100 * 1024;	// 100k
 const int32 b2_maxStackEntries = 32;
 
+// A contiguous region the stack allocator carves entries from. The first
+// segment is stored inline in the allocator; further segments are
+// allocated with b2Alloc on demand and kept for reuse.
+struct b2StackSegment
+{
+	char* data;
+	int32 size;
+	int32 index;
+	b2StackSegment* prev;
+	b2StackSegment* next;
+};
+
 struct b2StackEntry
 {
 	char* data;
 	int32 size;
-	bool usedMalloc;
+	b2StackSegment* segment;
 };
 
 // This is a stack allocator used for fast per step allocations.
 // You must nest allocate/free pairs. The code will assert
 // if you try to interleave multiple allocate/free pairs.
+// When the inline buffer is exhausted the stack grows by chaining
+// segments of increasing size rather than allocating every request on
+// the heap. Segments are retained, so after warm-up a step does not touch
+// the heap. An instance has no shared state, so each thread that needs
+// scratch memory should own its own allocator.
 class b2StackAllocator
 {
 public:
@@ -47,18 +64,42 @@ public:
 	void* Reallocate(void* p, int32 size);
 	void Free(void* p);
 
+	/// Get the high-water mark in bytes since construction or the last
+	/// call to ResetMaxAllocation().
 	int32 GetMaxAllocation() const;
 
+	/// Restart the high-water mark from the current allocation.
+	void ResetMaxAllocation();
+
+	/// Get the number of times the allocator had to fall back to b2Alloc
+	/// to grow its segments or entry table.
+	int32 GetHeapAllocationCount() const;
+
+	/// Get the total size in bytes of all segments, including the inline
+	/// buffer.
+	int32 GetCapacity() const;
+
 private:
 
+	// Make room for size bytes by moving to the next segment, allocating
+	// or replacing it if it is too small.
+	void AdvanceSegment(int32 size);
+
+	// Double the capacity of the entry table.
+	void GrowEntries();
+
 	char m_data[b2_stackSize];
-	int32 m_index;
+	b2StackSegment m_inlineSegment;
+	b2StackSegment* m_segment;
 
 	int32 m_allocation;
 	int32 m_maxAllocation;
+	int32 m_heapAllocationCount;
 
-	b2StackEntry m_entries[b2_maxStackEntries];
+	b2StackEntry m_inlineEntries[b2_maxStackEntries];
+	b2StackEntry* m_entries;
 	int32 m_entryCount;
+	int32 m_entryCapacity;
 };
 
 #endif
@@ -0,0 +1,103 @@
+#include <Box2D/Common/b2WorkerPool.h>
+#include <Box2D/Common/b2Math.h>
+
+b2WorkerPool::b2WorkerPool()
+{
+	m_work = NULL;
+	m_pending = 0;
+	m_running = 0;
+	m_stop = false;
+}
+
+b2WorkerPool::~b2WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+}
+
+void b2WorkerPool::Run(int32 threadCount, const std::function<void()>& work)
+{
+	int32 workerCount = threadCount - 1;
+	if (workerCount <= 0)
+	{
+		work();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	b2Assert(m_running == 0);
+	while ((int32) m_threads.size() < workerCount)
+	{
+		m_threads.push_back(std::thread(&b2WorkerPool::WorkerMain, this));
+	}
+	m_work = &work;
+	m_pending = workerCount;
+	m_running = workerCount;
+	lock.unlock();
+	m_wake.notify_all();
+
+	work();
+
+	lock.lock();
+	m_done.wait(lock, [this]() { return m_running == 0; });
+	m_work = NULL;
+}
+
+int32 b2WorkerPool::GetHardwareThreadCount()
+{
+	return b2Max((int32) std::thread::hardware_concurrency(), 1);
+}
+
+void b2WorkerPool::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_wake.wait(lock, [this]() { return m_stop || m_pending > 0; });
+		if (m_stop)
+		{
+			return;
+		}
+		m_pending--;
+		const std::function<void()>* work = m_work;
+		lock.unlock();
+
+		(*work)();
+
+		lock.lock();
+		if (--m_running == 0)
+		{
+			m_done.notify_one();
+		}
+	}
+}
+
+b2WorkerBarrier::b2WorkerBarrier(int32 threadCount)
+{
+	b2Assert(threadCount > 0);
+	m_threadCount = threadCount;
+	m_waiting = 0;
+	m_phase = 0;
+}
+
+void b2WorkerBarrier::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	uint32 phase = m_phase;
+	if (++m_waiting == m_threadCount)
+	{
+		m_waiting = 0;
+		m_phase++;
+		lock.unlock();
+		m_arrived.notify_all();
+		return;
+	}
+	m_arrived.wait(lock, [this, phase]() { return m_phase != phase; });
+}
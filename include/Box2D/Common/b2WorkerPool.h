@@ -0,0 +1,65 @@
+#ifndef B2_WORKER_POOL_H
+#define B2_WORKER_POOL_H
+
+#include <Box2D/Common/b2Settings.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A set of worker threads that are started once and reused for every
+/// parallel pass, so a step does not pay for thread creation.
+/// Threads are started on demand up to the largest count requested and
+/// joined when the pool is destroyed.
+class b2WorkerPool
+{
+public:
+	b2WorkerPool();
+	~b2WorkerPool();
+
+	/// Run work on the calling thread and on threadCount - 1 workers, and
+	/// return once every invocation has returned. work is expected to
+	/// pull its items from shared state, e.g. an atomic counter. Every
+	/// invocation runs on a different thread.
+	void Run(int32 threadCount, const std::function<void()>& work);
+
+	/// Get the number of threads the hardware can run concurrently.
+	static int32 GetHardwareThreadCount();
+
+private:
+	void WorkerMain();
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	const std::function<void()>* m_work;
+	// Invocations of m_work not yet picked up / not yet finished.
+	int32 m_pending;
+	int32 m_running;
+	bool m_stop;
+};
+
+/// Holds the threads running the work of one b2WorkerPool::Run() call until
+/// all of them have arrived, for work that proceeds in dependent phases.
+/// Each invocation of the work runs on its own thread, so they can wait for
+/// each other. The barrier is reusable for any number of phases.
+class b2WorkerBarrier
+{
+public:
+	explicit b2WorkerBarrier(int32 threadCount);
+
+	/// Block until threadCount threads have called Wait() in this phase.
+	void Wait();
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_arrived;
+	int32 m_threadCount;
+	int32 m_waiting;
+	uint32 m_phase;
+};
+
+#endif
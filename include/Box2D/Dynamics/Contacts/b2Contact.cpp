@@ -174,8 +174,8 @@ void b2Contact::Update(b2ContactListener* listener)
 
 	b2Body* bodyA = m_fixtureA->GetBody();
 	b2Body* bodyB = m_fixtureB->GetBody();
-	const b2Transform& xfA = bodyA->GetTransform();
-	const b2Transform& xfB = bodyB->GetTransform();
+	b2Transform xfA = bodyA->GetTransform();
+	b2Transform xfB = bodyB->GetTransform();
 
 	// Is this contact a sensor?
 	if (sensor)
@@ -85,6 +85,7 @@ public:
 protected:
 
 	friend class b2Joint;
+	friend class b2WorldSnapshot;
 
 	b2FrictionJoint(const b2FrictionJointDef* def);
 
@@ -61,9 +61,9 @@ b2GearJoint::b2GearJoint(const b2GearJointDef* def)
 	m_bodyA = m_joint1->GetBodyB();
 
 	// Get geometry of joint1
-	b2Transform xfA = m_bodyA->m_xf;
+	b2Transform xfA = m_bodyA->Xf();
 	float32 aA = m_bodyA->m_sweep.a;
-	b2Transform xfC = m_bodyC->m_xf;
+	b2Transform xfC = m_bodyC->Xf();
 	float32 aC = m_bodyC->m_sweep.a;
 
 	if (m_typeA == e_revoluteJoint)
@@ -93,9 +93,9 @@ b2GearJoint::b2GearJoint(const b2GearJointDef* def)
 	m_bodyB = m_joint2->GetBodyB();
 
 	// Get geometry of joint2
-	b2Transform xfB = m_bodyB->m_xf;
+	b2Transform xfB = m_bodyB->Xf();
 	float32 aB = m_bodyB->m_sweep.a;
-	b2Transform xfD = m_bodyD->m_xf;
+	b2Transform xfD = m_bodyD->Xf();
 	float32 aD = m_bodyD->m_sweep.a;
 
 	if (m_typeB == e_revoluteJoint)
@@ -154,6 +154,7 @@ protected:
 	friend class b2Body;
 	friend class b2Island;
 	friend class b2GearJoint;
+	friend class b2WorldSnapshot;
 
 	static b2Joint* Create(const b2JointDef* def, b2BlockAllocator* allocator);
 	static void Destroy(b2Joint* joint, b2BlockAllocator* allocator);
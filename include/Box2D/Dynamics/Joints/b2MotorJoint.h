@@ -97,6 +97,7 @@ public:
 protected:
 
 	friend class b2Joint;
+	friend class b2WorldSnapshot;
 
 	b2MotorJoint(const b2MotorJointDef* def);
 
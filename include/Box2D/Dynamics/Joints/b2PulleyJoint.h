@@ -115,6 +115,7 @@ public:
 protected:
 
 	friend class b2Joint;
+	friend class b2WorldSnapshot;
 	b2PulleyJoint(const b2PulleyJointDef* data);
 
 	void InitVelocityConstraints(const b2SolverData& data);
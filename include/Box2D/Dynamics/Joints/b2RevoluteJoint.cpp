@@ -406,7 +406,7 @@ float32 b2RevoluteJoint::GetJointSpeed() const
 {
 	b2Body* bA = m_bodyA;
 	b2Body* bB = m_bodyB;
-	return bB->m_angularVelocity - bA->m_angularVelocity;
+	return bB->AngularVelocity() - bA->AngularVelocity();
 }
 
 bool b2RevoluteJoint::IsMotorEnabled() const
@@ -362,8 +362,8 @@ float32 b2WheelJoint::GetJointTranslation() const
 
 float32 b2WheelJoint::GetJointSpeed() const
 {
-	float32 wA = m_bodyA->m_angularVelocity;
-	float32 wB = m_bodyB->m_angularVelocity;
+	float32 wA = m_bodyA->AngularVelocity();
+	float32 wB = m_bodyB->AngularVelocity();
 	return wB - wA;
 }
 
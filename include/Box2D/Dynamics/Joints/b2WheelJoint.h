@@ -133,6 +133,7 @@ public:
 protected:
 
 	friend class b2Joint;
+	friend class b2WorldSnapshot;
 	b2WheelJoint(const b2WheelJointDef* def);
 
 	void InitVelocityConstraints(const b2SolverData& data);
@@ -57,13 +57,18 @@ b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 
 	m_world = world;
 
-	m_xf.p = bd->position;
-	m_xf.q.Set(bd->angle);
-	m_xf0 = m_xf;
+	// The world reserves the next slot of its body arrays before
+	// constructing the body.
+	m_worldIndex = world->m_bodyCount;
+	m_arrays = &world->m_bodyArrays;
+
+	Xf().p = bd->position;
+	Xf().q.Set(bd->angle);
+	Xf0() = Xf();
 
 	m_sweep.localCenter.SetZero();
-	m_sweep.c0 = m_xf.p;
-	m_sweep.c = m_xf.p;
+	m_sweep.c0 = Xf().p;
+	m_sweep.c = Xf().p;
 	m_sweep.a0 = bd->angle;
 	m_sweep.a = bd->angle;
 	m_sweep.alpha0 = 0.0f;
@@ -73,15 +78,15 @@ b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 	m_prev = NULL;
 	m_next = NULL;
 
-	m_linearVelocity = bd->linearVelocity;
-	m_angularVelocity = bd->angularVelocity;
+	LinearVelocity() = bd->linearVelocity;
+	AngularVelocity() = bd->angularVelocity;
 
 	m_linearDamping = bd->linearDamping;
 	m_angularDamping = bd->angularDamping;
 	m_gravityScale = bd->gravityScale;
 
-	m_force.SetZero();
-	m_torque = 0.0f;
+	Force().SetZero();
+	Torque() = 0.0f;
 
 	m_sleepTime = 0.0f;
 
@@ -131,8 +136,8 @@ void b2Body::SetType(b2BodyType type)
 
 	if (m_type == b2_staticBody)
 	{
-		m_linearVelocity.SetZero();
-		m_angularVelocity = 0.0f;
+		LinearVelocity().SetZero();
+		AngularVelocity() = 0.0f;
 		m_sweep.a0 = m_sweep.a;
 		m_sweep.c0 = m_sweep.c;
 		SynchronizeFixtures();
@@ -140,8 +145,8 @@ void b2Body::SetType(b2BodyType type)
 
 	SetAwake(true);
 
-	m_force.SetZero();
-	m_torque = 0.0f;
+	Force().SetZero();
+	Torque() = 0.0f;
 
 	// Delete the attached contacts.
 	b2ContactEdge* ce = m_contactList;
@@ -182,7 +187,7 @@ b2Fixture* b2Body::CreateFixture(const b2FixtureDef* def)
 	if (m_flags & e_activeFlag)
 	{
 		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
-		fixture->CreateProxies(broadPhase, m_xf);
+		fixture->CreateProxies(broadPhase, Xf());
 	}
 
 	fixture->m_next = m_fixtureList;
@@ -296,8 +301,8 @@ void b2Body::ResetMassData()
 	// Static and kinematic bodies have zero mass.
 	if (m_type == b2_staticBody || m_type == b2_kinematicBody)
 	{
-		m_sweep.c0 = m_xf.p;
-		m_sweep.c = m_xf.p;
+		m_sweep.c0 = Xf().p;
+		m_sweep.c = Xf().p;
 		m_sweep.a0 = m_sweep.a;
 		return;
 	}
@@ -350,10 +355,10 @@ void b2Body::ResetMassData()
 	// Move center of mass.
 	b2Vec2 oldCenter = m_sweep.c;
 	m_sweep.localCenter = localCenter;
-	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
+	m_sweep.c0 = m_sweep.c = b2Mul(Xf(), m_sweep.localCenter);
 
 	// Update center of mass velocity.
-	m_linearVelocity += b2Cross(m_angularVelocity, m_sweep.c - oldCenter);
+	LinearVelocity() += b2Cross(AngularVelocity(), m_sweep.c - oldCenter);
 }
 
 void b2Body::SetMassData(const b2MassData* massData)
@@ -391,10 +396,10 @@ void b2Body::SetMassData(const b2MassData* massData)
 	// Move center of mass.
 	b2Vec2 oldCenter = m_sweep.c;
 	m_sweep.localCenter =  massData->center;
-	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
+	m_sweep.c0 = m_sweep.c = b2Mul(Xf(), m_sweep.localCenter);
 
 	// Update center of mass velocity.
-	m_linearVelocity += b2Cross(m_angularVelocity, m_sweep.c - oldCenter);
+	LinearVelocity() += b2Cross(AngularVelocity(), m_sweep.c - oldCenter);
 }
 
 bool b2Body::ShouldCollide(const b2Body* other) const
@@ -428,11 +433,11 @@ void b2Body::SetTransform(const b2Vec2& position, float32 angle)
 		return;
 	}
 
-	m_xf.q.Set(angle);
-	m_xf.p = position;
-	m_xf0 = m_xf;
+	Xf().q.Set(angle);
+	Xf().p = position;
+	Xf0() = Xf();
 
-	m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
+	m_sweep.c = b2Mul(Xf(), m_sweep.localCenter);
 	m_sweep.a = angle;
 
 	m_sweep.c0 = m_sweep.c;
@@ -441,7 +446,7 @@ void b2Body::SetTransform(const b2Vec2& position, float32 angle)
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
-		f->Synchronize(broadPhase, m_xf, m_xf);
+		f->Synchronize(broadPhase, Xf(), Xf());
 	}
 }
 
@@ -454,7 +459,7 @@ void b2Body::SynchronizeFixtures()
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
-		f->Synchronize(broadPhase, xf1, m_xf);
+		f->Synchronize(broadPhase, xf1, Xf());
 	}
 }
 
@@ -475,7 +480,7 @@ void b2Body::SetActive(bool flag)
 		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 		{
-			f->CreateProxies(broadPhase, m_xf);
+			f->CreateProxies(broadPhase, Xf());
 		}
 
 		// Contacts are created the next time step.
@@ -520,7 +525,7 @@ void b2Body::SetFixedRotation(bool flag)
 		m_flags &= ~e_fixedRotationFlag;
 	}
 
-	m_angularVelocity = 0.0f;
+	AngularVelocity() = 0.0f;
 
 	ResetMassData();
 }
@@ -532,10 +537,10 @@ void b2Body::Dump()
 	b2Log("{\n");
 	b2Log("  b2BodyDef bd;\n");
 	b2Log("  bd.type = b2BodyType(%d);\n", m_type);
-	b2Log("  bd.position.Set(%.15lef, %.15lef);\n", m_xf.p.x, m_xf.p.y);
+	b2Log("  bd.position.Set(%.15lef, %.15lef);\n", Xf().p.x, Xf().p.y);
 	b2Log("  bd.angle = %.15lef;\n", m_sweep.a);
-	b2Log("  bd.linearVelocity.Set(%.15lef, %.15lef);\n", m_linearVelocity.x, m_linearVelocity.y);
-	b2Log("  bd.angularVelocity = %.15lef;\n", m_angularVelocity);
+	b2Log("  bd.linearVelocity.Set(%.15lef, %.15lef);\n", LinearVelocity().x, LinearVelocity().y);
+	b2Log("  bd.angularVelocity = %.15lef;\n", AngularVelocity());
 	b2Log("  bd.linearDamping = %.15lef;\n", m_linearDamping);
 	b2Log("  bd.angularDamping = %.15lef;\n", m_angularDamping);
 	b2Log("  bd.allowSleep = bool(%d);\n", m_flags & e_autoSleepFlag);
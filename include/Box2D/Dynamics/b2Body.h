@@ -128,6 +128,18 @@ struct b2BodyDef
 	float32 gravityScale;
 };
 
+/// The per-body state touched every step, stored by the world as parallel
+/// arrays indexed by the body's slot in the dense body table.
+struct b2BodyArrays
+{
+	b2Transform* xf;		// the body origin transforms
+	b2Transform* xf0;		// the previous transforms for particle simulation
+	b2Vec2* linearVelocity;
+	float32* angularVelocity;
+	b2Vec2* force;
+	float32* torque;
+};
+
 /// A rigid body. These are created via b2World::CreateBody.
 class b2Body
 {
@@ -167,12 +179,14 @@ public:
 	void SetTransform(const b2Vec2& position, float32 angle);
 
 	/// Get the body transform for the body's origin.
-	/// @return the world transform of the body's origin.
-	const b2Transform& GetTransform() const;
+	/// @return the world transform of the body's origin. Returned by value:
+	/// the world keeps it in arrays that move when bodies are created or
+	/// destroyed.
+	b2Transform GetTransform() const;
 
 	/// Get the world body origin position.
-	/// @return the world position of the body's origin.
-	const b2Vec2& GetPosition() const;
+	/// @return the world position of the body's origin, by value.
+	b2Vec2 GetPosition() const;
 
 	/// Get the angle in radians.
 	/// @return the current world rotation angle in radians.
@@ -189,8 +203,8 @@ public:
 	void SetLinearVelocity(const b2Vec2& v);
 
 	/// Get the linear velocity of the center of mass.
-	/// @return the linear velocity of the center of mass.
-	const b2Vec2& GetLinearVelocity() const;
+	/// @return the linear velocity of the center of mass, by value.
+	b2Vec2 GetLinearVelocity() const;
 
 	/// Set the angular velocity.
 	/// @param omega the new angular velocity in radians/second.
@@ -423,6 +437,7 @@ private:
 
 	friend class b2ParticleSystem;
 	friend class b2ParticleGroup;
+	friend class b2WorldSnapshot;
 
 	// m_flags
 	enum
@@ -448,21 +463,40 @@ private:
 
 	void Advance(float32 t);
 
+	// Accessors for the state kept in the world's b2BodyArrays.
+	b2Transform& Xf() { return m_arrays->xf[m_worldIndex]; }
+	const b2Transform& Xf() const { return m_arrays->xf[m_worldIndex]; }
+	b2Transform& Xf0() { return m_arrays->xf0[m_worldIndex]; }
+	const b2Transform& Xf0() const { return m_arrays->xf0[m_worldIndex]; }
+	b2Vec2& LinearVelocity() { return m_arrays->linearVelocity[m_worldIndex]; }
+	const b2Vec2& LinearVelocity() const
+	{
+		return m_arrays->linearVelocity[m_worldIndex];
+	}
+	float32& AngularVelocity()
+	{
+		return m_arrays->angularVelocity[m_worldIndex];
+	}
+	float32 AngularVelocity() const
+	{
+		return m_arrays->angularVelocity[m_worldIndex];
+	}
+	b2Vec2& Force() { return m_arrays->force[m_worldIndex]; }
+	const b2Vec2& Force() const { return m_arrays->force[m_worldIndex]; }
+	float32& Torque() { return m_arrays->torque[m_worldIndex]; }
+	float32 Torque() const { return m_arrays->torque[m_worldIndex]; }
+
 	b2BodyType m_type;
 
 	uint16 m_flags;
 
 	int32 m_islandIndex;
 
-	b2Transform m_xf;		// the body origin transform
-	b2Transform m_xf0;		// the previous transform for particle simulation
-	b2Sweep m_sweep;		// the swept motion for CCD
-
-	b2Vec2 m_linearVelocity;
-	float32 m_angularVelocity;
+	// This body's slot in the world's dense body table and b2BodyArrays.
+	int32 m_worldIndex;
+	b2BodyArrays* m_arrays;
 
-	b2Vec2 m_force;
-	float32 m_torque;
+	b2Sweep m_sweep;		// the swept motion for CCD
 
 	b2World* m_world;
 	b2Body* m_prev;
@@ -493,14 +527,14 @@ inline b2BodyType b2Body::GetType() const
 	return m_type;
 }
 
-inline const b2Transform& b2Body::GetTransform() const
+inline b2Transform b2Body::GetTransform() const
 {
-	return m_xf;
+	return Xf();
 }
 
-inline const b2Vec2& b2Body::GetPosition() const
+inline b2Vec2 b2Body::GetPosition() const
 {
-	return m_xf.p;
+	return Xf().p;
 }
 
 inline float32 b2Body::GetAngle() const
@@ -530,12 +564,12 @@ inline void b2Body::SetLinearVelocity(const b2Vec2& v)
 		SetAwake(true);
 	}
 
-	m_linearVelocity = v;
+	LinearVelocity() = v;
 }
 
-inline const b2Vec2& b2Body::GetLinearVelocity() const
+inline b2Vec2 b2Body::GetLinearVelocity() const
 {
-	return m_linearVelocity;
+	return LinearVelocity();
 }
 
 inline void b2Body::SetAngularVelocity(float32 w)
@@ -550,12 +584,12 @@ inline void b2Body::SetAngularVelocity(float32 w)
 		SetAwake(true);
 	}
 
-	m_angularVelocity = w;
+	AngularVelocity() = w;
 }
 
 inline float32 b2Body::GetAngularVelocity() const
 {
-	return m_angularVelocity;
+	return AngularVelocity();
 }
 
 inline float32 b2Body::GetMass() const
@@ -577,27 +611,27 @@ inline void b2Body::GetMassData(b2MassData* data) const
 
 inline b2Vec2 b2Body::GetWorldPoint(const b2Vec2& localPoint) const
 {
-	return b2Mul(m_xf, localPoint);
+	return b2Mul(Xf(), localPoint);
 }
 
 inline b2Vec2 b2Body::GetWorldVector(const b2Vec2& localVector) const
 {
-	return b2Mul(m_xf.q, localVector);
+	return b2Mul(Xf().q, localVector);
 }
 
 inline b2Vec2 b2Body::GetLocalPoint(const b2Vec2& worldPoint) const
 {
-	return b2MulT(m_xf, worldPoint);
+	return b2MulT(Xf(), worldPoint);
 }
 
 inline b2Vec2 b2Body::GetLocalVector(const b2Vec2& worldVector) const
 {
-	return b2MulT(m_xf.q, worldVector);
+	return b2MulT(Xf().q, worldVector);
 }
 
 inline b2Vec2 b2Body::GetLinearVelocityFromWorldPoint(const b2Vec2& worldPoint) const
 {
-	return m_linearVelocity + b2Cross(m_angularVelocity, worldPoint - m_sweep.c);
+	return LinearVelocity() + b2Cross(AngularVelocity(), worldPoint - m_sweep.c);
 }
 
 inline b2Vec2 b2Body::GetLinearVelocityFromLocalPoint(const b2Vec2& localPoint) const
@@ -666,10 +700,10 @@ inline void b2Body::SetAwake(bool flag)
 	{
 		m_flags &= ~e_awakeFlag;
 		m_sleepTime = 0.0f;
-		m_linearVelocity.SetZero();
-		m_angularVelocity = 0.0f;
-		m_force.SetZero();
-		m_torque = 0.0f;
+		LinearVelocity().SetZero();
+		AngularVelocity() = 0.0f;
+		Force().SetZero();
+		Torque() = 0.0f;
 	}
 }
 
@@ -771,8 +805,8 @@ inline void b2Body::ApplyForce(const b2Vec2& force, const b2Vec2& point, bool wa
 	// Don't accumulate a force if the body is sleeping.
 	if (m_flags & e_awakeFlag)
 	{
-		m_force += force;
-		m_torque += b2Cross(point - m_sweep.c, force);
+		Force() += force;
+		Torque() += b2Cross(point - m_sweep.c, force);
 	}
 }
 
@@ -791,7 +825,7 @@ inline void b2Body::ApplyForceToCenter(const b2Vec2& force, bool wake)
 	// Don't accumulate a force if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_force += force;
+		Force() += force;
 	}
 }
 
@@ -810,7 +844,7 @@ inline void b2Body::ApplyTorque(float32 torque, bool wake)
 	// Don't accumulate a force if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_torque += torque;
+		Torque() += torque;
 	}
 }
 
@@ -829,8 +863,8 @@ inline void b2Body::ApplyLinearImpulse(const b2Vec2& impulse, const b2Vec2& poin
 	// Don't accumulate velocity if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_linearVelocity += m_invMass * impulse;
-		m_angularVelocity += m_invI * b2Cross(point - m_sweep.c, impulse);
+		LinearVelocity() += m_invMass * impulse;
+		AngularVelocity() += m_invI * b2Cross(point - m_sweep.c, impulse);
 	}
 }
 
@@ -849,14 +883,14 @@ inline void b2Body::ApplyAngularImpulse(float32 impulse, bool wake)
 	// Don't accumulate velocity if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_angularVelocity += m_invI * impulse;
+		AngularVelocity() += m_invI * impulse;
 	}
 }
 
 inline void b2Body::SynchronizeTransform()
 {
-	m_xf.q.Set(m_sweep.a);
-	m_xf.p = m_sweep.c - b2Mul(m_xf.q, m_sweep.localCenter);
+	Xf().q.Set(m_sweep.a);
+	Xf().p = m_sweep.c - b2Mul(Xf().q, m_sweep.localCenter);
 }
 
 inline void b2Body::Advance(float32 alpha)
@@ -865,8 +899,8 @@ inline void b2Body::Advance(float32 alpha)
 	m_sweep.Advance(alpha);
 	m_sweep.c = m_sweep.c0;
 	m_sweep.a = m_sweep.a0;
-	m_xf.q.Set(m_sweep.a);
-	m_xf.p = m_sweep.c - b2Mul(m_xf.q, m_sweep.localCenter);
+	Xf().q.Set(m_sweep.a);
+	Xf().p = m_sweep.c - b2Mul(Xf().q, m_sweep.localCenter);
 }
 
 inline b2World* b2Body::GetWorld()
@@ -32,6 +32,7 @@ class b2ContactManager
 {
 public:
 	friend class b2ParticleSystem;
+	friend class b2WorldSnapshot;
 
 	b2ContactManager();
 
@@ -206,6 +206,7 @@ protected:
 	friend class b2World;
 	friend class b2Contact;
 	friend class b2ContactManager;
+	friend class b2WorldSnapshot;
 
 	b2Fixture();
 
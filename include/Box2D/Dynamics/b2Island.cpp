@@ -193,8 +193,8 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 
 		b2Vec2 c = b->m_sweep.c;
 		float32 a = b->m_sweep.a;
-		b2Vec2 v = b->m_linearVelocity;
-		float32 w = b->m_angularVelocity;
+		b2Vec2 v = b->LinearVelocity();
+		float32 w = b->AngularVelocity();
 
 		// Store positions for continuous collision.
 		b->m_sweep.c0 = b->m_sweep.c;
@@ -203,8 +203,8 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		if (b->m_type == b2_dynamicBody)
 		{
 			// Integrate velocities.
-			v += h * (b->m_gravityScale * gravity + b->m_invMass * b->m_force);
-			w += h * b->m_invI * b->m_torque;
+			v += h * (b->m_gravityScale * gravity + b->m_invMass * b->Force());
+			w += h * b->m_invI * b->Torque();
 
 			// Apply damping.
 			// ODE: dv/dt + c * v = 0
@@ -332,8 +332,8 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		b2Body* body = m_bodies[i];
 		body->m_sweep.c = m_positions[i].c;
 		body->m_sweep.a = m_positions[i].a;
-		body->m_linearVelocity = m_velocities[i].v;
-		body->m_angularVelocity = m_velocities[i].w;
+		body->LinearVelocity() = m_velocities[i].v;
+		body->AngularVelocity() = m_velocities[i].w;
 		body->SynchronizeTransform();
 	}
 
@@ -357,8 +357,8 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 			}
 
 			if ((b->m_flags & b2Body::e_autoSleepFlag) == 0 ||
-				b->m_angularVelocity * b->m_angularVelocity > angTolSqr ||
-				b2Dot(b->m_linearVelocity, b->m_linearVelocity) > linTolSqr)
+				b->AngularVelocity() * b->AngularVelocity() > angTolSqr ||
+				b2Dot(b->LinearVelocity(), b->LinearVelocity()) > linTolSqr)
 			{
 				b->m_sleepTime = 0.0f;
 				minSleepTime = 0.0f;
@@ -392,8 +392,8 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 		b2Body* b = m_bodies[i];
 		m_positions[i].c = b->m_sweep.c;
 		m_positions[i].a = b->m_sweep.a;
-		m_velocities[i].v = b->m_linearVelocity;
-		m_velocities[i].w = b->m_angularVelocity;
+		m_velocities[i].v = b->LinearVelocity();
+		m_velocities[i].w = b->AngularVelocity();
 	}
 
 	b2ContactSolverDef contactSolverDef;
@@ -505,8 +505,8 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 		b2Body* body = m_bodies[i];
 		body->m_sweep.c = c;
 		body->m_sweep.a = a;
-		body->m_linearVelocity = v;
-		body->m_angularVelocity = w;
+		body->LinearVelocity() = v;
+		body->AngularVelocity() = w;
 		body->SynchronizeTransform();
 	}
 
@@ -22,7 +22,7 @@
 
 #include <Box2D/Common/b2Math.h>
 
-/// Profiling data. Times are in milliseconds.
+/// Profiling data. Times are in milliseconds, stack sizes in bytes.
 struct b2Profile
 {
 	float32 step;
@@ -33,6 +33,8 @@ struct b2Profile
 	float32 solvePosition;
 	float32 broadphase;
 	float32 solveTOI;
+	int32 stackPeak;			// stack allocator high-water mark during the step
+	int32 stackHeapAllocations;	// stack allocator growths during the step
 };
 
 /// This is an internal structure.
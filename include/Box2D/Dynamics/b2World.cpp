@@ -65,6 +65,17 @@ b2World::~b2World()
 		DestroyParticleSystem(m_particleSystemList);
 	}
 
+	if (m_bodyBuffer)
+	{
+		b2Free(m_bodyBuffer);
+		b2Free(m_bodyArrays.xf);
+		b2Free(m_bodyArrays.xf0);
+		b2Free(m_bodyArrays.linearVelocity);
+		b2Free(m_bodyArrays.angularVelocity);
+		b2Free(m_bodyArrays.force);
+		b2Free(m_bodyArrays.torque);
+	}
+
 	// Even though the block allocator frees them for us, for safety,
 	// we should ensure that all buffers have been freed.
 	b2Assert(m_blockAllocator.GetNumGiantAllocations() == 0);
@@ -98,6 +109,13 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 		return NULL;
 	}
 
+	// Reserve a slot in the dense body table; the constructor initializes
+	// the body's entries in m_bodyArrays.
+	if (m_bodyCount == m_bodyBufferCapacity)
+	{
+		GrowBodyBuffer();
+	}
+
 	void* mem = m_blockAllocator.Allocate(sizeof(b2Body));
 	b2Body* b = new (mem) b2Body(def, this);
 
@@ -109,11 +127,47 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 		m_bodyList->m_prev = b;
 	}
 	m_bodyList = b;
+
+	b2Assert(b->m_worldIndex == m_bodyCount);
+	m_bodyBuffer[m_bodyCount] = b;
 	++m_bodyCount;
 
 	return b;
 }
 
+// Reallocate one of the world's dense body arrays.
+template <typename T>
+static T* b2ReallocBodyArray(T* oldBuffer, int32 count, int32 newCapacity)
+{
+	T* newBuffer = (T*)b2Alloc(newCapacity * sizeof(T));
+	if (oldBuffer)
+	{
+		memcpy(newBuffer, oldBuffer, count * sizeof(T));
+		b2Free(oldBuffer);
+	}
+	return newBuffer;
+}
+
+void b2World::GrowBodyBuffer()
+{
+	int32 newCapacity = m_bodyBufferCapacity ?
+		2 * m_bodyBufferCapacity : b2_minBodyBufferCapacity;
+	m_bodyBuffer = b2ReallocBodyArray(m_bodyBuffer, m_bodyCount, newCapacity);
+	m_bodyArrays.xf =
+		b2ReallocBodyArray(m_bodyArrays.xf, m_bodyCount, newCapacity);
+	m_bodyArrays.xf0 =
+		b2ReallocBodyArray(m_bodyArrays.xf0, m_bodyCount, newCapacity);
+	m_bodyArrays.linearVelocity = b2ReallocBodyArray(
+		m_bodyArrays.linearVelocity, m_bodyCount, newCapacity);
+	m_bodyArrays.angularVelocity = b2ReallocBodyArray(
+		m_bodyArrays.angularVelocity, m_bodyCount, newCapacity);
+	m_bodyArrays.force =
+		b2ReallocBodyArray(m_bodyArrays.force, m_bodyCount, newCapacity);
+	m_bodyArrays.torque =
+		b2ReallocBodyArray(m_bodyArrays.torque, m_bodyCount, newCapacity);
+	m_bodyBufferCapacity = newCapacity;
+}
+
 void b2World::DestroyBody(b2Body* b)
 {
 	b2Assert(m_bodyCount > 0);
@@ -190,6 +244,23 @@ void b2World::DestroyBody(b2Body* b)
 		m_bodyList = b->m_next;
 	}
 
+	// Remove from the dense body table by moving the last body into the
+	// vacated slot.
+	int32 index = b->m_worldIndex;
+	int32 lastIndex = m_bodyCount - 1;
+	b2Assert(m_bodyBuffer[index] == b);
+	b2Body* last = m_bodyBuffer[lastIndex];
+	m_bodyBuffer[index] = last;
+	m_bodyArrays.xf[index] = m_bodyArrays.xf[lastIndex];
+	m_bodyArrays.xf0[index] = m_bodyArrays.xf0[lastIndex];
+	m_bodyArrays.linearVelocity[index] =
+		m_bodyArrays.linearVelocity[lastIndex];
+	m_bodyArrays.angularVelocity[index] =
+		m_bodyArrays.angularVelocity[lastIndex];
+	m_bodyArrays.force[index] = m_bodyArrays.force[lastIndex];
+	m_bodyArrays.torque[index] = m_bodyArrays.torque[lastIndex];
+	last->m_worldIndex = index;
+
 	--m_bodyCount;
 	b->~b2Body();
 	m_blockAllocator.Free(b, sizeof(b2Body));
@@ -413,9 +484,9 @@ void b2World::SetAllowSleeping(bool flag)
 	m_allowSleep = flag;
 	if (m_allowSleep == false)
 	{
-		for (b2Body* b = m_bodyList; b; b = b->m_next)
+		for (int32 i = 0; i < m_bodyCount; ++i)
 		{
-			b->SetAwake(true);
+			m_bodyBuffer[i]->SetAwake(true);
 		}
 	}
 }
@@ -433,6 +504,10 @@ void b2World::Init(const b2Vec2& gravity)
 	m_bodyCount = 0;
 	m_jointCount = 0;
 
+	m_bodyBuffer = NULL;
+	m_bodyBufferCapacity = 0;
+	memset(&m_bodyArrays, 0, sizeof(m_bodyArrays));
+
 	m_warmStarting = true;
 	m_continuousPhysics = true;
 	m_subStepping = false;
@@ -457,11 +532,11 @@ void b2World::Init(const b2Vec2& gravity)
 // Find islands, integrate and solve constraints, solve position constraints
 void b2World::Solve(const b2TimeStep& step)
 {
+	b2Body** bodies = m_bodyBuffer;
+	int32 bodyCount = m_bodyCount;
+
 	// update previous transforms
-	for (b2Body* b = m_bodyList; b; b = b->m_next)
-	{
-		b->m_xf0 = b->m_xf;
-	}
+	memcpy(m_bodyArrays.xf0, m_bodyArrays.xf, bodyCount * sizeof(b2Transform));
 
 	m_profile.solveInit = 0.0f;
 	m_profile.solveVelocity = 0.0f;
@@ -475,9 +550,9 @@ void b2World::Solve(const b2TimeStep& step)
 					m_contactManager.m_contactListener);
 
 	// Clear all the island flags.
-	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	for (int32 i = 0; i < bodyCount; ++i)
 	{
-		b->m_flags &= ~b2Body::e_islandFlag;
+		bodies[i]->m_flags &= ~b2Body::e_islandFlag;
 	}
 	for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
 	{
@@ -489,10 +564,11 @@ void b2World::Solve(const b2TimeStep& step)
 	}
 
 	// Build and simulate all awake islands.
-	int32 stackSize = m_bodyCount;
+	int32 stackSize = bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
-	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
+	for (int32 seedIndex = 0; seedIndex < bodyCount; ++seedIndex)
 	{
+		b2Body* seed = bodies[seedIndex];
 		if (seed->m_flags & b2Body::e_islandFlag)
 		{
 			continue;
@@ -628,8 +704,10 @@ void b2World::Solve(const b2TimeStep& step)
 	{
 		b2Timer timer;
 		// Synchronize fixtures, check for out of range bodies.
-		for (b2Body* b = m_bodyList; b; b = b->GetNext())
+		for (int32 i = 0; i < bodyCount; ++i)
 		{
+			b2Body* b = bodies[i];
+
 			// If a body was not in an island then it did not move.
 			if ((b->m_flags & b2Body::e_islandFlag) == 0)
 			{
@@ -658,8 +736,9 @@ void b2World::SolveTOI(const b2TimeStep& step)
 
 	if (m_stepComplete)
 	{
-		for (b2Body* b = m_bodyList; b; b = b->m_next)
+		for (int32 i = 0; i < m_bodyCount; ++i)
 		{
+			b2Body* b = m_bodyBuffer[i];
 			b->m_flags &= ~b2Body::e_islandFlag;
 			b->m_sweep.alpha0 = 0.0f;
 		}
@@ -980,6 +1059,8 @@ void b2World::Step(
 	int32 particleIterations)
 {
 	b2Timer stepTimer;
+	int32 stackHeapAllocations = m_stackAllocator.GetHeapAllocationCount();
+	m_stackAllocator.ResetMaxAllocation();
 
 	// If new fixtures were added, we need to find the new contacts.
 	if (m_flags & e_newFixture)
@@ -1047,15 +1128,18 @@ void b2World::Step(
 
 	m_flags &= ~e_locked;
 
+	m_profile.stackPeak = m_stackAllocator.GetMaxAllocation();
+	m_profile.stackHeapAllocations =
+		m_stackAllocator.GetHeapAllocationCount() - stackHeapAllocations;
 	m_profile.step = stepTimer.GetMilliseconds();
 }
 
 void b2World::ClearForces()
 {
-	for (b2Body* body = m_bodyList; body; body = body->GetNext())
+	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		body->m_force.SetZero();
-		body->m_torque = 0.0f;
+		m_bodyArrays.force[i].SetZero();
+		m_bodyArrays.torque[i] = 0.0f;
 	}
 }
 
@@ -1205,8 +1289,8 @@ void b2World::DrawJoint(b2Joint* joint)
 {
 	b2Body* bodyA = joint->GetBodyA();
 	b2Body* bodyB = joint->GetBodyB();
-	const b2Transform& xf1 = bodyA->GetTransform();
-	const b2Transform& xf2 = bodyB->GetTransform();
+	b2Transform xf1 = bodyA->GetTransform();
+	b2Transform xf2 = bodyB->GetTransform();
 	b2Vec2 x1 = xf1.p;
 	b2Vec2 x2 = xf2.p;
 	b2Vec2 p1 = joint->GetAnchorA();
@@ -1274,7 +1358,7 @@ void b2World::DrawDebugData()
 	{
 		for (b2Body* b = m_bodyList; b; b = b->GetNext())
 		{
-			const b2Transform& xf = b->GetTransform();
+			b2Transform xf = b->GetTransform();
 			for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
 			{
 				if (b->IsActive() == false)
@@ -1425,9 +1509,10 @@ void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 		return;
 	}
 
-	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		b->m_xf.p -= newOrigin;
+		b2Body* b = m_bodyBuffer[i];
+		m_bodyArrays.xf[i].p -= newOrigin;
 		b->m_sweep.c0 -= newOrigin;
 		b->m_sweep.c -= newOrigin;
 	}
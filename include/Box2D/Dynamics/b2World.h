@@ -23,6 +23,7 @@
 #include <Box2D/Common/b2Math.h>
 #include <Box2D/Common/b2BlockAllocator.h>
 #include <Box2D/Common/b2StackAllocator.h>
+#include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2ContactManager.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
@@ -297,9 +298,12 @@ private:
 	friend class b2ContactManager;
 	friend class b2Controller;
 	friend class b2ParticleSystem;
+	friend class b2WorldSnapshot;
 
 	void Init(const b2Vec2& gravity);
 
+	void GrowBodyBuffer();
+
 	void Solve(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
 
@@ -322,6 +326,16 @@ private:
 	int32 m_bodyCount;
 	int32 m_jointCount;
 
+	// Dense, index-addressed table of the bodies in m_bodyList. Each body
+	// stores its slot in b2Body::m_worldIndex so removal is a swap with the
+	// last entry. The step walks this table linearly instead of the list.
+	b2Body** m_bodyBuffer;
+	int32 m_bodyBufferCapacity;
+
+	// The bodies' transforms, velocities and forces, stored in arrays
+	// parallel to m_bodyBuffer so the per-step passes over them are dense.
+	b2BodyArrays m_bodyArrays;
+
 	b2Vec2 m_gravity;
 	bool m_allowSleep;
 
@@ -0,0 +1,1512 @@
+#include <Box2D/Dynamics/b2WorldSnapshot.h>
+#include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Dynamics/b2Body.h>
+#include <Box2D/Dynamics/b2Fixture.h>
+#include <Box2D/Dynamics/Contacts/b2Contact.h>
+#include <Box2D/Dynamics/Joints/b2DistanceJoint.h>
+#include <Box2D/Dynamics/Joints/b2FrictionJoint.h>
+#include <Box2D/Dynamics/Joints/b2GearJoint.h>
+#include <Box2D/Dynamics/Joints/b2MotorJoint.h>
+#include <Box2D/Dynamics/Joints/b2MouseJoint.h>
+#include <Box2D/Dynamics/Joints/b2PrismaticJoint.h>
+#include <Box2D/Dynamics/Joints/b2PulleyJoint.h>
+#include <Box2D/Dynamics/Joints/b2RevoluteJoint.h>
+#include <Box2D/Dynamics/Joints/b2RopeJoint.h>
+#include <Box2D/Dynamics/Joints/b2WeldJoint.h>
+#include <Box2D/Dynamics/Joints/b2WheelJoint.h>
+#include <Box2D/Collision/Shapes/b2CircleShape.h>
+#include <Box2D/Collision/Shapes/b2EdgeShape.h>
+#include <Box2D/Collision/Shapes/b2ChainShape.h>
+#include <Box2D/Collision/Shapes/b2PolygonShape.h>
+#include <Box2D/Particle/b2ParticleGroup.h>
+#include <Box2D/Common/b2WorkerPool.h>
+#include <atomic>
+#include <string.h>
+
+static uint32 AlignSnapshotOffset(uint32 offset)
+{
+	return (offset + 7) & ~7u;
+}
+
+// Lays out the snapshot. Without a buffer it only measures it.
+class b2WorldSnapshot::Writer
+{
+public:
+	Writer(uint8* buffer) : m_buffer(buffer), m_size(0) {}
+
+	template <typename T> uint32 Reserve(int32 count)
+	{
+		uint32 offset = m_size;
+		m_size = AlignSnapshotOffset(m_size + sizeof(T) * count);
+		return offset;
+	}
+
+	template <typename T> T* Get(uint32 offset) const
+	{
+		return (T*) (m_buffer + offset);
+	}
+
+	// Append a particle buffer, returning its offset or 0 if it is absent.
+	template <typename T> uint32 Copy(const T* data, int32 count)
+	{
+		if (!data)
+		{
+			return 0;
+		}
+		uint32 offset = Reserve<T>(count);
+		if (m_buffer)
+		{
+			memcpy(m_buffer + offset, data, sizeof(T) * count);
+		}
+		return offset;
+	}
+
+	bool IsMeasuring() const { return m_buffer == NULL; }
+	uint32 GetSize() const { return m_size; }
+
+private:
+	uint8* m_buffer;
+	uint32 m_size;
+};
+
+// Reads or writes the values of a joint record.
+struct b2WorldSnapshot::JointValues
+{
+	float32* values;
+	int32 count;
+	bool save;
+
+	void operator()(float32& v)
+	{
+		b2Assert(count < b2_maxJointSnapshotValues);
+		if (save)
+		{
+			values[count] = v;
+		}
+		else
+		{
+			v = values[count];
+		}
+		++count;
+	}
+
+	void operator()(b2Vec2& v)
+	{
+		(*this)(v.x);
+		(*this)(v.y);
+	}
+
+	void operator()(b2Vec3& v)
+	{
+		(*this)(v.x);
+		(*this)(v.y);
+		(*this)(v.z);
+	}
+
+	void operator()(bool& v)
+	{
+		float32 f = v ? 1.0f : 0.0f;
+		(*this)(f);
+		v = f != 0.0f;
+	}
+
+	void operator()(b2LimitState& v)
+	{
+		float32 f = (float32) v;
+		(*this)(f);
+		v = (b2LimitState) (int32) f;
+	}
+};
+
+// Visit the state of a joint that is not recomputed by
+// InitVelocityConstraints: its parameters and accumulated impulses.
+void b2WorldSnapshot::VisitJoint(b2Joint* joint, JointValues& v)
+{
+	switch (joint->m_type)
+	{
+	case e_revoluteJoint:
+		{
+			b2RevoluteJoint* j = (b2RevoluteJoint*) joint;
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_referenceAngle);
+			v(j->m_impulse);
+			v(j->m_motorImpulse);
+			v(j->m_enableMotor);
+			v(j->m_maxMotorTorque);
+			v(j->m_motorSpeed);
+			v(j->m_enableLimit);
+			v(j->m_lowerAngle);
+			v(j->m_upperAngle);
+			v(j->m_limitState);
+		}
+		break;
+
+	case e_prismaticJoint:
+		{
+			b2PrismaticJoint* j = (b2PrismaticJoint*) joint;
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_localXAxisA);
+			v(j->m_localYAxisA);
+			v(j->m_referenceAngle);
+			v(j->m_impulse);
+			v(j->m_motorImpulse);
+			v(j->m_lowerTranslation);
+			v(j->m_upperTranslation);
+			v(j->m_maxMotorForce);
+			v(j->m_motorSpeed);
+			v(j->m_enableLimit);
+			v(j->m_enableMotor);
+			v(j->m_limitState);
+		}
+		break;
+
+	case e_distanceJoint:
+		{
+			b2DistanceJoint* j = (b2DistanceJoint*) joint;
+			v(j->m_frequencyHz);
+			v(j->m_dampingRatio);
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_length);
+			v(j->m_impulse);
+		}
+		break;
+
+	case e_pulleyJoint:
+		{
+			b2PulleyJoint* j = (b2PulleyJoint*) joint;
+			v(j->m_groundAnchorA);
+			v(j->m_groundAnchorB);
+			v(j->m_lengthA);
+			v(j->m_lengthB);
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_constant);
+			v(j->m_ratio);
+			v(j->m_impulse);
+		}
+		break;
+
+	case e_mouseJoint:
+		{
+			b2MouseJoint* j = (b2MouseJoint*) joint;
+			v(j->m_localAnchorB);
+			v(j->m_targetA);
+			v(j->m_frequencyHz);
+			v(j->m_dampingRatio);
+			v(j->m_impulse);
+			v(j->m_maxForce);
+		}
+		break;
+
+	case e_gearJoint:
+		{
+			b2GearJoint* j = (b2GearJoint*) joint;
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_localAnchorC);
+			v(j->m_localAnchorD);
+			v(j->m_localAxisC);
+			v(j->m_localAxisD);
+			v(j->m_referenceAngleA);
+			v(j->m_referenceAngleB);
+			v(j->m_constant);
+			v(j->m_ratio);
+			v(j->m_impulse);
+		}
+		break;
+
+	case e_wheelJoint:
+		{
+			b2WheelJoint* j = (b2WheelJoint*) joint;
+			v(j->m_frequencyHz);
+			v(j->m_dampingRatio);
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_localXAxisA);
+			v(j->m_localYAxisA);
+			v(j->m_impulse);
+			v(j->m_motorImpulse);
+			v(j->m_springImpulse);
+			v(j->m_maxMotorTorque);
+			v(j->m_motorSpeed);
+			v(j->m_enableMotor);
+		}
+		break;
+
+	case e_weldJoint:
+		{
+			b2WeldJoint* j = (b2WeldJoint*) joint;
+			v(j->m_frequencyHz);
+			v(j->m_dampingRatio);
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_referenceAngle);
+			v(j->m_impulse);
+		}
+		break;
+
+	case e_frictionJoint:
+		{
+			b2FrictionJoint* j = (b2FrictionJoint*) joint;
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_linearImpulse);
+			v(j->m_angularImpulse);
+			v(j->m_maxForce);
+			v(j->m_maxTorque);
+		}
+		break;
+
+	case e_ropeJoint:
+		{
+			b2RopeJoint* j = (b2RopeJoint*) joint;
+			v(j->m_localAnchorA);
+			v(j->m_localAnchorB);
+			v(j->m_maxLength);
+			v(j->m_length);
+			v(j->m_impulse);
+			v(j->m_state);
+		}
+		break;
+
+	case e_motorJoint:
+		{
+			b2MotorJoint* j = (b2MotorJoint*) joint;
+			v(j->m_linearOffset);
+			v(j->m_angularOffset);
+			v(j->m_linearImpulse);
+			v(j->m_angularImpulse);
+			v(j->m_maxForce);
+			v(j->m_maxTorque);
+			v(j->m_correctionFactor);
+		}
+		break;
+
+	default:
+		b2Assert(false);
+		break;
+	}
+}
+
+static int32 GetJointIndex(const b2World* world, const b2Joint* joint)
+{
+	int32 index = 0;
+	for (const b2Joint* j = world->GetJointList(); j; j = j->GetNext())
+	{
+		if (j == joint)
+		{
+			return index;
+		}
+		++index;
+	}
+	return b2_invalidParticleIndex;
+}
+
+uint32 b2WorldSnapshot::Write(const b2World* world, Writer& writer)
+{
+	const int32 bodyCount = world->m_bodyCount;
+
+	// Body list positions by body table slot, and the index of the first
+	// fixture of every body in list order.
+	int32* listIndices = (int32*) b2Alloc(sizeof(int32) * (bodyCount + 1));
+	int32* firstFixtures = (int32*) b2Alloc(sizeof(int32) * (bodyCount + 1));
+	int32 fixtureCount = 0;
+	int32 chainVertexCount = 0;
+	int32 bodyIndex = 0;
+	for (const b2Body* b = world->m_bodyList; b; b = b->m_next)
+	{
+		listIndices[b->m_worldIndex] = bodyIndex;
+		firstFixtures[bodyIndex++] = fixtureCount;
+		for (const b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			if (f->m_shape->m_type == b2Shape::e_chain)
+			{
+				chainVertexCount += ((b2ChainShape*) f->m_shape)->m_count;
+			}
+			++fixtureCount;
+		}
+	}
+	int32 particleSystemCount = 0;
+	for (const b2ParticleSystem* p = world->m_particleSystemList; p;
+		 p = p->m_next)
+	{
+		++particleSystemCount;
+	}
+
+	uint32 headerOffset = writer.Reserve<b2SnapshotHeader>(1);
+	b2SnapshotHeader header = b2SnapshotHeader();
+	header.magic = b2_snapshotMagic;
+	header.version = b2_snapshotVersion;
+	header.byteOrder = b2_snapshotByteOrder;
+	header.gravity = world->m_gravity;
+	header.inv_dt0 = world->m_inv_dt0;
+	header.flags = (world->m_allowSleep ? e_allowSleep : 0) |
+				   (world->m_warmStarting ? e_warmStarting : 0) |
+				   (world->m_continuousPhysics ? e_continuousPhysics : 0) |
+				   (world->m_subStepping ? e_subStepping : 0) |
+				   (world->m_stepComplete ? e_stepComplete : 0) |
+				   (world->GetAutoClearForces() ? e_clearForces : 0);
+	header.bodies.count = bodyCount;
+	header.bodies.offset = writer.Reserve<b2BodySnapshot>(bodyCount);
+	header.fixtures.count = fixtureCount;
+	header.fixtures.offset = writer.Reserve<b2FixtureSnapshot>(fixtureCount);
+	header.chainVertices.count = chainVertexCount;
+	header.chainVertices.offset = writer.Reserve<b2Vec2>(chainVertexCount);
+	header.joints.count = world->m_jointCount;
+	header.joints.offset = writer.Reserve<b2JointSnapshot>(world->m_jointCount);
+	header.contacts.count = world->m_contactManager.m_contactCount;
+	header.contacts.offset = writer.Reserve<b2ContactSnapshot>(
+		world->m_contactManager.m_contactCount);
+	header.particleSystems.count = particleSystemCount;
+	header.particleSystems.offset =
+		writer.Reserve<b2ParticleSystemSnapshot>(particleSystemCount);
+
+	if (!writer.IsMeasuring())
+	{
+		b2BodySnapshot* bodies =
+			writer.Get<b2BodySnapshot>(header.bodies.offset);
+		b2FixtureSnapshot* fixtures =
+			writer.Get<b2FixtureSnapshot>(header.fixtures.offset);
+		b2Vec2* chainVertices = writer.Get<b2Vec2>(header.chainVertices.offset);
+		int32 chainVertex = 0;
+		for (const b2Body* b = world->m_bodyList; b; b = b->m_next)
+		{
+			b2BodySnapshot& body = *bodies++;
+			body.type = b->m_type;
+			body.worldIndex = b->m_worldIndex;
+			body.flags = b->m_flags;
+			body.fixtureCount = b->m_fixtureCount;
+			body.xf = b->Xf();
+			body.xf0 = b->Xf0();
+			body.sweep = b->m_sweep;
+			body.linearVelocity = b->LinearVelocity();
+			body.angularVelocity = b->AngularVelocity();
+			body.force = b->Force();
+			body.torque = b->Torque();
+			body.mass = b->m_mass;
+			body.invMass = b->m_invMass;
+			body.I = b->m_I;
+			body.invI = b->m_invI;
+			body.linearDamping = b->m_linearDamping;
+			body.angularDamping = b->m_angularDamping;
+			body.gravityScale = b->m_gravityScale;
+			body.sleepTime = b->m_sleepTime;
+
+			for (const b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+			{
+				b2FixtureSnapshot& fixture = *fixtures++;
+				const b2Shape* shape = f->m_shape;
+				fixture.shapeType = shape->m_type;
+				fixture.radius = shape->m_radius;
+				fixture.density = f->m_density;
+				fixture.friction = f->m_friction;
+				fixture.restitution = f->m_restitution;
+				fixture.filter = f->m_filter;
+				fixture.isSensor = f->m_isSensor;
+				switch (shape->m_type)
+				{
+				case b2Shape::e_circle:
+					fixture.vertices[0] = ((b2CircleShape*) shape)->m_p;
+					break;
+
+				case b2Shape::e_edge:
+					{
+						const b2EdgeShape* edge = (b2EdgeShape*) shape;
+						fixture.vertex0 = edge->m_vertex0;
+						fixture.vertices[0] = edge->m_vertex1;
+						fixture.vertices[1] = edge->m_vertex2;
+						fixture.vertex3 = edge->m_vertex3;
+						fixture.hasVertex0 = edge->m_hasVertex0;
+						fixture.hasVertex3 = edge->m_hasVertex3;
+					}
+					break;
+
+				case b2Shape::e_polygon:
+					{
+						const b2PolygonShape* polygon = (b2PolygonShape*) shape;
+						fixture.centroid = polygon->m_centroid;
+						fixture.count = polygon->m_count;
+						memcpy(fixture.vertices, polygon->m_vertices,
+							   sizeof(b2Vec2) * polygon->m_count);
+						memcpy(fixture.normals, polygon->m_normals,
+							   sizeof(b2Vec2) * polygon->m_count);
+					}
+					break;
+
+				case b2Shape::e_chain:
+					{
+						const b2ChainShape* chain = (b2ChainShape*) shape;
+						fixture.vertex0 = chain->m_prevVertex;
+						fixture.vertex3 = chain->m_nextVertex;
+						fixture.hasVertex0 = chain->m_hasPrevVertex;
+						fixture.hasVertex3 = chain->m_hasNextVertex;
+						fixture.count = chain->m_count;
+						fixture.firstChainVertex = chainVertex;
+						memcpy(chainVertices + chainVertex, chain->m_vertices,
+							   sizeof(b2Vec2) * chain->m_count);
+						chainVertex += chain->m_count;
+					}
+					break;
+
+				default:
+					b2Assert(false);
+					break;
+				}
+			}
+		}
+
+		b2JointSnapshot* joints =
+			writer.Get<b2JointSnapshot>(header.joints.offset);
+		for (const b2Joint* j = world->m_jointList; j; j = j->m_next)
+		{
+			b2JointSnapshot& joint = *joints++;
+			joint.type = j->m_type;
+			joint.bodyA = listIndices[j->m_bodyA->m_worldIndex];
+			joint.bodyB = listIndices[j->m_bodyB->m_worldIndex];
+			joint.joint1 = joint.joint2 = b2_invalidParticleIndex;
+			if (j->m_type == e_gearJoint)
+			{
+				const b2GearJoint* gear = (const b2GearJoint*) j;
+				joint.joint1 = GetJointIndex(world, gear->m_joint1);
+				joint.joint2 = GetJointIndex(world, gear->m_joint2);
+			}
+			joint.collideConnected = j->m_collideConnected;
+			JointValues values = { joint.values, 0, true };
+			VisitJoint((b2Joint*) j, values);
+		}
+
+		b2ContactSnapshot* contacts =
+			writer.Get<b2ContactSnapshot>(header.contacts.offset);
+		for (const b2Contact* c = world->m_contactManager.m_contactList; c;
+			 c = c->m_next)
+		{
+			b2ContactSnapshot& contact = *contacts++;
+			const b2Fixture* fixturesAB[2] = { c->m_fixtureA, c->m_fixtureB };
+			int32 indices[2];
+			for (int32 k = 0; k < 2; k++)
+			{
+				const b2Body* body = fixturesAB[k]->m_body;
+				int32 index = firstFixtures[listIndices[body->m_worldIndex]];
+				for (const b2Fixture* f = body->m_fixtureList;
+					 f != fixturesAB[k]; f = f->m_next)
+				{
+					++index;
+				}
+				indices[k] = index;
+			}
+			contact.fixtureA = indices[0];
+			contact.fixtureB = indices[1];
+			contact.childA = c->m_indexA;
+			contact.childB = c->m_indexB;
+			contact.flags = c->m_flags;
+			contact.toiCount = c->m_toiCount;
+			contact.toi = c->m_toi;
+			contact.friction = c->m_friction;
+			contact.restitution = c->m_restitution;
+			contact.tangentSpeed = c->m_tangentSpeed;
+			contact.manifold = c->m_manifold;
+		}
+	}
+
+	b2ParticleSystemSnapshot* particleSystems = writer.IsMeasuring() ? NULL :
+		writer.Get<b2ParticleSystemSnapshot>(header.particleSystems.offset);
+	for (const b2ParticleSystem* p = world->m_particleSystemList; p;
+		 p = p->m_next)
+	{
+		b2ParticleSystemSnapshot record = b2ParticleSystemSnapshot();
+		WriteParticleSystem(p, &record, writer);
+		if (particleSystems)
+		{
+			*particleSystems++ = record;
+		}
+	}
+
+	b2Free(listIndices);
+	b2Free(firstFixtures);
+
+	header.size = writer.GetSize();
+	if (!writer.IsMeasuring())
+	{
+		*writer.Get<b2SnapshotHeader>(headerOffset) = header;
+	}
+	return header.size;
+}
+
+void b2WorldSnapshot::WriteParticleSystem(const b2ParticleSystem* p,
+										  b2ParticleSystemSnapshot* record,
+										  Writer& writer)
+{
+	const int32 count = p->m_count;
+	record->def = p->m_def;
+	record->count = count;
+	record->groupCount = p->m_groupCount;
+	record->pairCount = p->m_pairBuffer.GetCount();
+	record->triadCount = p->m_triadBuffer.GetCount();
+	record->timestamp = p->m_timestamp;
+	record->stuckThreshold = p->m_stuckThreshold;
+	record->timeElapsed = p->m_timeElapsed;
+	record->paused = p->m_paused;
+	record->hasForce = p->m_hasForce;
+	record->expirationTimeBufferRequiresSorting =
+		p->m_expirationTimeBufferRequiresSorting;
+
+	record->flagsOffset = writer.Copy(p->m_flagsBuffer.data, count);
+	record->positionOffset = writer.Copy(p->m_positionBuffer.data, count);
+	record->velocityOffset = writer.Copy(p->m_velocityBuffer.data, count);
+	record->forceOffset = writer.Copy(
+		p->m_hasForce ? p->m_forceBuffer : NULL, count);
+	record->staticPressureOffset =
+		writer.Copy(p->m_staticPressureBuffer, count);
+	record->depthOffset = writer.Copy(p->m_depthBuffer, count);
+	record->colorOffset = writer.Copy(p->m_colorBuffer.data, count);
+	record->lastBodyContactStepOffset =
+		writer.Copy(p->m_lastBodyContactStepBuffer.data, count);
+	record->bodyContactCountOffset =
+		writer.Copy(p->m_bodyContactCountBuffer.data, count);
+	record->consecutiveContactStepsOffset =
+		writer.Copy(p->m_consecutiveContactStepsBuffer.data, count);
+	record->expirationTimeOffset =
+		writer.Copy(p->m_expirationTimeBuffer.data, count);
+	record->indexByExpirationTimeOffset =
+		writer.Copy(p->m_indexByExpirationTimeBuffer.data, count);
+	record->pairOffset = writer.Copy(p->m_pairBuffer.Data(),
+									 record->pairCount);
+	record->triadOffset = writer.Copy(p->m_triadBuffer.Data(),
+									  record->triadCount);
+
+	record->groupOffset =
+		writer.Reserve<b2ParticleGroupSnapshot>(p->m_groupCount);
+	if (!writer.IsMeasuring())
+	{
+		b2ParticleGroupSnapshot* groups =
+			writer.Get<b2ParticleGroupSnapshot>(record->groupOffset);
+		for (const b2ParticleGroup* g = p->m_groupList; g; g = g->m_next)
+		{
+			b2ParticleGroupSnapshot& group = *groups++;
+			group.firstIndex = g->m_firstIndex;
+			group.lastIndex = g->m_lastIndex;
+			group.groupFlags = g->m_groupFlags;
+			group.strength = g->m_strength;
+			group.timestamp = g->m_timestamp;
+			group.mass = g->m_mass;
+			group.inertia = g->m_inertia;
+			group.center = g->m_center;
+			group.linearVelocity = g->m_linearVelocity;
+			group.angularVelocity = g->m_angularVelocity;
+			group.transform = g->m_transform;
+		}
+	}
+}
+
+uint32 b2WorldSnapshot::GetSize(const b2World* world)
+{
+	Writer writer(NULL);
+	return Write(world, writer);
+}
+
+uint32 b2WorldSnapshot::Save(const b2World* world, void* buffer,
+							 uint32 capacity)
+{
+	b2Assert(world->IsLocked() == false);
+	b2Assert(((uintptr_t) buffer & 7) == 0);
+	uint32 size = GetSize(world);
+	if (size > capacity)
+	{
+		return 0;
+	}
+	// Clear padding so equal states give equal snapshots
+	memset(buffer, 0, size);
+	Writer writer((uint8*) buffer);
+	return Write(world, writer);
+}
+
+// Check that a section of count records of type T lies within the snapshot.
+template <typename T>
+static bool IsValidSection(uint32 offset, int32 count, uint32 size)
+{
+	return count >= 0 && (offset & 7) == 0 && offset <= size &&
+		(uint64) count * sizeof(T) <= size - offset;
+}
+
+static bool IsValidParticleBuffer(uint32 offset, int32 count,
+								  uint32 elementSize, uint32 size)
+{
+	return offset == 0 || ((offset & 7) == 0 && offset <= size &&
+		(uint64) count * elementSize <= size - offset);
+}
+
+// Number of children of the shape a validated fixture record describes,
+// as b2Shape::GetChildCount() returns it
+static int32 GetChildCount(const b2FixtureSnapshot& fixture)
+{
+	return fixture.shapeType == b2Shape::e_chain ? fixture.count - 1 : 1;
+}
+
+bool b2WorldSnapshot::Validate(const void* data, uint32 size)
+{
+	if (!data || ((uintptr_t) data & 7) || size < sizeof(b2SnapshotHeader))
+	{
+		return false;
+	}
+	const uint8* base = (const uint8*) data;
+	const b2SnapshotHeader& header = *(const b2SnapshotHeader*) data;
+	if (header.magic != b2_snapshotMagic ||
+		header.version != b2_snapshotVersion ||
+		header.byteOrder != b2_snapshotByteOrder || header.size > size)
+	{
+		return false;
+	}
+	size = header.size;
+	if (!IsValidSection<b2BodySnapshot>(header.bodies.offset,
+										header.bodies.count, size) ||
+		!IsValidSection<b2FixtureSnapshot>(header.fixtures.offset,
+										   header.fixtures.count, size) ||
+		!IsValidSection<b2Vec2>(header.chainVertices.offset,
+								header.chainVertices.count, size) ||
+		!IsValidSection<b2JointSnapshot>(header.joints.offset,
+										 header.joints.count, size) ||
+		!IsValidSection<b2ContactSnapshot>(header.contacts.offset,
+										   header.contacts.count, size) ||
+		!IsValidSection<b2ParticleSystemSnapshot>(
+			header.particleSystems.offset, header.particleSystems.count,
+			size))
+	{
+		return false;
+	}
+
+	const int32 bodyCount = header.bodies.count;
+	const b2BodySnapshot* bodies =
+		(const b2BodySnapshot*) (base + header.bodies.offset);
+	// Every world index has to be used exactly once, so Restore can invert
+	// the mapping
+	bool* usedWorldIndices = (bool*) b2Alloc(sizeof(bool) * (bodyCount + 1));
+	memset(usedWorldIndices, 0, sizeof(bool) * (bodyCount + 1));
+	int32 fixtureCount = 0;
+	bool validBodies = true;
+	for (int32 i = 0; i < bodyCount; i++)
+	{
+		const b2BodySnapshot& b = bodies[i];
+		if (b.type < b2_staticBody || b.type > b2_dynamicBody ||
+			b.worldIndex < 0 || b.worldIndex >= bodyCount ||
+			usedWorldIndices[b.worldIndex] || b.fixtureCount < 0 ||
+			b.fixtureCount > header.fixtures.count - fixtureCount)
+		{
+			validBodies = false;
+			break;
+		}
+		usedWorldIndices[b.worldIndex] = true;
+		fixtureCount += b.fixtureCount;
+	}
+	b2Free(usedWorldIndices);
+	if (!validBodies || fixtureCount != header.fixtures.count)
+	{
+		return false;
+	}
+
+	const b2FixtureSnapshot* fixtures =
+		(const b2FixtureSnapshot*) (base + header.fixtures.offset);
+	for (int32 i = 0; i < fixtureCount; i++)
+	{
+		const b2FixtureSnapshot& f = fixtures[i];
+		switch (f.shapeType)
+		{
+		case b2Shape::e_circle:
+		case b2Shape::e_edge:
+			break;
+		case b2Shape::e_polygon:
+			if (f.count < 3 || f.count > b2_maxPolygonVertices)
+			{
+				return false;
+			}
+			break;
+		case b2Shape::e_chain:
+			if (f.count < 2 || f.firstChainVertex < 0 ||
+				f.firstChainVertex > header.chainVertices.count - f.count)
+			{
+				return false;
+			}
+			break;
+		default:
+			return false;
+		}
+	}
+
+	const b2JointSnapshot* joints =
+		(const b2JointSnapshot*) (base + header.joints.offset);
+	for (int32 i = 0; i < header.joints.count; i++)
+	{
+		const b2JointSnapshot& j = joints[i];
+		if (j.type <= e_unknownJoint || j.type > e_motorJoint ||
+			j.bodyA < 0 || j.bodyA >= bodyCount ||
+			j.bodyB < 0 || j.bodyB >= bodyCount)
+		{
+			return false;
+		}
+		// Gear joints are created after the joints they connect, which
+		// come later in the list
+		if (j.type == e_gearJoint &&
+			(j.joint1 <= i || j.joint1 >= header.joints.count ||
+			 j.joint2 <= i || j.joint2 >= header.joints.count))
+		{
+			return false;
+		}
+	}
+
+	const b2ContactSnapshot* contacts =
+		(const b2ContactSnapshot*) (base + header.contacts.offset);
+	for (int32 i = 0; i < header.contacts.count; i++)
+	{
+		const b2ContactSnapshot& c = contacts[i];
+		if (c.fixtureA < 0 || c.fixtureA >= fixtureCount ||
+			c.fixtureB < 0 || c.fixtureB >= fixtureCount ||
+			c.childA < 0 || c.childA >= GetChildCount(fixtures[c.fixtureA]) ||
+			c.childB < 0 || c.childB >= GetChildCount(fixtures[c.fixtureB]) ||
+			c.manifold.pointCount < 0 ||
+			c.manifold.pointCount > b2_maxManifoldPoints)
+		{
+			return false;
+		}
+	}
+
+	const b2ParticleSystemSnapshot* systems =
+		(const b2ParticleSystemSnapshot*) (base +
+										   header.particleSystems.offset);
+	for (int32 i = 0; i < header.particleSystems.count; i++)
+	{
+		const b2ParticleSystemSnapshot& p = systems[i];
+		const int32 count = p.count;
+		if (count < 0 || p.groupCount < 0 || p.pairCount < 0 ||
+			p.triadCount < 0 ||
+			(p.def.maxCount && count > p.def.maxCount) ||
+			(count && (!p.flagsOffset || !p.positionOffset ||
+					   !p.velocityOffset)) ||
+			!IsValidParticleBuffer(p.flagsOffset, count, sizeof(uint32),
+								   size) ||
+			!IsValidParticleBuffer(p.positionOffset, count, sizeof(b2Vec2),
+								   size) ||
+			!IsValidParticleBuffer(p.velocityOffset, count, sizeof(b2Vec2),
+								   size) ||
+			!IsValidParticleBuffer(p.forceOffset, count, sizeof(b2Vec2),
+								   size) ||
+			!IsValidParticleBuffer(p.staticPressureOffset, count,
+								   sizeof(float32), size) ||
+			!IsValidParticleBuffer(p.depthOffset, count, sizeof(float32),
+								   size) ||
+			!IsValidParticleBuffer(p.colorOffset, count,
+								   sizeof(b2ParticleColor), size) ||
+			!IsValidParticleBuffer(p.lastBodyContactStepOffset, count,
+								   sizeof(int32), size) ||
+			!IsValidParticleBuffer(p.bodyContactCountOffset, count,
+								   sizeof(int32), size) ||
+			!IsValidParticleBuffer(p.consecutiveContactStepsOffset, count,
+								   sizeof(int32), size) ||
+			!IsValidParticleBuffer(p.expirationTimeOffset, count,
+								   sizeof(int32), size) ||
+			!IsValidParticleBuffer(p.indexByExpirationTimeOffset, count,
+								   sizeof(int32), size) ||
+			!IsValidParticleBuffer(p.pairOffset, p.pairCount,
+								   sizeof(b2ParticlePair), size) ||
+			!IsValidParticleBuffer(p.triadOffset, p.triadCount,
+								   sizeof(b2ParticleTriad), size) ||
+			!IsValidSection<b2ParticleGroupSnapshot>(p.groupOffset,
+													 p.groupCount, size))
+		{
+			return false;
+		}
+		const b2ParticleGroupSnapshot* groups =
+			(const b2ParticleGroupSnapshot*) (base + p.groupOffset);
+		for (int32 k = 0; k < p.groupCount; k++)
+		{
+			if (groups[k].firstIndex < 0 ||
+				groups[k].firstIndex > groups[k].lastIndex ||
+				groups[k].lastIndex > count)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+template <typename Def>
+static b2Joint* CreateJointFromDef(b2World* world, Def& def, b2Body* bodyA,
+								   b2Body* bodyB, bool collideConnected)
+{
+	def.bodyA = bodyA;
+	def.bodyB = bodyB;
+	def.collideConnected = collideConnected;
+	return world->CreateJoint(&def);
+}
+
+b2Joint* b2WorldSnapshot::CreateJoint(b2World* world,
+									  const b2JointSnapshot& record,
+									  b2Body** bodies, b2Joint** joints)
+{
+	b2Body* bodyA = bodies[record.bodyA];
+	b2Body* bodyB = bodies[record.bodyB];
+	bool collide = record.collideConnected;
+	// The definitions only need to pass the joint constructors' checks; the
+	// saved values overwrite the state they set up.
+	switch (record.type)
+	{
+	case e_revoluteJoint:
+		{
+			b2RevoluteJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_prismaticJoint:
+		{
+			b2PrismaticJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_distanceJoint:
+		{
+			b2DistanceJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_pulleyJoint:
+		{
+			b2PulleyJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_mouseJoint:
+		{
+			b2MouseJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_gearJoint:
+		{
+			b2GearJointDef def;
+			def.joint1 = joints[record.joint1];
+			def.joint2 = joints[record.joint2];
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_wheelJoint:
+		{
+			b2WheelJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_weldJoint:
+		{
+			b2WeldJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_frictionJoint:
+		{
+			b2FrictionJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_ropeJoint:
+		{
+			b2RopeJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	case e_motorJoint:
+		{
+			b2MotorJointDef def;
+			return CreateJointFromDef(world, def, bodyA, bodyB, collide);
+		}
+	default:
+		b2Assert(false);
+		return NULL;
+	}
+}
+
+void b2WorldSnapshot::CreateContacts(const b2ContactSnapshot* records,
+									 int32 count, b2Fixture** fixtures,
+									 b2BlockAllocator* allocator,
+									 b2Contact** contacts)
+{
+	// Contacts are the bulk of a large world and do not refer to each
+	// other, so large counts are created on worker threads. Each thread
+	// allocates through its own cache of the world's block allocator and
+	// only locks it to exchange batches of blocks; the contacts are linked
+	// into the lists afterwards on the calling thread.
+	int32 threadCount = b2Max(b2Min(b2WorkerPool::GetHardwareThreadCount(),
+									count / b2_minParallelRestoreContacts), 1);
+	auto create = [&](int32 i)
+	{
+		const b2ContactSnapshot& record = records[i];
+		b2Contact* c = b2Contact::Create(
+			fixtures[record.fixtureA], record.childA,
+			fixtures[record.fixtureB], record.childB, allocator);
+		contacts[i] = c;
+		if (c == NULL)
+		{
+			return;
+		}
+		c->m_flags = record.flags;
+		c->m_toiCount = record.toiCount;
+		c->m_toi = record.toi;
+		c->m_friction = record.friction;
+		c->m_restitution = record.restitution;
+		c->m_tangentSpeed = record.tangentSpeed;
+		c->m_manifold = record.manifold;
+	};
+	if (threadCount == 1)
+	{
+		for (int32 i = 0; i < count; i++)
+		{
+			create(i);
+		}
+		return;
+	}
+
+	// The contact registers are filled on first use.
+	if (b2Contact::s_initialized == false)
+	{
+		b2Contact::InitializeRegisters();
+		b2Contact::s_initialized = true;
+	}
+
+	const int32 batchSize = 256;
+	std::atomic<int32> next(0);
+	allocator->SetThreadSafe(true);
+	{
+		b2WorkerPool pool;
+		pool.Run(threadCount, [&]()
+		{
+			b2BlockAllocatorCache cache(allocator);
+			for (;;)
+			{
+				int32 first = next.fetch_add(batchSize);
+				if (first >= count)
+				{
+					break;
+				}
+				int32 last = b2Min(first + batchSize, count);
+				for (int32 i = first; i < last; i++)
+				{
+					create(i);
+				}
+			}
+		});
+	}
+	allocator->SetThreadSafe(false);
+}
+
+bool b2WorldSnapshot::Restore(b2World* world, const void* data, uint32 size)
+{
+	b2Assert(world->IsLocked() == false);
+	if (world->IsLocked() || !Validate(data, size))
+	{
+		return false;
+	}
+	const uint8* base = (const uint8*) data;
+	const b2SnapshotHeader& header = *(const b2SnapshotHeader*) data;
+
+	// Particle systems restored in place must be able to hold the saved
+	// particles; check before anything is destroyed.
+	const int32 particleSystemCount = header.particleSystems.count;
+	const b2ParticleSystemSnapshot* systemRecords =
+		(const b2ParticleSystemSnapshot*) (base +
+										   header.particleSystems.offset);
+	int32 existingCount = 0;
+	for (b2ParticleSystem* p = world->m_particleSystemList; p; p = p->m_next)
+	{
+		++existingCount;
+	}
+	if (existingCount == particleSystemCount)
+	{
+		int32 systemIndex = 0;
+		for (b2ParticleSystem* p = world->m_particleSystemList; p;
+			 p = p->m_next)
+		{
+			if (!HasParticleCapacity(p, systemRecords[systemIndex++]))
+			{
+				return false;
+			}
+		}
+	}
+
+	while (world->m_jointList)
+	{
+		world->DestroyJoint(world->m_jointList);
+	}
+	while (world->m_bodyList)
+	{
+		world->DestroyBody(world->m_bodyList);
+	}
+
+	world->m_gravity = header.gravity;
+	world->m_inv_dt0 = header.inv_dt0;
+	world->m_allowSleep = (header.flags & e_allowSleep) != 0;
+	world->m_warmStarting = (header.flags & e_warmStarting) != 0;
+	world->m_continuousPhysics = (header.flags & e_continuousPhysics) != 0;
+	world->m_subStepping = (header.flags & e_subStepping) != 0;
+	world->m_stepComplete = (header.flags & e_stepComplete) != 0;
+	world->SetAutoClearForces((header.flags & e_clearForces) != 0);
+
+	const int32 bodyCount = header.bodies.count;
+	const int32 fixtureCount = header.fixtures.count;
+	const b2BodySnapshot* bodyRecords =
+		(const b2BodySnapshot*) (base + header.bodies.offset);
+	const b2FixtureSnapshot* fixtureRecords =
+		(const b2FixtureSnapshot*) (base + header.fixtures.offset);
+	const b2Vec2* chainVertices =
+		(const b2Vec2*) (base + header.chainVertices.offset);
+
+	b2Body** bodies = (b2Body**) b2Alloc(sizeof(b2Body*) * (bodyCount + 1));
+	b2Fixture** fixtures =
+		(b2Fixture**) b2Alloc(sizeof(b2Fixture*) * (fixtureCount + 1));
+	int32* firstFixtures = (int32*) b2Alloc(sizeof(int32) * (bodyCount + 1));
+	int32* bodiesByWorldIndex =
+		(int32*) b2Alloc(sizeof(int32) * (bodyCount + 1));
+	int32 fixtureIndex = 0;
+	for (int32 i = 0; i < bodyCount; i++)
+	{
+		firstFixtures[i] = fixtureIndex;
+		fixtureIndex += bodyRecords[i].fixtureCount;
+		bodiesByWorldIndex[bodyRecords[i].worldIndex] = i;
+	}
+
+	// Create the bodies in body table order so the solver visits them in
+	// the same order, and each body's fixtures in reverse so its fixture
+	// list comes out in the saved order.
+	for (int32 slot = 0; slot < bodyCount; slot++)
+	{
+		const int32 i = bodiesByWorldIndex[slot];
+		const b2BodySnapshot& record = bodyRecords[i];
+		b2BodyDef bd;
+		bd.type = (b2BodyType) record.type;
+		bd.position = record.xf.p;
+		bd.angle = record.sweep.a;
+		bd.active = (record.flags & b2Body::e_activeFlag) != 0;
+		b2Body* b = world->CreateBody(&bd);
+		bodies[i] = b;
+
+		for (int32 k = record.fixtureCount - 1; k >= 0; k--)
+		{
+			const b2FixtureSnapshot& f = fixtureRecords[firstFixtures[i] + k];
+			b2CircleShape circle;
+			b2EdgeShape edge;
+			b2PolygonShape polygon;
+			b2ChainShape chain;
+			b2FixtureDef fd;
+			switch (f.shapeType)
+			{
+			case b2Shape::e_circle:
+				circle.m_p = f.vertices[0];
+				fd.shape = &circle;
+				break;
+
+			case b2Shape::e_edge:
+				edge.m_vertex0 = f.vertex0;
+				edge.m_vertex1 = f.vertices[0];
+				edge.m_vertex2 = f.vertices[1];
+				edge.m_vertex3 = f.vertex3;
+				edge.m_hasVertex0 = f.hasVertex0;
+				edge.m_hasVertex3 = f.hasVertex3;
+				fd.shape = &edge;
+				break;
+
+			case b2Shape::e_polygon:
+				// Copied rather than Set() so the hull is not recomputed
+				polygon.m_centroid = f.centroid;
+				polygon.m_count = f.count;
+				memcpy(polygon.m_vertices, f.vertices,
+					   sizeof(b2Vec2) * f.count);
+				memcpy(polygon.m_normals, f.normals, sizeof(b2Vec2) * f.count);
+				fd.shape = &polygon;
+				break;
+
+			case b2Shape::e_chain:
+				chain.CreateChain(chainVertices + f.firstChainVertex, f.count);
+				chain.m_prevVertex = f.vertex0;
+				chain.m_nextVertex = f.vertex3;
+				chain.m_hasPrevVertex = f.hasVertex0;
+				chain.m_hasNextVertex = f.hasVertex3;
+				fd.shape = &chain;
+				break;
+			}
+			const_cast<b2Shape*>(fd.shape)->m_radius = f.radius;
+			fd.density = f.density;
+			fd.friction = f.friction;
+			fd.restitution = f.restitution;
+			fd.filter = f.filter;
+			fd.isSensor = f.isSensor;
+			b->CreateFixture(&fd);
+		}
+
+		int32 k = firstFixtures[i];
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			fixtures[k++] = f;
+		}
+
+		// Overwrite what the definition and the fixtures computed
+		b->m_flags = (uint16) record.flags;
+		b->Xf() = record.xf;
+		b->Xf0() = record.xf0;
+		b->m_sweep = record.sweep;
+		b->LinearVelocity() = record.linearVelocity;
+		b->AngularVelocity() = record.angularVelocity;
+		b->Force() = record.force;
+		b->Torque() = record.torque;
+		b->m_mass = record.mass;
+		b->m_invMass = record.invMass;
+		b->m_I = record.I;
+		b->m_invI = record.invI;
+		b->m_linearDamping = record.linearDamping;
+		b->m_angularDamping = record.angularDamping;
+		b->m_gravityScale = record.gravityScale;
+		b->m_sleepTime = record.sleepTime;
+	}
+
+	// Restore the body list order
+	for (int32 i = 0; i < bodyCount; i++)
+	{
+		bodies[i]->m_prev = i > 0 ? bodies[i - 1] : NULL;
+		bodies[i]->m_next = i + 1 < bodyCount ? bodies[i + 1] : NULL;
+	}
+	world->m_bodyList = bodyCount ? bodies[0] : NULL;
+
+	// Joints and contacts are prepended to the world and body lists, so
+	// creating them in reverse list order restores every list.
+	const int32 jointCount = header.joints.count;
+	const b2JointSnapshot* jointRecords =
+		(const b2JointSnapshot*) (base + header.joints.offset);
+	b2Joint** joints = (b2Joint**) b2Alloc(sizeof(b2Joint*) * (jointCount + 1));
+	for (int32 i = jointCount - 1; i >= 0; i--)
+	{
+		joints[i] = CreateJoint(world, jointRecords[i], bodies, joints);
+		JointValues values = {
+			const_cast<float32*>(jointRecords[i].values), 0, false };
+		VisitJoint(joints[i], values);
+	}
+
+	b2ContactManager& contactManager = world->m_contactManager;
+	const int32 contactCount = header.contacts.count;
+	const b2ContactSnapshot* contactRecords =
+		(const b2ContactSnapshot*) (base + header.contacts.offset);
+	b2Contact** contacts =
+		(b2Contact**) b2Alloc(sizeof(b2Contact*) * (contactCount + 1));
+	CreateContacts(contactRecords, contactCount, fixtures,
+				   contactManager.m_allocator, contacts);
+	for (int32 i = contactCount - 1; i >= 0; i--)
+	{
+		b2Contact* c = contacts[i];
+		if (c == NULL)
+		{
+			continue;
+		}
+		c->m_prev = NULL;
+		c->m_next = contactManager.m_contactList;
+		if (contactManager.m_contactList != NULL)
+		{
+			contactManager.m_contactList->m_prev = c;
+		}
+		contactManager.m_contactList = c;
+
+		b2Body* bodyA = c->m_fixtureA->m_body;
+		b2Body* bodyB = c->m_fixtureB->m_body;
+		c->m_nodeA.contact = c;
+		c->m_nodeA.other = bodyB;
+		c->m_nodeA.prev = NULL;
+		c->m_nodeA.next = bodyA->m_contactList;
+		if (bodyA->m_contactList != NULL)
+		{
+			bodyA->m_contactList->prev = &c->m_nodeA;
+		}
+		bodyA->m_contactList = &c->m_nodeA;
+
+		c->m_nodeB.contact = c;
+		c->m_nodeB.other = bodyA;
+		c->m_nodeB.prev = NULL;
+		c->m_nodeB.next = bodyB->m_contactList;
+		if (bodyB->m_contactList != NULL)
+		{
+			bodyB->m_contactList->prev = &c->m_nodeB;
+		}
+		bodyB->m_contactList = &c->m_nodeB;
+
+		++contactManager.m_contactCount;
+	}
+
+	b2Free(contacts);
+	b2Free(joints);
+	b2Free(bodiesByWorldIndex);
+	b2Free(firstFixtures);
+	b2Free(fixtures);
+	b2Free(bodies);
+
+	// Particle systems are kept when their number matches, so pointers the
+	// caller holds stay valid; otherwise they are all recreated.
+	if (existingCount != particleSystemCount)
+	{
+		while (world->m_particleSystemList)
+		{
+			world->DestroyParticleSystem(world->m_particleSystemList);
+		}
+		for (int32 i = particleSystemCount - 1; i >= 0; i--)
+		{
+			world->CreateParticleSystem(&systemRecords[i].def);
+		}
+	}
+	int32 systemIndex = 0;
+	for (b2ParticleSystem* p = world->m_particleSystemList; p; p = p->m_next)
+	{
+		RestoreParticleSystem(p, systemRecords[systemIndex++], base);
+	}
+	return true;
+}
+
+bool b2WorldSnapshot::HasParticleCapacity(
+	const b2ParticleSystem* p, const b2ParticleSystemSnapshot& record)
+{
+	const int32 count = record.count;
+	if (count <= p->m_internalAllocatedCapacity)
+	{
+		return true;
+	}
+	// The limits ReallocateInternalAllocatedBuffers() grows the buffers to
+	const int32 limits[] = {
+		record.def.maxCount,
+		p->m_flagsBuffer.userSuppliedCapacity,
+		p->m_positionBuffer.userSuppliedCapacity,
+		p->m_velocityBuffer.userSuppliedCapacity,
+		p->m_colorBuffer.userSuppliedCapacity,
+		p->m_userDataBuffer.userSuppliedCapacity,
+	};
+	for (uint32 i = 0; i < sizeof(limits) / sizeof(limits[0]); i++)
+	{
+		if (limits[i] && count > limits[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void b2WorldSnapshot::RestoreParticleSystem(
+	b2ParticleSystem* p, const b2ParticleSystemSnapshot& record,
+	const uint8* base)
+{
+	// Drop the current particles. Handles are released because the indices
+	// they refer to no longer exist.
+	while (p->m_groupList)
+	{
+		p->DestroyParticleGroup(p->m_groupList);
+	}
+	if (p->m_handleIndexBuffer.data)
+	{
+		for (int32 i = 0; i < p->m_count; i++)
+		{
+			b2ParticleHandle* handle = p->m_handleIndexBuffer.data[i];
+			if (handle)
+			{
+				handle->SetIndex(b2_invalidParticleIndex);
+				p->m_handleAllocator.Free(handle);
+				p->m_handleIndexBuffer.data[i] = NULL;
+			}
+		}
+	}
+	p->m_count = 0;
+	p->m_proxyBuffer.SetCount(0);
+	p->m_contactBuffer.SetCount(0);
+	p->m_bodyContactBuffer.SetCount(0);
+	p->m_pairBuffer.SetCount(0);
+	p->m_triadBuffer.SetCount(0);
+	p->m_stuckParticleBuffer.SetCount(0);
+
+	const b2ParticleSystemDef& def = record.def;
+	p->SetStrictContactCheck(def.strictContactCheck);
+	p->SetDensity(def.density);
+	p->SetGravityScale(def.gravityScale);
+	p->SetRadius(def.radius);
+	p->m_def = def;
+	p->SetStuckThreshold(record.stuckThreshold);
+	p->SetDestructionByAge(def.destroyByAge);
+
+	const int32 count = record.count;
+	if (count > p->m_internalAllocatedCapacity)
+	{
+		p->ReallocateInternalAllocatedBuffers(
+			b2Max(count, b2_minParticleSystemBufferCapacity));
+	}
+	// Checked by HasParticleCapacity() before the world was torn down
+	b2Assert(count <= p->m_internalAllocatedCapacity);
+
+	// Buffers that are always allocated
+	memcpy(p->m_flagsBuffer.data, base + record.flagsOffset,
+		   sizeof(uint32) * count);
+	memcpy(p->m_positionBuffer.data, base + record.positionOffset,
+		   sizeof(b2Vec2) * count);
+	memcpy(p->m_velocityBuffer.data, base + record.velocityOffset,
+		   sizeof(b2Vec2) * count);
+	if (record.forceOffset)
+	{
+		memcpy(p->m_forceBuffer, base + record.forceOffset,
+			   sizeof(b2Vec2) * count);
+	}
+	else
+	{
+		for (int32 i = 0; i < count; i++)
+		{
+			p->m_forceBuffer[i].SetZero();
+		}
+	}
+	memset(p->m_weightBuffer, 0, sizeof(float32) * count);
+	for (int32 i = 0; i < count; i++)
+	{
+		p->m_groupBuffer[i] = NULL;
+	}
+	if (p->m_userDataBuffer.data)
+	{
+		memset(p->m_userDataBuffer.data, 0, sizeof(void*) * count);
+	}
+
+	// Optional buffers: allocated if the snapshot has them, cleared if only
+	// the system does
+	if (record.staticPressureOffset)
+	{
+		p->m_staticPressureBuffer =
+			p->RequestBuffer(p->m_staticPressureBuffer);
+		memcpy(p->m_staticPressureBuffer, base + record.staticPressureOffset,
+			   sizeof(float32) * count);
+	}
+	else if (p->m_staticPressureBuffer)
+	{
+		memset(p->m_staticPressureBuffer, 0, sizeof(float32) * count);
+	}
+	if (record.depthOffset)
+	{
+		p->m_depthBuffer = p->RequestBuffer(p->m_depthBuffer);
+		memcpy(p->m_depthBuffer, base + record.depthOffset,
+			   sizeof(float32) * count);
+	}
+	else if (p->m_depthBuffer)
+	{
+		memset(p->m_depthBuffer, 0, sizeof(float32) * count);
+	}
+	if (record.colorOffset)
+	{
+		p->GetColorBuffer();
+		const b2ParticleColor* colors =
+			(const b2ParticleColor*) (base + record.colorOffset);
+		for (int32 i = 0; i < count; i++)
+		{
+			p->m_colorBuffer.data[i] = colors[i];
+		}
+	}
+	else if (p->m_colorBuffer.data)
+	{
+		for (int32 i = 0; i < count; i++)
+		{
+			p->m_colorBuffer.data[i] = b2ParticleColor_zero;
+		}
+	}
+	if (record.lastBodyContactStepOffset && record.bodyContactCountOffset &&
+		record.consecutiveContactStepsOffset &&
+		p->m_lastBodyContactStepBuffer.data)
+	{
+		memcpy(p->m_lastBodyContactStepBuffer.data,
+			   base + record.lastBodyContactStepOffset, sizeof(int32) * count);
+		memcpy(p->m_bodyContactCountBuffer.data,
+			   base + record.bodyContactCountOffset, sizeof(int32) * count);
+		memcpy(p->m_consecutiveContactStepsBuffer.data,
+			   base + record.consecutiveContactStepsOffset,
+			   sizeof(int32) * count);
+	}
+	if (record.expirationTimeOffset)
+	{
+		p->GetExpirationTimeBuffer();
+		memcpy(p->m_expirationTimeBuffer.data,
+			   base + record.expirationTimeOffset, sizeof(int32) * count);
+	}
+	if (record.indexByExpirationTimeOffset)
+	{
+		// Only allocates while the system is empty
+		p->GetIndexByExpirationTimeBuffer();
+		memcpy(p->m_indexByExpirationTimeBuffer.data,
+			   base + record.indexByExpirationTimeOffset,
+			   sizeof(int32) * count);
+	}
+	if (p->m_handleIndexBuffer.data)
+	{
+		memset(p->m_handleIndexBuffer.data, 0,
+			   sizeof(b2ParticleHandle*) * count);
+	}
+
+	p->m_count = count;
+	for (int32 i = 0; i < count; i++)
+	{
+		b2ParticleSystem::Proxy& proxy = p->m_proxyBuffer.Append();
+		proxy.index = i;
+	}
+	p->m_pairBuffer.Reserve(record.pairCount);
+	p->m_pairBuffer.SetCount(record.pairCount);
+	if (record.pairCount)
+	{
+		memcpy(p->m_pairBuffer.Data(), base + record.pairOffset,
+			   sizeof(b2ParticlePair) * record.pairCount);
+	}
+	p->m_triadBuffer.Reserve(record.triadCount);
+	p->m_triadBuffer.SetCount(record.triadCount);
+	if (record.triadCount)
+	{
+		memcpy(p->m_triadBuffer.Data(), base + record.triadOffset,
+			   sizeof(b2ParticleTriad) * record.triadCount);
+	}
+
+	// Groups are prepended to the list, so create them in reverse
+	const b2ParticleGroupSnapshot* groups =
+		(const b2ParticleGroupSnapshot*) (base + record.groupOffset);
+	for (int32 k = record.groupCount - 1; k >= 0; k--)
+	{
+		const b2ParticleGroupSnapshot& g = groups[k];
+		void* mem = p->m_world->m_blockAllocator.Allocate(
+			sizeof(b2ParticleGroup));
+		b2ParticleGroup* group = new (mem) b2ParticleGroup();
+		group->m_system = p;
+		group->m_firstIndex = g.firstIndex;
+		group->m_lastIndex = g.lastIndex;
+		group->m_strength = g.strength;
+		group->m_timestamp = g.timestamp;
+		group->m_mass = g.mass;
+		group->m_inertia = g.inertia;
+		group->m_center = g.center;
+		group->m_linearVelocity = g.linearVelocity;
+		group->m_angularVelocity = g.angularVelocity;
+		group->m_transform = g.transform;
+		group->m_prev = NULL;
+		group->m_next = p->m_groupList;
+		if (p->m_groupList)
+		{
+			p->m_groupList->m_prev = group;
+		}
+		p->m_groupList = group;
+		++p->m_groupCount;
+		for (int32 i = g.firstIndex; i < g.lastIndex; i++)
+		{
+			p->m_groupBuffer[i] = group;
+		}
+		// Requests the buffers the flags need; the flags themselves are
+		// restored as saved, without scheduling a depth update.
+		p->SetGroupFlags(group, g.groupFlags);
+		group->m_groupFlags = g.groupFlags;
+	}
+
+	p->m_timestamp = record.timestamp;
+	p->m_timeElapsed = record.timeElapsed;
+	p->m_paused = record.paused;
+	p->m_hasForce = record.hasForce;
+	p->m_expirationTimeBufferRequiresSorting =
+		record.expirationTimeBufferRequiresSorting;
+
+	// Accumulate the particle flags, allocating the buffers they need the
+	// first time each flag is seen
+	p->m_allParticleFlags = 0;
+	for (int32 i = 0; i < count; i++)
+	{
+		const uint32 flags = p->m_flagsBuffer.data[i];
+		if (~p->m_allParticleFlags & flags)
+		{
+			p->SetParticleFlags(i, flags);
+		}
+	}
+	p->UpdateAllGroupFlags();
+}
@@ -0,0 +1,245 @@
+#ifndef B2_WORLD_SNAPSHOT_H
+#define B2_WORLD_SNAPSHOT_H
+
+#include <Box2D/Common/b2Math.h>
+#include <Box2D/Collision/b2Collision.h>
+#include <Box2D/Dynamics/b2Fixture.h>
+#include <Box2D/Particle/b2ParticleSystem.h>
+
+class b2World;
+class b2Body;
+class b2Joint;
+class b2Contact;
+class b2ParticleGroup;
+
+/// Identifies a snapshot ("B2SS").
+const uint32 b2_snapshotMagic = 0x53533242;
+/// Incremented whenever the layout of any snapshot record changes.
+const uint32 b2_snapshotVersion = 1;
+/// Written as is, so a snapshot saved with another byte order is rejected.
+const uint32 b2_snapshotByteOrder = 0x01020304;
+/// Maximum number of values saved per joint.
+const int32 b2_maxJointSnapshotValues = 24;
+
+/// Array of records within a snapshot. Offsets are in bytes from the start
+/// of the snapshot and are multiples of 8.
+struct b2SnapshotSection
+{
+	uint32 offset;
+	int32 count;
+};
+
+/// World settings and the location of every other section.
+struct b2SnapshotHeader
+{
+	uint32 magic;
+	uint32 version;
+	uint32 byteOrder;
+	/// Total size of the snapshot in bytes.
+	uint32 size;
+	b2Vec2 gravity;
+	float32 inv_dt0;
+	/// b2WorldSnapshot::e_* flags.
+	uint32 flags;
+	b2SnapshotSection bodies;
+	b2SnapshotSection fixtures;
+	b2SnapshotSection chainVertices;
+	b2SnapshotSection joints;
+	b2SnapshotSection contacts;
+	b2SnapshotSection particleSystems;
+};
+
+/// A body, in world body list order. Its fixtures follow those of the
+/// previous bodies in the fixture section.
+struct b2BodySnapshot
+{
+	int32 type;
+	/// Slot in the world's body table, which sets the solver order.
+	int32 worldIndex;
+	uint32 flags;
+	int32 fixtureCount;
+	b2Transform xf;
+	b2Transform xf0;
+	b2Sweep sweep;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+	b2Vec2 force;
+	float32 torque;
+	float32 mass, invMass;
+	float32 I, invI;
+	float32 linearDamping;
+	float32 angularDamping;
+	float32 gravityScale;
+	float32 sleepTime;
+};
+
+/// A fixture and its shape, in body fixture list order.
+struct b2FixtureSnapshot
+{
+	int32 shapeType;
+	float32 radius;
+	float32 density;
+	float32 friction;
+	float32 restitution;
+	b2Filter filter;
+	bool isSensor;
+	/// Edge and chain adjacency.
+	bool hasVertex0, hasVertex3;
+	b2Vec2 vertex0, vertex3;
+	/// Polygon vertex count, or chain vertex count.
+	int32 count;
+	/// First vertex of a chain in the chain vertex section.
+	int32 firstChainVertex;
+	/// Polygon centroid.
+	b2Vec2 centroid;
+	/// Circle center, edge end points or polygon vertices.
+	b2Vec2 vertices[b2_maxPolygonVertices];
+	b2Vec2 normals[b2_maxPolygonVertices];
+};
+
+/// A joint, in world joint list order.
+struct b2JointSnapshot
+{
+	int32 type;
+	/// Indices in the body section.
+	int32 bodyA, bodyB;
+	/// Gear joints: indices of the connected joints in the joint section.
+	int32 joint1, joint2;
+	bool collideConnected;
+	/// Parameters and accumulated impulses, in an order fixed per type.
+	float32 values[b2_maxJointSnapshotValues];
+};
+
+/// A contact with its manifold, in world contact list order. The normal and
+/// tangent impulses of the manifold points warm start the next step.
+struct b2ContactSnapshot
+{
+	/// Indices in the fixture section.
+	int32 fixtureA, fixtureB;
+	int32 childA, childB;
+	uint32 flags;
+	int32 toiCount;
+	float32 toi;
+	float32 friction;
+	float32 restitution;
+	float32 tangentSpeed;
+	b2Manifold manifold;
+};
+
+/// A particle group. Its particles are [firstIndex, lastIndex).
+struct b2ParticleGroupSnapshot
+{
+	int32 firstIndex, lastIndex;
+	uint32 groupFlags;
+	float32 strength;
+	int32 timestamp;
+	float32 mass;
+	float32 inertia;
+	b2Vec2 center;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+	b2Transform transform;
+};
+
+/// A particle system, in world particle system list order. Each per
+/// particle buffer is stored contiguously so it can be copied in one go; an
+/// offset of 0 marks a buffer the system did not allocate.
+struct b2ParticleSystemSnapshot
+{
+	b2ParticleSystemDef def;
+	int32 count;
+	int32 groupCount;
+	int32 pairCount;
+	int32 triadCount;
+	int32 timestamp;
+	int32 stuckThreshold;
+	int64 timeElapsed;
+	bool paused;
+	bool hasForce;
+	bool expirationTimeBufferRequiresSorting;
+	uint32 flagsOffset;
+	uint32 positionOffset;
+	uint32 velocityOffset;
+	uint32 forceOffset;
+	uint32 staticPressureOffset;
+	uint32 depthOffset;
+	uint32 colorOffset;
+	uint32 lastBodyContactStepOffset;
+	uint32 bodyContactCountOffset;
+	uint32 consecutiveContactStepsOffset;
+	uint32 expirationTimeOffset;
+	uint32 indexByExpirationTimeOffset;
+	uint32 pairOffset;
+	uint32 triadOffset;
+	uint32 groupOffset;
+};
+
+/// Saves and restores the complete state of a world: bodies, fixtures,
+/// joints, contacts with their warm starting impulses and particle systems
+/// with all of their particle buffers.
+///
+/// A snapshot is a single block of memory without pointers. Restore reads
+/// it in place, so it can be restored directly from a memory mapped file;
+/// particle buffers are copied with one memcpy each. Snapshots are only
+/// valid on machines with the same byte order and structure layout.
+///
+/// User data, particle handles and destruction listener state are not
+/// saved: after a restore, body, fixture, joint, group and particle user
+/// data are NULL, and previously obtained pointers to bodies, fixtures,
+/// joints, contacts and particle groups are invalid. Bodies keep their
+/// order in the body list, so callers can map their own data by position.
+class b2WorldSnapshot
+{
+public:
+	/// Get the number of bytes Save() writes for the current state of the
+	/// world.
+	static uint32 GetSize(const b2World* world);
+
+	/// Write the state of the world into the buffer, which must be 8 byte
+	/// aligned.
+	/// @warning this should be called outside of a time step.
+	/// @return the number of bytes written, or 0 if capacity is too small.
+	static uint32 Save(const b2World* world, void* buffer, uint32 capacity);
+
+	/// Replace the contents of the world with a snapshot. Particle systems
+	/// are restored in place when the world has as many as the snapshot,
+	/// otherwise they are recreated.
+	/// @warning this should be called outside of a time step.
+	/// @return false, leaving the world untouched, if the data is not a
+	/// valid snapshot of this version or a particle system with user
+	/// supplied buffers cannot hold the saved particles.
+	static bool Restore(b2World* world, const void* data, uint32 size);
+
+private:
+	enum
+	{
+		e_allowSleep		= 0x0001,
+		e_warmStarting		= 0x0002,
+		e_continuousPhysics	= 0x0004,
+		e_subStepping		= 0x0008,
+		e_stepComplete		= 0x0010,
+		e_clearForces		= 0x0020
+	};
+
+	class Writer;
+	struct JointValues;
+
+	static uint32 Write(const b2World* world, Writer& writer);
+	static void WriteParticleSystem(const b2ParticleSystem* system,
+									b2ParticleSystemSnapshot* record,
+									Writer& writer);
+	static void VisitJoint(b2Joint* joint, JointValues& values);
+	static b2Joint* CreateJoint(b2World* world, const b2JointSnapshot& record,
+								b2Body** bodies, b2Joint** joints);
+	static void CreateContacts(const b2ContactSnapshot* records, int32 count,
+							   b2Fixture** fixtures, b2BlockAllocator* allocator,
+							   b2Contact** contacts);
+	static bool Validate(const void* data, uint32 size);
+	static bool HasParticleCapacity(const b2ParticleSystem* system,
+									const b2ParticleSystemSnapshot& record);
+	static void RestoreParticleSystem(b2ParticleSystem* system,
+									  const b2ParticleSystemSnapshot& record,
+									  const uint8* base);
+};
+
+#endif
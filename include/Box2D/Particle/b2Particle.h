@@ -332,6 +332,7 @@ class b2ParticleHandle : public b2TypedIntrusiveListNode<b2ParticleHandle>
 	// Allow b2ParticleSystem to use SetIndex() to associate particle handles
 	// with particle indices.
 	friend class b2ParticleSystem;
+	friend class b2WorldSnapshot;
 
 public:
 	/// Initialize the index associated with the handle to an invalid index.
@@ -262,6 +262,7 @@ public:
 private:
 
 	friend class b2ParticleSystem;
+	friend class b2WorldSnapshot;
 
 	b2ParticleSystem* m_system;
 	int32 m_firstIndex, m_lastIndex;
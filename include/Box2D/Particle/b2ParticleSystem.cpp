@@ -20,6 +20,7 @@
 #include <Box2D/Particle/b2VoronoiDiagram.h>
 #include <Box2D/Particle/b2ParticleAssembly.h>
 #include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2WorkerPool.h>
 #include <Box2D/Dynamics/b2World.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/b2Body.h>
@@ -28,6 +29,7 @@
 #include <Box2D/Collision/Shapes/b2EdgeShape.h>
 #include <Box2D/Collision/Shapes/b2ChainShape.h>
 #include <algorithm>
+#include <atomic>
 
 // Define LIQUIDFUN_SIMD_TEST_VS_REFERENCE to run both SIMD and reference
 // versions, and assert that the results are identical. This is useful when
@@ -417,6 +419,7 @@ b2ParticleSystem::b2ParticleSystem(const b2ParticleSystemDef* def,
 	m_accumulationBuffer = NULL;
 	m_accumulation2Buffer = NULL;
 	m_depthBuffer = NULL;
+	m_workerPool = NULL;
 	m_groupBuffer = NULL;
 
 	m_groupCount = 0;
@@ -429,6 +432,9 @@ b2ParticleSystem::b2ParticleSystem(const b2ParticleSystemDef* def,
 
 	m_stuckThreshold = 0;
 
+	m_strictTriadCheck = false;
+	m_triadCheckFailureCount = 0;
+
 	m_timeElapsed = 0;
 	m_expirationTimeBufferRequiresSorting = false;
 
@@ -460,6 +466,12 @@ b2ParticleSystem::~b2ParticleSystem()
 	FreeBuffer(&m_accumulation2Buffer, m_internalAllocatedCapacity);
 	FreeBuffer(&m_depthBuffer, m_internalAllocatedCapacity);
 	FreeBuffer(&m_groupBuffer, m_internalAllocatedCapacity);
+
+	if (m_workerPool)
+	{
+		m_workerPool->~b2WorkerPool();
+		b2Free(m_workerPool);
+	}
 }
 
 template <typename T> void b2ParticleSystem::FreeBuffer(T** b, int capacity)
@@ -555,6 +567,9 @@ template <typename T> T* b2ParticleSystem::RequestBuffer(T* buffer)
 	return buffer;
 }
 
+// b2WorldSnapshot requests the optional float buffers when restoring
+template float32* b2ParticleSystem::RequestBuffer(float32* buffer);
+
 b2ParticleColor* b2ParticleSystem::GetColorBuffer()
 {
 	m_colorBuffer.data = RequestBuffer(m_colorBuffer.data);
@@ -1108,6 +1123,24 @@ b2ParticleGroup* b2ParticleSystem::CreateParticleGroup(
 	return group;
 }
 
+// Compute the bounds of a range of particles, extended by a margin.
+static void computeParticleAABB(
+	const b2Vec2* positions, int32 firstIndex, int32 lastIndex,
+	float32 margin, b2AABB* aabb)
+{
+	aabb->lowerBound.Set(+b2_maxFloat, +b2_maxFloat);
+	aabb->upperBound.Set(-b2_maxFloat, -b2_maxFloat);
+	for (int32 i = firstIndex; i < lastIndex; i++)
+	{
+		aabb->lowerBound = b2Min(aabb->lowerBound, positions[i]);
+		aabb->upperBound = b2Max(aabb->upperBound, positions[i]);
+	}
+	aabb->lowerBound.x -= margin;
+	aabb->lowerBound.y -= margin;
+	aabb->upperBound.x += margin;
+	aabb->upperBound.y += margin;
+}
+
 void b2ParticleSystem::JoinParticleGroups(b2ParticleGroup* groupA,
 										  b2ParticleGroup* groupB)
 {
@@ -1124,9 +1157,23 @@ void b2ParticleSystem::JoinParticleGroups(b2ParticleGroup* groupA,
 				 groupB->m_firstIndex);
 	b2Assert(groupA->m_lastIndex == groupB->m_firstIndex);
 
-	// Create pairs and triads connecting groupA and groupB.
+	// Create pairs and triads connecting groupA and groupB. Every particle
+	// of such a triad is within triad distance of the other group, so only
+	// those are necessary and the rest of both groups is not re-triangulated.
 	class JoinParticleGroupsFilter : public ConnectionFilter
 	{
+		bool IsNecessary(int32 index) const
+		{
+			const b2AABB& aabb = index < m_threshold ? m_aabbB : m_aabbA;
+			const b2Vec2& p = m_positionBuffer[index];
+			return aabb.lowerBound.x <= p.x && p.x <= aabb.upperBound.x &&
+				   aabb.lowerBound.y <= p.y && p.y <= aabb.upperBound.y;
+		}
+		bool IsInRegion(int32 index) const
+		{
+			B2_NOT_USED(index);
+			return true;
+		}
 		bool ShouldCreatePair(int32 a, int32 b) const
 		{
 			return
@@ -1140,12 +1187,27 @@ void b2ParticleSystem::JoinParticleGroups(b2ParticleGroup* groupA,
 				(m_threshold <= a || m_threshold <= b || m_threshold <= c);
 		}
 		int32 m_threshold;
+		const b2Vec2* m_positionBuffer;
+		b2AABB m_aabbA, m_aabbB;
 	public:
-		JoinParticleGroupsFilter(int32 threshold)
+		JoinParticleGroupsFilter(
+			int32 threshold, const b2Vec2* positionBuffer,
+			const b2AABB& aabbA, const b2AABB& aabbB)
 		{
 			m_threshold = threshold;
+			m_positionBuffer = positionBuffer;
+			m_aabbA = aabbA;
+			m_aabbB = aabbB;
 		}
-	} filter(groupB->m_firstIndex);
+	};
+	float32 triadDistance = b2_maxTriadDistance * m_particleDiameter;
+	b2AABB aabbA, aabbB;
+	computeParticleAABB(m_positionBuffer.data, groupA->m_firstIndex,
+						groupA->m_lastIndex, triadDistance, &aabbA);
+	computeParticleAABB(m_positionBuffer.data, groupB->m_firstIndex,
+						groupB->m_lastIndex, triadDistance, &aabbB);
+	JoinParticleGroupsFilter filter(
+		groupB->m_firstIndex, m_positionBuffer.data, aabbA, aabbB);
 	UpdateContacts(true);
 	UpdatePairsAndTriads(groupA->m_firstIndex, groupB->m_lastIndex, filter);
 
@@ -1512,14 +1574,219 @@ void b2ParticleSystem::UpdatePairsAndTriads(
 										   m_positionBuffer.data[b]);
 			}
 		}
-		std::stable_sort(
-			m_pairBuffer.Begin(), m_pairBuffer.End(), ComparePairIndices);
-		m_pairBuffer.Unique(MatchPairIndices);
+		SortAndRemoveDuplicatePairs();
 	}
 	if (particleFlags & k_triadFlags)
 	{
-		b2VoronoiDiagram diagram(
-			&m_world->m_stackAllocator, lastIndex - firstIndex);
+		UpdateTriads(firstIndex, lastIndex, filter);
+		SortAndRemoveDuplicateTriads();
+	}
+}
+
+static inline uint64 computeVoronoiTile(int32 x, int32 y)
+{
+	return ((uint64) ((uint32) y ^ 0x80000000u) << 32) |
+		   (uint64) ((uint32) x ^ 0x80000000u);
+}
+
+static inline float32 computeVoronoiCellCount(
+	const b2Vec2& lower, const b2Vec2& upper, float32 margin,
+	float32 inverseRadius)
+{
+	return (1 + inverseRadius * (upper.x - lower.x + 2 * margin)) *
+		   (1 + inverseRadius * (upper.y - lower.y + 2 * margin));
+}
+
+static bool LessTriadIndices(const b2ParticleTriad& a, const b2ParticleTriad& b)
+{
+	if (a.indexA != b.indexA)
+	{
+		return a.indexA < b.indexA;
+	}
+	if (a.indexB != b.indexB)
+	{
+		return a.indexB < b.indexB;
+	}
+	return a.indexC < b.indexC;
+}
+
+static bool EqualTriadIndices(const b2ParticleTriad& a, const b2ParticleTriad& b)
+{
+	return a.indexA == b.indexA && a.indexB == b.indexB && a.indexC == b.indexC;
+}
+
+// Whether two lists of triads, which may hold duplicates, connect the same
+// particles. Sorts the second list in place.
+static bool HaveSameTriadIndices(
+	const b2ParticleTriad* triadsA, int32 countA,
+	b2ParticleTriad* triadsB, int32 countB, b2StackAllocator* allocator)
+{
+	b2ParticleTriad* sortedA = (b2ParticleTriad*) allocator->Allocate(
+		sizeof(b2ParticleTriad) * countA);
+	memcpy(sortedA, triadsA, sizeof(b2ParticleTriad) * countA);
+	std::sort(sortedA, sortedA + countA, LessTriadIndices);
+	b2ParticleTriad* endA = std::unique(
+		sortedA, sortedA + countA, EqualTriadIndices);
+	std::sort(triadsB, triadsB + countB, LessTriadIndices);
+	b2ParticleTriad* endB = std::unique(
+		triadsB, triadsB + countB, EqualTriadIndices);
+	bool same = endA - sortedA == endB - triadsB &&
+				std::equal(sortedA, endA, triadsB, EqualTriadIndices);
+	allocator->Free(sortedA);
+	return same;
+}
+
+void b2ParticleSystem::UpdateTriads(
+	int32 firstIndex, int32 lastIndex, const ConnectionFilter& filter)
+{
+	class UpdateTriadsCallback : public b2VoronoiDiagram::NodeCallback
+	{
+		void operator()(int32 a, int32 b, int32 c)
+		{
+			uint32 af = m_system->m_flagsBuffer.data[a];
+			uint32 bf = m_system->m_flagsBuffer.data[b];
+			uint32 cf = m_system->m_flagsBuffer.data[c];
+			if (((af | bf | cf) & k_triadFlags) &&
+				m_filter->ShouldCreateTriad(a, b, c))
+			{
+				const b2Vec2& pa = m_system->m_positionBuffer.data[a];
+				const b2Vec2& pb = m_system->m_positionBuffer.data[b];
+				const b2Vec2& pc = m_system->m_positionBuffer.data[c];
+				b2Vec2 dab = pa - pb;
+				b2Vec2 dbc = pb - pc;
+				b2Vec2 dca = pc - pa;
+				float32 maxDistanceSquared = b2_maxTriadDistanceSquared *
+											 m_system->m_squaredDiameter;
+				if (b2Dot(dab, dab) > maxDistanceSquared ||
+					b2Dot(dbc, dbc) > maxDistanceSquared ||
+					b2Dot(dca, dca) > maxDistanceSquared)
+				{
+					return;
+				}
+				b2ParticleGroup* groupA = m_system->m_groupBuffer[a];
+				b2ParticleGroup* groupB = m_system->m_groupBuffer[b];
+				b2ParticleGroup* groupC = m_system->m_groupBuffer[c];
+				b2ParticleTriad& triad = m_system->m_triadBuffer.Append();
+				triad.indexA = a;
+				triad.indexB = b;
+				triad.indexC = c;
+				triad.flags = af | bf | cf;
+				triad.strength = b2Min(b2Min(
+					groupA ? groupA->m_strength : 1,
+					groupB ? groupB->m_strength : 1),
+					groupC ? groupC->m_strength : 1);
+				b2Vec2 midPoint = (float32) 1 / 3 * (pa + pb + pc);
+				triad.pa = pa - midPoint;
+				triad.pb = pb - midPoint;
+				triad.pc = pc - midPoint;
+				triad.ka = -b2Dot(dca, dab);
+				triad.kb = -b2Dot(dab, dbc);
+				triad.kc = -b2Dot(dbc, dca);
+				triad.s = b2Cross(pa, pb) + b2Cross(pb, pc) + b2Cross(pc, pa);
+			}
+		}
+		b2ParticleSystem* m_system;
+		const ConnectionFilter* m_filter;
+	public:
+		UpdateTriadsCallback(
+			b2ParticleSystem* system, const ConnectionFilter* filter)
+		{
+			m_system = system;
+			m_filter = filter;
+		}
+	} callback(this, &filter);
+
+	int32 firstTriad = m_triadBuffer.GetCount();
+	float32 stride = GetParticleStride();
+	float32 radius = stride / 2;
+	float32 margin = stride * 2;
+	float32 inverseTileSize = 1 / (b2_voronoiTileStride * stride);
+
+	// Bucket the particles that can be connected by tile and find the extent
+	// of the region and of the necessary particles. Every diagram below is
+	// a window of the diagram of the region, so the triads found depend
+	// neither on how the necessary particles are tiled nor on which of the
+	// region's particles are necessary.
+	VoronoiTileProxy* proxies = (VoronoiTileProxy*) m_world->
+		m_stackAllocator.Allocate(
+			sizeof(VoronoiTileProxy) * (lastIndex - firstIndex));
+	int32 proxyCount = 0;
+	b2Vec2 lower(+b2_maxFloat, +b2_maxFloat);
+	b2Vec2 upper(-b2_maxFloat, -b2_maxFloat);
+	b2Vec2 necessaryLower(+b2_maxFloat, +b2_maxFloat);
+	b2Vec2 necessaryUpper(-b2_maxFloat, -b2_maxFloat);
+	for (int32 i = firstIndex; i < lastIndex; i++)
+	{
+		uint32 flags = m_flagsBuffer.data[i];
+		b2ParticleGroup* group = m_groupBuffer[i];
+		if (!(flags & b2_zombieParticle) &&
+			ParticleCanBeConnected(flags, group))
+		{
+			const b2Vec2& p = m_positionBuffer.data[i];
+			VoronoiTileProxy& proxy = proxies[proxyCount++];
+			proxy.tile = computeVoronoiTile(
+				(int32) floorf(inverseTileSize * p.x),
+				(int32) floorf(inverseTileSize * p.y));
+			proxy.index = i;
+			proxy.necessary = filter.IsNecessary(i);
+			if (filter.IsInRegion(i))
+			{
+				lower = b2Min(lower, p);
+				upper = b2Max(upper, p);
+			}
+			if (proxy.necessary)
+			{
+				necessaryLower = b2Min(necessaryLower, p);
+				necessaryUpper = b2Max(necessaryUpper, p);
+			}
+		}
+	}
+	if (necessaryLower.x > necessaryUpper.x)
+	{
+		// No particle needs a connection, so no triad can be created.
+		m_world->m_stackAllocator.Free(proxies);
+		return;
+	}
+	VoronoiTileProxy* endProxy = proxies + proxyCount;
+	std::sort(proxies, endProxy);
+
+	// Compare the raster of one diagram spanning all necessary particles with
+	// the rasters of separate diagrams around each tile holding necessary
+	// particles. Separated clusters of changes, such as reactive particles
+	// scattered over a large group or the seam between two joined groups,
+	// are cheaper to re-triangulate one at a time.
+	float32 inverseRadius = 1 / radius;
+	float32 extent = 2 * margin + radius;
+	float32 globalCellCount = computeVoronoiCellCount(
+		necessaryLower, necessaryUpper, extent, inverseRadius);
+	float32 tiledCellCount = 0;
+	int32 tileCount = 0;
+	for (const VoronoiTileProxy* first = proxies; first < endProxy;)
+	{
+		b2Vec2 tileLower(+b2_maxFloat, +b2_maxFloat);
+		b2Vec2 tileUpper(-b2_maxFloat, -b2_maxFloat);
+		const VoronoiTileProxy* last = first;
+		for (; last < endProxy && last->tile == first->tile; last++)
+		{
+			if (last->necessary)
+			{
+				const b2Vec2& p = m_positionBuffer.data[last->index];
+				tileLower = b2Min(tileLower, p);
+				tileUpper = b2Max(tileUpper, p);
+			}
+		}
+		if (tileLower.x <= tileUpper.x)
+		{
+			tiledCellCount += computeVoronoiCellCount(
+				tileLower, tileUpper, extent, inverseRadius);
+			tileCount++;
+		}
+		first = last;
+	}
+
+	if (tileCount <= 1 || globalCellCount <= tiledCellCount)
+	{
+		b2VoronoiDiagram diagram(&m_world->m_stackAllocator, proxyCount);
 		for (int32 i = firstIndex; i < lastIndex; i++)
 		{
 			uint32 flags = m_flagsBuffer.data[i];
@@ -1531,93 +1798,242 @@ void b2ParticleSystem::UpdatePairsAndTriads(
 					m_positionBuffer.data[i], i, filter.IsNecessary(i));
 			}
 		}
-		float32 stride = GetParticleStride();
-		diagram.Generate(stride / 2, stride * 2);
-		class UpdateTriadsCallback : public b2VoronoiDiagram::NodeCallback
-		{
-			void operator()(int32 a, int32 b, int32 c)
+		diagram.Generate(radius, margin, lower, upper);
+		diagram.GetNodes(callback);
+	}
+	else
+	{
+		// The window is smaller than a tile, so the generators of a tile's
+		// diagram come from the tile and its eight neighbors. Only the tile's
+		// own particles are necessary; triads spanning two tiles are found
+		// by both and removed by SortAndRemoveDuplicateTriads().
+		b2Assert(extent + radius < b2_voronoiTileStride * stride);
+		for (const VoronoiTileProxy* first = proxies; first < endProxy;)
+		{
+			uint64 tile = first->tile;
+			b2Vec2 tileLower(+b2_maxFloat, +b2_maxFloat);
+			b2Vec2 tileUpper(-b2_maxFloat, -b2_maxFloat);
+			const VoronoiTileProxy* last = first;
+			for (; last < endProxy && last->tile == tile; last++)
 			{
-				uint32 af = m_system->m_flagsBuffer.data[a];
-				uint32 bf = m_system->m_flagsBuffer.data[b];
-				uint32 cf = m_system->m_flagsBuffer.data[c];
-				if (((af | bf | cf) & k_triadFlags) &&
-					m_filter->ShouldCreateTriad(a, b, c))
+				if (last->necessary)
 				{
-					const b2Vec2& pa = m_system->m_positionBuffer.data[a];
-					const b2Vec2& pb = m_system->m_positionBuffer.data[b];
-					const b2Vec2& pc = m_system->m_positionBuffer.data[c];
-					b2Vec2 dab = pa - pb;
-					b2Vec2 dbc = pb - pc;
-					b2Vec2 dca = pc - pa;
-					float32 maxDistanceSquared = b2_maxTriadDistanceSquared *
-												 m_system->m_squaredDiameter;
-					if (b2Dot(dab, dab) > maxDistanceSquared ||
-						b2Dot(dbc, dbc) > maxDistanceSquared ||
-						b2Dot(dca, dca) > maxDistanceSquared)
+					const b2Vec2& p = m_positionBuffer.data[last->index];
+					tileLower = b2Min(tileLower, p);
+					tileUpper = b2Max(tileUpper, p);
+				}
+			}
+			first = last;
+			if (tileLower.x > tileUpper.x)
+			{
+				continue;
+			}
+			// Generators farther than this from the necessary ones fall
+			// outside the raster built by b2VoronoiDiagram::Generate().
+			b2Vec2 reach(extent + radius, extent + radius);
+			tileLower -= reach;
+			tileUpper += reach;
+			int32 tileX = (int32) ((uint32) tile ^ 0x80000000u);
+			int32 tileY = (int32) ((uint32) (tile >> 32) ^ 0x80000000u);
+			int32 candidateCapacity = 0;
+			for (int32 y = tileY - 1; y <= tileY + 1; y++)
+			{
+				candidateCapacity += (int32) (
+					std::upper_bound(proxies, endProxy,
+									 computeVoronoiTile(tileX + 1, y)) -
+					std::lower_bound(proxies, endProxy,
+									 computeVoronoiTile(tileX - 1, y)));
+			}
+			VoronoiTileProxy* candidates = (VoronoiTileProxy*) m_world->
+				m_stackAllocator.Allocate(
+					sizeof(VoronoiTileProxy) * candidateCapacity);
+			int32 candidateCount = 0;
+			for (int32 y = tileY - 1; y <= tileY + 1; y++)
+			{
+				const VoronoiTileProxy* rowFirst = std::lower_bound(
+					proxies, endProxy, computeVoronoiTile(tileX - 1, y));
+				const VoronoiTileProxy* rowLast = std::upper_bound(
+					proxies, endProxy, computeVoronoiTile(tileX + 1, y));
+				for (const VoronoiTileProxy* proxy = rowFirst;
+					 proxy < rowLast; proxy++)
+				{
+					const b2Vec2& p = m_positionBuffer.data[proxy->index];
+					if (p.x >= tileLower.x && p.x <= tileUpper.x &&
+						p.y >= tileLower.y && p.y <= tileUpper.y)
 					{
-						return;
+						VoronoiTileProxy& candidate =
+							candidates[candidateCount++];
+						// With the tile cleared the candidates sort by index,
+						// the order in which a single diagram adds them.
+						candidate.tile = 0;
+						candidate.index = proxy->index;
+						candidate.necessary =
+							proxy->necessary && proxy->tile == tile;
 					}
-					b2ParticleGroup* groupA = m_system->m_groupBuffer[a];
-					b2ParticleGroup* groupB = m_system->m_groupBuffer[b];
-					b2ParticleGroup* groupC = m_system->m_groupBuffer[c];
-					b2ParticleTriad& triad = m_system->m_triadBuffer.Append();
-					triad.indexA = a;
-					triad.indexB = b;
-					triad.indexC = c;
-					triad.flags = af | bf | cf;
-					triad.strength = b2Min(b2Min(
-						groupA ? groupA->m_strength : 1,
-						groupB ? groupB->m_strength : 1),
-						groupC ? groupC->m_strength : 1);
-					b2Vec2 midPoint = (float32) 1 / 3 * (pa + pb + pc);
-					triad.pa = pa - midPoint;
-					triad.pb = pb - midPoint;
-					triad.pc = pc - midPoint;
-					triad.ka = -b2Dot(dca, dab);
-					triad.kb = -b2Dot(dab, dbc);
-					triad.kc = -b2Dot(dbc, dca);
-					triad.s = b2Cross(pa, pb) + b2Cross(pb, pc) + b2Cross(pc, pa);
 				}
 			}
-			b2ParticleSystem* m_system;
-			const ConnectionFilter* m_filter;
-		public:
-			UpdateTriadsCallback(
-				b2ParticleSystem* system, const ConnectionFilter* filter)
+			std::sort(candidates, candidates + candidateCount);
 			{
-				m_system = system;
-				m_filter = filter;
+				b2VoronoiDiagram diagram(
+					&m_world->m_stackAllocator, candidateCount);
+				for (int32 k = 0; k < candidateCount; k++)
+				{
+					const VoronoiTileProxy& candidate = candidates[k];
+					diagram.AddGenerator(
+						m_positionBuffer.data[candidate.index],
+						candidate.index, candidate.necessary);
+				}
+				diagram.Generate(radius, margin, lower, upper);
+				diagram.GetNodes(callback);
 			}
-		} callback(this, &filter);
-		diagram.GetNodes(callback);
-		std::stable_sort(
-			m_triadBuffer.Begin(), m_triadBuffer.End(), CompareTriadIndices);
-		m_triadBuffer.Unique(MatchTriadIndices);
+			m_world->m_stackAllocator.Free(candidates);
+		}
+	}
+	m_world->m_stackAllocator.Free(proxies);
+
+	if (m_strictTriadCheck)
+	{
+		// Triangulate the whole region at once with all of it necessary, as
+		// if nothing were incremental, and compare with the triads above.
+		int32 triadCount = m_triadBuffer.GetCount();
+		{
+			b2VoronoiDiagram diagram(&m_world->m_stackAllocator, proxyCount);
+			for (int32 i = firstIndex; i < lastIndex; i++)
+			{
+				uint32 flags = m_flagsBuffer.data[i];
+				b2ParticleGroup* group = m_groupBuffer[i];
+				if (!(flags & b2_zombieParticle) &&
+					ParticleCanBeConnected(flags, group))
+				{
+					diagram.AddGenerator(
+						m_positionBuffer.data[i], i, filter.IsInRegion(i));
+				}
+			}
+			diagram.Generate(radius, margin);
+			diagram.GetNodes(callback);
+		}
+		if (!HaveSameTriadIndices(
+				m_triadBuffer.Data() + firstTriad, triadCount - firstTriad,
+				m_triadBuffer.Data() + triadCount,
+				m_triadBuffer.GetCount() - triadCount,
+				&m_world->m_stackAllocator))
+		{
+			m_triadCheckFailureCount++;
+		}
+		m_triadBuffer.SetCount(triadCount);
 	}
 }
 
-bool b2ParticleSystem::ComparePairIndices(
-							const b2ParticlePair& a, const b2ParticlePair& b)
+// Stable LSD radix sort of a pair or triad buffer on its particle indices,
+// the first index being the most significant, followed by removal of the
+// entries whose indices repeat the preceding entry. As with a stable sort,
+// the entry that was in the buffer first survives.
+template <typename T, int32 N>
+static void RadixSortAndRemoveDuplicates(
+	b2GrowableBuffer<T>& buffer, int32 T::* const (&indices)[N],
+	int32 indexCount, bool (*match)(const T&, const T&),
+	b2StackAllocator* allocator)
 {
-	int32 diffA = a.indexA - b.indexA;
-	if (diffA != 0) return diffA < 0;
-	return a.indexB < b.indexB;
+	int32 count = buffer.GetCount();
+	if (count < 2)
+	{
+		return;
+	}
+	int32 digitCount = 0;
+	for (uint32 m = (uint32) (indexCount - 1); m; m >>= 8)
+	{
+		digitCount++;
+	}
+	const T* data = buffer.Data();
+	int32* orderBuffer =
+		(int32*) allocator->Allocate(sizeof(int32) * count);
+	int32* scratchBuffer =
+		(int32*) allocator->Allocate(sizeof(int32) * count);
+	int32* order = orderBuffer;
+	int32* scratch = scratchBuffer;
+	for (int32 i = 0; i < count; i++)
+	{
+		order[i] = i;
+	}
+	for (int32 k = N - 1; k >= 0; k--)
+	{
+		int32 T::* index = indices[k];
+		for (int32 d = 0; d < digitCount; d++)
+		{
+			uint32 shift = 8 * d;
+			int32 offsets[256];
+			for (int32 j = 0; j < 256; j++)
+			{
+				offsets[j] = 0;
+			}
+			for (int32 i = 0; i < count; i++)
+			{
+				b2Assert(0 <= data[i].*index && data[i].*index < indexCount);
+				offsets[((uint32) (data[i].*index) >> shift) & 0xff]++;
+			}
+			if (offsets[((uint32) (data[0].*index) >> shift) & 0xff] == count)
+			{
+				// Every entry has the same digit.
+				continue;
+			}
+			int32 sum = 0;
+			for (int32 j = 0; j < 256; j++)
+			{
+				int32 n = offsets[j];
+				offsets[j] = sum;
+				sum += n;
+			}
+			for (int32 i = 0; i < count; i++)
+			{
+				int32 e = order[i];
+				uint32 digit = ((uint32) (data[e].*index) >> shift) & 0xff;
+				scratch[offsets[digit]++] = e;
+			}
+			b2Swap(order, scratch);
+		}
+	}
+	T* sorted = (T*) allocator->Allocate(sizeof(T) * count);
+	int32 uniqueCount = 0;
+	for (int32 i = 0; i < count; i++)
+	{
+		const T& e = data[order[i]];
+		if (uniqueCount == 0 || !match(sorted[uniqueCount - 1], e))
+		{
+			sorted[uniqueCount++] = e;
+		}
+	}
+	memcpy(buffer.Data(), sorted, sizeof(T) * uniqueCount);
+	buffer.SetCount(uniqueCount);
+	allocator->Free(sorted);
+	allocator->Free(scratchBuffer);
+	allocator->Free(orderBuffer);
 }
 
-bool b2ParticleSystem::MatchPairIndices(
-							const b2ParticlePair& a, const b2ParticlePair& b)
+void b2ParticleSystem::SortAndRemoveDuplicatePairs()
 {
-	return a.indexA == b.indexA && a.indexB == b.indexB;
+	static int32 b2ParticlePair::* const indices[] = {
+		&b2ParticlePair::indexA,
+		&b2ParticlePair::indexB,
+	};
+	RadixSortAndRemoveDuplicates(m_pairBuffer, indices, m_count,
+								 MatchPairIndices, &m_world->m_stackAllocator);
 }
 
-bool b2ParticleSystem::CompareTriadIndices(
-							const b2ParticleTriad& a, const b2ParticleTriad& b)
+void b2ParticleSystem::SortAndRemoveDuplicateTriads()
 {
-	int32 diffA = a.indexA - b.indexA;
-	if (diffA != 0) return diffA < 0;
-	int32 diffB = a.indexB - b.indexB;
-	if (diffB != 0) return diffB < 0;
-	return a.indexC < b.indexC;
+	static int32 b2ParticleTriad::* const indices[] = {
+		&b2ParticleTriad::indexA,
+		&b2ParticleTriad::indexB,
+		&b2ParticleTriad::indexC,
+	};
+	RadixSortAndRemoveDuplicates(m_triadBuffer, indices, m_count,
+								 MatchTriadIndices, &m_world->m_stackAllocator);
+}
+
+bool b2ParticleSystem::MatchPairIndices(
+							const b2ParticlePair& a, const b2ParticlePair& b)
+{
+	return a.indexA == b.indexA && a.indexB == b.indexB;
 }
 
 bool b2ParticleSystem::MatchTriadIndices(
@@ -1686,72 +2102,170 @@ void b2ParticleSystem::ComputeWeight()
 
 void b2ParticleSystem::ComputeDepth()
 {
-	b2ParticleContact* contactGroups = (b2ParticleContact*) m_world->
-		m_stackAllocator.Allocate(sizeof(b2ParticleContact) * m_contactBuffer.GetCount());
+	// Give every group that needs an update a slot, and record the slot of
+	// each of its particles so contacts can be bucketed by group.
+	DepthGroup* depthGroups = (DepthGroup*) m_world->
+		m_stackAllocator.Allocate(sizeof(DepthGroup) * m_groupCount);
+	int32* groupSlots = (int32*) m_world->
+		m_stackAllocator.Allocate(sizeof(int32) * m_count);
+	int32 depthGroupCount = 0;
+	for (b2ParticleGroup* group = m_groupList; group; group = group->GetNext())
+	{
+		if (group->m_groupFlags & b2_particleGroupNeedsUpdateDepth)
+		{
+			DepthGroup& depthGroup = depthGroups[depthGroupCount];
+			depthGroup.group = group;
+			depthGroup.firstContact = 0;
+			depthGroup.lastContact = 0;
+			for (int32 i = group->m_firstIndex; i < group->m_lastIndex; i++)
+			{
+				groupSlots[i] = depthGroupCount;
+			}
+			depthGroupCount++;
+		}
+	}
+
+	// Count the contacts inside each group, then scatter them so that each
+	// group's contacts are contiguous.
+	for (int32 k = 0; k < m_contactBuffer.GetCount(); k++)
+	{
+		const b2ParticleContact& contact = m_contactBuffer[k];
+		int32 a = contact.GetIndexA();
+		const b2ParticleGroup* groupA = m_groupBuffer[a];
+		if (groupA && groupA == m_groupBuffer[contact.GetIndexB()] &&
+			(groupA->m_groupFlags & b2_particleGroupNeedsUpdateDepth))
+		{
+			depthGroups[groupSlots[a]].lastContact++;
+		}
+	}
 	int32 contactGroupsCount = 0;
+	for (int32 i = 0; i < depthGroupCount; i++)
+	{
+		DepthGroup& depthGroup = depthGroups[i];
+		int32 count = depthGroup.lastContact;
+		depthGroup.firstContact = contactGroupsCount;
+		depthGroup.lastContact = contactGroupsCount;
+		contactGroupsCount += count;
+	}
+	b2ParticleContact* contactGroups = (b2ParticleContact*) m_world->
+		m_stackAllocator.Allocate(sizeof(b2ParticleContact) * contactGroupsCount);
 	for (int32 k = 0; k < m_contactBuffer.GetCount(); k++)
 	{
 		const b2ParticleContact& contact = m_contactBuffer[k];
 		int32 a = contact.GetIndexA();
-		int32 b = contact.GetIndexB();
 		const b2ParticleGroup* groupA = m_groupBuffer[a];
-		const b2ParticleGroup* groupB = m_groupBuffer[b];
-		if (groupA && groupA == groupB &&
+		if (groupA && groupA == m_groupBuffer[contact.GetIndexB()] &&
 			(groupA->m_groupFlags & b2_particleGroupNeedsUpdateDepth))
 		{
-			contactGroups[contactGroupsCount++] = contact;
+			contactGroups[depthGroups[groupSlots[a]].lastContact++] = contact;
 		}
 	}
-	b2ParticleGroup** groupsToUpdate = (b2ParticleGroup**) m_world->
-		m_stackAllocator.Allocate(sizeof(b2ParticleGroup*) * m_groupCount);
-	int32 groupsToUpdateCount = 0;
-	for (b2ParticleGroup* group = m_groupList; group; group = group->GetNext())
+	for (int32 i = 0; i < depthGroupCount; i++)
 	{
-		if (group->m_groupFlags & b2_particleGroupNeedsUpdateDepth)
+		b2ParticleGroup* group = depthGroups[i].group;
+		SetGroupFlags(group,
+					  group->m_groupFlags &
+					  ~b2_particleGroupNeedsUpdateDepth);
+	}
+
+	// Groups never share contacts or particles, so each one converges on its
+	// own. A group with enough contacts to keep several threads busy is
+	// relaxed on all of them by ComputeLargeGroupDepth(). Smaller groups are
+	// spread across the pooled worker threads once there are enough of them,
+	// pulling groups from a shared counter; the calling thread takes part
+	// too.
+	b2Assert(m_depthBuffer);
+	int32 hardwareThreadCount = b2WorkerPool::GetHardwareThreadCount();
+	int32 smallGroupCount = 0;
+	int32 smallContactCount = 0;
+	for (int32 i = 0; i < depthGroupCount; i++)
+	{
+		const DepthGroup& depthGroup = depthGroups[i];
+		int32 contactCount = depthGroup.lastContact - depthGroup.firstContact;
+		if (contactCount >= b2_minParallelDepthContacts &&
+			hardwareThreadCount > 1)
 		{
-			groupsToUpdate[groupsToUpdateCount++] = group;
-			SetGroupFlags(group,
-						  group->m_groupFlags &
-						  ~b2_particleGroupNeedsUpdateDepth);
-			for (int32 i = group->m_firstIndex; i < group->m_lastIndex; i++)
+			ComputeLargeGroupDepth(depthGroup, contactGroups,
+								   hardwareThreadCount);
+		}
+		else
+		{
+			depthGroups[smallGroupCount++] = depthGroup;
+			smallContactCount += contactCount;
+		}
+	}
+	int32 threadCount = 1;
+	if (smallContactCount >= b2_minParallelDepthContacts)
+	{
+		threadCount = b2Min(hardwareThreadCount, smallGroupCount);
+	}
+	if (threadCount > 1)
+	{
+		std::atomic<int32> nextGroup(0);
+		GetWorkerPool()->Run(threadCount, [&]()
+		{
+			for (;;)
 			{
-				m_accumulationBuffer[i] = 0;
+				int32 i = nextGroup.fetch_add(1);
+				if (i >= smallGroupCount)
+				{
+					break;
+				}
+				ComputeGroupDepth(depthGroups[i], contactGroups);
 			}
+		});
+	}
+	else
+	{
+		for (int32 i = 0; i < smallGroupCount; i++)
+		{
+			ComputeGroupDepth(depthGroups[i], contactGroups);
 		}
 	}
+	m_world->m_stackAllocator.Free(contactGroups);
+	m_world->m_stackAllocator.Free(groupSlots);
+	m_world->m_stackAllocator.Free(depthGroups);
+}
+
+void b2ParticleSystem::ComputeGroupDepth(const DepthGroup& depthGroup,
+										 const b2ParticleContact* contacts)
+{
+	const b2ParticleGroup* group = depthGroup.group;
+	const b2ParticleContact* firstContact = contacts + depthGroup.firstContact;
+	const b2ParticleContact* lastContact = contacts + depthGroup.lastContact;
+	for (int32 i = group->m_firstIndex; i < group->m_lastIndex; i++)
+	{
+		m_accumulationBuffer[i] = 0;
+	}
 	// Compute sum of weight of contacts except between different groups.
-	for (int32 k = 0; k < contactGroupsCount; k++)
+	for (const b2ParticleContact* contact = firstContact;
+		 contact < lastContact; ++contact)
 	{
-		const b2ParticleContact& contact = contactGroups[k];
-		int32 a = contact.GetIndexA();
-		int32 b = contact.GetIndexB();
-		float32 w = contact.GetWeight();
+		int32 a = contact->GetIndexA();
+		int32 b = contact->GetIndexB();
+		float32 w = contact->GetWeight();
 		m_accumulationBuffer[a] += w;
 		m_accumulationBuffer[b] += w;
 	}
-	b2Assert(m_depthBuffer);
-	for (int32 i = 0; i < groupsToUpdateCount; i++)
+	for (int32 i = group->m_firstIndex; i < group->m_lastIndex; i++)
 	{
-		const b2ParticleGroup* group = groupsToUpdate[i];
-		for (int32 i = group->m_firstIndex; i < group->m_lastIndex; i++)
-		{
-			float32 w = m_accumulationBuffer[i];
-			m_depthBuffer[i] = w < 0.8f ? 0 : b2_maxFloat;
-		}
+		float32 w = m_accumulationBuffer[i];
+		m_depthBuffer[i] = w < 0.8f ? 0 : b2_maxFloat;
 	}
 	// The number of iterations is equal to particle number from the deepest
 	// particle to the nearest surface particle, and in general it is smaller
-	// than sqrt of total particle number.
-	int32 iterationCount = (int32)b2Sqrt((float)m_count);
+	// than sqrt of the group's particle number. Each group stops as soon as
+	// a pass leaves its depths unchanged.
+	int32 iterationCount = (int32)b2Sqrt((float)group->GetParticleCount()) + 1;
 	for (int32 t = 0; t < iterationCount; t++)
 	{
 		bool updated = false;
-		for (int32 k = 0; k < contactGroupsCount; k++)
+		for (const b2ParticleContact* contact = firstContact;
+			 contact < lastContact; ++contact)
 		{
-			const b2ParticleContact& contact = contactGroups[k];
-			int32 a = contact.GetIndexA();
-			int32 b = contact.GetIndexB();
-			float32 r = 1 - contact.GetWeight();
+			int32 a = contact->GetIndexA();
+			int32 b = contact->GetIndexB();
+			float32 r = 1 - contact->GetWeight();
 			float32& ap0 = m_depthBuffer[a];
 			float32& bp0 = m_depthBuffer[b];
 			float32 ap1 = bp0 + r;
@@ -1772,24 +2286,163 @@ void b2ParticleSystem::ComputeDepth()
 			break;
 		}
 	}
-	for (int32 i = 0; i < groupsToUpdateCount; i++)
+	for (int32 i = group->m_firstIndex; i < group->m_lastIndex; i++)
 	{
-		const b2ParticleGroup* group = groupsToUpdate[i];
-		for (int32 i = group->m_firstIndex; i < group->m_lastIndex; i++)
+		float32& p = m_depthBuffer[i];
+		if (p < b2_maxFloat)
+		{
+			p *= m_particleDiameter;
+		}
+		else
 		{
-			float32& p = m_depthBuffer[i];
-			if (p < b2_maxFloat)
+			p = 0;
+		}
+	}
+}
+
+void b2ParticleSystem::ComputeLargeGroupDepth(
+	const DepthGroup& depthGroup, const b2ParticleContact* contacts,
+	int32 threadCount)
+{
+	// Relax with Jacobi sweeps: each sweep computes the depth of every
+	// particle from those of its neighbors after the previous sweep, so the
+	// particles can be split across threads and the result does not depend
+	// on their number. Both this and ComputeGroupDepth() find the shortest
+	// paths to the surface with the same additions, so once converged the
+	// depths are the same. Jacobi sweeps take about twice as many passes to
+	// converge, which still leaves them well within the iteration limit.
+	const b2ParticleGroup* group = depthGroup.group;
+	int32 firstIndex = group->m_firstIndex;
+	int32 particleCount = group->m_lastIndex - firstIndex;
+	const b2ParticleContact* firstContact = contacts + depthGroup.firstContact;
+	const b2ParticleContact* lastContact = contacts + depthGroup.lastContact;
+
+	// List the neighbors of each particle in contact order, so that its
+	// weights are summed in the same order as in ComputeGroupDepth().
+	int32* neighborStarts = (int32*) m_world->m_stackAllocator.Allocate(
+		sizeof(int32) * (particleCount + 1));
+	DepthNeighbor* neighbors = (DepthNeighbor*) m_world->m_stackAllocator.
+		Allocate(sizeof(DepthNeighbor) * 2 * (lastContact - firstContact));
+	memset(neighborStarts, 0, sizeof(int32) * (particleCount + 1));
+	for (const b2ParticleContact* contact = firstContact;
+		 contact < lastContact; ++contact)
+	{
+		neighborStarts[contact->GetIndexA() - firstIndex + 1]++;
+		neighborStarts[contact->GetIndexB() - firstIndex + 1]++;
+	}
+	for (int32 i = 0; i < particleCount; i++)
+	{
+		neighborStarts[i + 1] += neighborStarts[i];
+	}
+	// Fill the lists, which advances each start to the next particle's.
+	for (const b2ParticleContact* contact = firstContact;
+		 contact < lastContact; ++contact)
+	{
+		int32 a = contact->GetIndexA();
+		int32 b = contact->GetIndexB();
+		float32 w = contact->GetWeight();
+		DepthNeighbor& neighborA = neighbors[neighborStarts[a - firstIndex]++];
+		neighborA.index = b - firstIndex;
+		neighborA.weight = w;
+		DepthNeighbor& neighborB = neighbors[neighborStarts[b - firstIndex]++];
+		neighborB.index = a - firstIndex;
+		neighborB.weight = w;
+	}
+	for (int32 i = particleCount; i > 0; i--)
+	{
+		neighborStarts[i] = neighborStarts[i - 1];
+	}
+	neighborStarts[0] = 0;
+
+	// Sweeps alternate between the group's depths and its accumulation
+	// buffer. Each thread owns a range of particles; after every sweep the
+	// threads wait for each other and stop together once no depth changed.
+	// A sweep raises the flag of its parity modulo 3 and clears the next
+	// one, which every thread finished reading before the previous barrier.
+	float32* depths[2] = {
+		m_depthBuffer + firstIndex, m_accumulationBuffer + firstIndex};
+	int32 iterationCount = (int32)b2Sqrt((float)particleCount) + 1;
+	b2WorkerBarrier barrier(threadCount);
+	std::atomic<int32> nextThread(0);
+	std::atomic<bool> updated[3];
+	for (int32 k = 0; k < 3; k++)
+	{
+		updated[k].store(false, std::memory_order_relaxed);
+	}
+	auto work = [&]()
+	{
+		int32 thread = nextThread.fetch_add(1);
+		int32 first = (int32) ((int64) particleCount * thread / threadCount);
+		int32 last =
+			(int32) ((int64) particleCount * (thread + 1) / threadCount);
+		for (int32 i = first; i < last; i++)
+		{
+			float32 w = 0;
+			for (int32 k = neighborStarts[i]; k < neighborStarts[i + 1]; k++)
 			{
-				p *= m_particleDiameter;
+				w += neighbors[k].weight;
 			}
-			else
+			depths[0][i] = w < 0.8f ? 0 : b2_maxFloat;
+		}
+		barrier.Wait();
+		int32 t = 0;
+		while (t < iterationCount)
+		{
+			const float32* src = depths[t & 1];
+			float32* dst = depths[~t & 1];
+			if (thread == 0)
 			{
-				p = 0;
+				updated[(t + 1) % 3].store(false, std::memory_order_relaxed);
 			}
+			bool changed = false;
+			for (int32 i = first; i < last; i++)
+			{
+				float32 p = src[i];
+				for (int32 k = neighborStarts[i]; k < neighborStarts[i + 1];
+					 k++)
+				{
+					const DepthNeighbor& neighbor = neighbors[k];
+					float32 r = 1 - neighbor.weight;
+					float32 p1 = src[neighbor.index] + r;
+					if (p > p1)
+					{
+						p = p1;
+						changed = true;
+					}
+				}
+				dst[i] = p;
+			}
+			if (changed)
+			{
+				updated[t % 3].store(true, std::memory_order_relaxed);
+			}
+			barrier.Wait();
+			bool converged = !updated[t % 3].load(std::memory_order_relaxed);
+			t++;
+			if (converged)
+			{
+				break;
+			}
+		}
+		const float32* result = depths[t & 1];
+		for (int32 i = first; i < last; i++)
+		{
+			float32 p = result[i];
+			depths[0][i] = p < b2_maxFloat ? p * m_particleDiameter : 0;
 		}
+	};
+	GetWorkerPool()->Run(threadCount, work);
+	m_world->m_stackAllocator.Free(neighbors);
+	m_world->m_stackAllocator.Free(neighborStarts);
+}
+
+b2WorkerPool* b2ParticleSystem::GetWorkerPool()
+{
+	if (!m_workerPool)
+	{
+		m_workerPool = new (b2Alloc(sizeof(b2WorkerPool))) b2WorkerPool;
 	}
-	m_world->m_stackAllocator.Free(groupsToUpdate);
-	m_world->m_stackAllocator.Free(contactGroups);
+	return m_workerPool;
 }
 
 b2ParticleSystem::InsideBoundsEnumerator
@@ -2798,21 +3451,21 @@ void b2ParticleSystem::SolveCollision(const b2TimeStep& step)
 				if (m_system->m_iterationIndex == 0)
 				{
 					// Put 'ap' in the local space of the previous frame
-					b2Vec2 p1 = b2MulT(body->m_xf0, ap);
+					b2Vec2 p1 = b2MulT(body->Xf0(), ap);
 					if (fixture->GetShape()->GetType() == b2Shape::e_circle)
 					{
 						// Make relative to the center of the circle
 						p1 -= body->GetLocalCenter();
 						// Re-apply rotation about the center of the
 						// circle
-						p1 = b2Mul(body->m_xf0.q, p1);
+						p1 = b2Mul(body->Xf0().q, p1);
 						// Subtract rotation of the current frame
-						p1 = b2MulT(body->m_xf.q, p1);
+						p1 = b2MulT(body->Xf().q, p1);
 						// Return to local space
 						p1 += body->GetLocalCenter();
 					}
 					// Return to global space and apply rotation of current frame
-					input.p1 = b2Mul(body->m_xf, p1);
+					input.p1 = b2Mul(body->Xf(), p1);
 				}
 				else
 				{
@@ -4492,6 +5145,26 @@ void b2ParticleSystem::ParticleApplyForce(int32 index, const b2Vec2& force)
 	}
 }
 
+void b2ParticleSystem::ApplyForces(int32 firstIndex, int32 lastIndex,
+								   const b2Vec2* forces)
+{
+	b2Assert(0 <= firstIndex && firstIndex <= lastIndex &&
+			 lastIndex <= m_count);
+	if (firstIndex == lastIndex)
+	{
+		return;
+	}
+	PrepareForceBuffer();
+	const uint32* flags = m_flagsBuffer.data;
+	for (int32 i = firstIndex; i < lastIndex; i++)
+	{
+		if (ForceCanBeApplied(flags[i]))
+		{
+			m_forceBuffer[i] += forces[i - firstIndex];
+		}
+	}
+}
+
 void b2ParticleSystem::ApplyLinearImpulse(int32 firstIndex, int32 lastIndex,
 										  const b2Vec2& impulse)
 {
@@ -4504,6 +5177,23 @@ void b2ParticleSystem::ApplyLinearImpulse(int32 firstIndex, int32 lastIndex,
 	}
 }
 
+void b2ParticleSystem::ApplyLinearImpulses(const int32* indices, int32 count,
+										   const b2Vec2* impulses)
+{
+	const float32 inverseMass = GetParticleInvMass();
+	const uint32* flags = m_flagsBuffer.data;
+	b2Vec2* velocities = m_velocityBuffer.data;
+	for (int32 i = 0; i < count; i++)
+	{
+		const int32 index = indices[i];
+		b2Assert(0 <= index && index < m_count);
+		if (ForceCanBeApplied(flags[index]))
+		{
+			velocities[index] += inverseMass * impulses[i];
+		}
+	}
+}
+
 void b2ParticleSystem::QueryAABB(b2QueryCallback* callback,
 								 const b2AABB& aabb) const
 {
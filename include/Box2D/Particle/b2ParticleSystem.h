@@ -43,6 +43,7 @@ class b2Fixture;
 class b2ContactFilter;
 class b2ContactListener;
 class b2ParticlePairSet;
+class b2WorkerPool;
 class FixtureParticleSet;
 struct b2ParticleGroupDef;
 struct b2Vec2;
@@ -414,6 +415,9 @@ public:
 	/// Get the particle density.
 	float32 GetDensity() const;
 
+	/// Get the mass of a single particle, set by its radius and density.
+	float32 GetParticleMass() const;
+
 	/// Change the particle gravity scale. Adjusts the effect of the global
 	/// gravity vector on particles.
 	void SetGravityScale(float32 gravityScale);
@@ -587,6 +591,20 @@ public:
 	/// Get the status of the strict contact check.
 	bool GetStrictContactCheck() const;
 
+	/// Set strict triad check.
+	/// When enabled, every update of the triads also triangulates the whole
+	/// region it covers at once and compares the triads found, counting the
+	/// updates that differ. Incremental updates, such as reactive particles
+	/// or the seam of joined groups, must find the same triads as a full
+	/// re-triangulation, so the count should stay zero. This doubles the
+	/// cost of those updates and is meant for testing.
+	void SetStrictTriadCheck(bool enabled);
+	/// Get the status of the strict triad check.
+	bool GetStrictTriadCheck() const;
+	/// Get the number of triad updates that differed from a full
+	/// re-triangulation while the strict triad check was enabled.
+	int32 GetTriadCheckFailureCount() const;
+
 	/// Set the lifetime (in seconds) of a particle relative to the current
 	/// time.  A lifetime of less than or equal to 0.0f results in the particle
 	/// living forever until it's manually destroyed by the application.
@@ -647,6 +665,16 @@ public:
 	void ApplyLinearImpulse(int32 firstIndex, int32 lastIndex,
 							const b2Vec2& impulse);
 
+	/// Apply a separate impulse to each of a list of particles, such as the
+	/// ones found by QueryAABB. This immediately modifies their velocities.
+	/// Unlike ApplyLinearImpulse, each impulse acts on a single particle's
+	/// mass. Wall particles are skipped.
+	/// @param indices the particles that will be modified.
+	/// @param count the number of indices.
+	/// @param impulses count world impulse vectors, one per index.
+	void ApplyLinearImpulses(const int32* indices, int32 count,
+							 const b2Vec2* impulses);
+
 	/// Apply a force to the center of a particle.
 	/// @param index the particle that will be modified.
 	/// @param force the world force vector, usually in Newtons (N).
@@ -661,6 +689,16 @@ public:
 	/// @param force the world force vector, usually in Newtons (N).
 	void ApplyForce(int32 firstIndex, int32 lastIndex, const b2Vec2& force);
 
+	/// Apply a separate force to each particle between 'firstIndex' and
+	/// 'lastIndex'. Equivalent to calling
+	/// ParticleApplyForce(i, forces[i - firstIndex]) for each of them, but
+	/// the force buffer is prepared once for the whole range. Wall particles
+	/// are skipped.
+	/// @param firstIndex the first particle to be modified.
+	/// @param lastIndex one past the last particle to be modified.
+	/// @param forces lastIndex - firstIndex world force vectors.
+	void ApplyForces(int32 firstIndex, int32 lastIndex, const b2Vec2* forces);
+
 	/// Get the next particle-system in the world's particle-system list.
 	b2ParticleSystem* GetNext();
 	const b2ParticleSystem* GetNext() const;
@@ -743,6 +781,7 @@ private:
 	friend class b2ParticleGroup;
 	friend class b2ParticleBodyContactRemovePredicate;
 	friend class b2FixtureParticleQueryCallback;
+	friend class b2WorldSnapshot;
 #ifdef LIQUIDFUN_UNIT_TESTS
 	FRIEND_TEST(FunctionTests, GetParticleMass);
 	FRIEND_TEST(FunctionTests, AreProxyBuffersTheSame);
@@ -791,6 +830,15 @@ private:
 			B2_NOT_USED(index);
 			return true;
 		}
+		/// Is the particle part of the region being triangulated?
+		/// Triads are found on a diagram aligned with the extent of the
+		/// region, so the necessary particles may be narrowed down within
+		/// it without changing the triads created. Every necessary particle
+		/// must be part of the region.
+		virtual bool IsInRegion(int32 index) const
+		{
+			return IsNecessary(index);
+		}
 		/// An additional condition for creating a pair.
 		virtual bool ShouldCreatePair(int32 a, int32 b) const
 		{
@@ -844,6 +892,42 @@ private:
 		int32 index;
 	};
 
+	/// Used for splitting the Voronoi diagram of UpdateTriads() into tiles
+	struct VoronoiTileProxy
+	{
+		uint64 tile;
+		int32 index;
+		bool necessary;
+		friend inline bool operator<(const VoronoiTileProxy &a,
+									 const VoronoiTileProxy &b)
+		{
+			return a.tile < b.tile || (a.tile == b.tile && a.index < b.index);
+		}
+		friend inline bool operator<(uint64 a, const VoronoiTileProxy &b)
+		{
+			return a < b.tile;
+		}
+		friend inline bool operator<(const VoronoiTileProxy &a, uint64 b)
+		{
+			return a.tile < b;
+		}
+	};
+
+	/// A group whose depth is being recomputed, and the range of its
+	/// intra-group contacts in the contact array bucketed by group.
+	struct DepthGroup
+	{
+		b2ParticleGroup* group;
+		int32 firstContact, lastContact;
+	};
+
+	/// A particle in contact with another, for ComputeLargeGroupDepth().
+	struct DepthNeighbor
+	{
+		int32 index;
+		float32 weight;
+	};
+
 	/// All particle types that require creating pairs
 	static const int32 k_pairFlags =
 		b2_springParticle |
@@ -901,9 +985,11 @@ private:
 	void UpdatePairsAndTriads(
 		int32 firstIndex, int32 lastIndex, const ConnectionFilter& filter);
 	void UpdatePairsAndTriadsWithReactiveParticles();
-	static bool ComparePairIndices(const b2ParticlePair& a, const b2ParticlePair& b);
+	void UpdateTriads(
+		int32 firstIndex, int32 lastIndex, const ConnectionFilter& filter);
+	void SortAndRemoveDuplicatePairs();
+	void SortAndRemoveDuplicateTriads();
 	static bool MatchPairIndices(const b2ParticlePair& a, const b2ParticlePair& b);
-	static bool CompareTriadIndices(const b2ParticleTriad& a, const b2ParticleTriad& b);
 	static bool MatchTriadIndices(const b2ParticleTriad& a, const b2ParticleTriad& b);
 
 	static void InitializeParticleLists(
@@ -926,6 +1012,13 @@ private:
 		const b2ParticleGroup* group, const ParticleListNode* nodeBuffer);
 
 	void ComputeDepth();
+	void ComputeGroupDepth(const DepthGroup& depthGroup,
+						   const b2ParticleContact* contacts);
+	void ComputeLargeGroupDepth(const DepthGroup& depthGroup,
+								const b2ParticleContact* contacts,
+								int32 threadCount);
+
+	b2WorkerPool* GetWorkerPool();
 
 	InsideBoundsEnumerator GetInsideBoundsEnumerator(const b2AABB& aabb) const;
 
@@ -1003,7 +1096,6 @@ private:
 	float32 GetCriticalVelocitySquared(const b2TimeStep& step) const;
 	float32 GetCriticalPressure(const b2TimeStep& step) const;
 	float32 GetParticleStride() const;
-	float32 GetParticleMass() const;
 	float32 GetParticleInvMass() const;
 
 	// Get the world's contact filter if any particles with the
@@ -1109,6 +1201,9 @@ private:
 	/// used in SolveSolid(). It will be reallocated on subsequent
 	/// CreateParticle() calls.
 	float32* m_depthBuffer;
+	/// Threads that ComputeDepth() spreads large updates across. Created on
+	/// first use and kept for the lifetime of the system.
+	b2WorkerPool* m_workerPool;
 	UserOverridableBuffer<b2ParticleColor> m_colorBuffer;
 	b2ParticleGroup** m_groupBuffer;
 	UserOverridableBuffer<void*> m_userDataBuffer;
@@ -1119,6 +1214,10 @@ private:
 	UserOverridableBuffer<int32> m_bodyContactCountBuffer;
 	UserOverridableBuffer<int32> m_consecutiveContactStepsBuffer;
 	b2GrowableBuffer<int32> m_stuckParticleBuffer;
+
+	/// Strict triad check state
+	bool m_strictTriadCheck;
+	int32 m_triadCheckFailureCount;
 	b2GrowableBuffer<Proxy> m_proxyBuffer;
 	b2GrowableBuffer<b2ParticleContact> m_contactBuffer;
 	b2GrowableBuffer<b2ParticleBodyContact> m_bodyContactBuffer;
@@ -1280,6 +1379,21 @@ inline bool b2ParticleSystem::GetStrictContactCheck() const
 	return m_def.strictContactCheck;
 }
 
+inline void b2ParticleSystem::SetStrictTriadCheck(bool enabled)
+{
+	m_strictTriadCheck = enabled;
+}
+
+inline bool b2ParticleSystem::GetStrictTriadCheck() const
+{
+	return m_strictTriadCheck;
+}
+
+inline int32 b2ParticleSystem::GetTriadCheckFailureCount() const
+{
+	return m_triadCheckFailureCount;
+}
+
 inline void b2ParticleSystem::SetRadius(float32 radius)
 {
 	m_particleDiameter = 2 * radius;
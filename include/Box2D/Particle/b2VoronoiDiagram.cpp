@@ -30,6 +30,9 @@ b2VoronoiDiagram::b2VoronoiDiagram(
 	m_generatorCount = 0;
 	m_countX = 0;
 	m_countY = 0;
+	m_offsetX = 0;
+	m_offsetY = 0;
+	m_reach = 0;
 	m_diagram = NULL;
 }
 
@@ -73,6 +76,56 @@ void b2VoronoiDiagram::Generate(float32 radius, float32 margin)
 	upper.y += margin;
 	m_countX = 1 + (int32) (inverseRadius * (upper.x - lower.x));
 	m_countY = 1 + (int32) (inverseRadius * (upper.y - lower.y));
+	m_reach = inverseRadius * margin;
+	Rasterize(inverseRadius, lower, 0, 0);
+}
+
+void b2VoronoiDiagram::Generate(float32 radius, float32 margin,
+								const b2Vec2& lower, const b2Vec2& upper)
+{
+	b2Assert(m_diagram == NULL);
+	float32 inverseRadius = 1 / radius;
+	b2Vec2 origin = lower;
+	b2Vec2 end = upper;
+	origin.x -= margin;
+	origin.y -= margin;
+	end.x += margin;
+	end.y += margin;
+	int32 countX = 1 + (int32) (inverseRadius * (end.x - origin.x));
+	int32 countY = 1 + (int32) (inverseRadius * (end.y - origin.y));
+	b2Vec2 localLower(+b2_maxFloat, +b2_maxFloat);
+	b2Vec2 localUpper(-b2_maxFloat, -b2_maxFloat);
+	for (int32 k = 0; k < m_generatorCount; k++)
+	{
+		Generator& g = m_generatorBuffer[k];
+		if (g.necessary)
+		{
+			localLower = b2Min(localLower, g.center);
+			localUpper = b2Max(localUpper, g.center);
+		}
+	}
+	// Reported nodes are within margin of a necessary generator, and the
+	// cells around them within another margin of the window's edge.
+	float32 extent = 2 * margin + radius;
+	int32 offsetX = b2Max(0, (int32) (inverseRadius *
+		(localLower.x - extent - origin.x)));
+	int32 offsetY = b2Max(0, (int32) (inverseRadius *
+		(localLower.y - extent - origin.y)));
+	int32 lastX = b2Min(countX - 1, (int32) (inverseRadius *
+		(localUpper.x + extent - origin.x)));
+	int32 lastY = b2Min(countY - 1, (int32) (inverseRadius *
+		(localUpper.y + extent - origin.y)));
+	m_countX = b2Max(0, lastX - offsetX + 1);
+	m_countY = b2Max(0, lastY - offsetY + 1);
+	m_reach = inverseRadius * margin;
+	Rasterize(inverseRadius, origin, offsetX, offsetY);
+}
+
+void b2VoronoiDiagram::Rasterize(float32 inverseRadius, const b2Vec2& origin,
+								 int32 offsetX, int32 offsetY)
+{
+	m_offsetX = offsetX;
+	m_offsetY = offsetY;
 	m_diagram = (Generator**)
 		m_allocator->Allocate(sizeof(Generator*) * m_countX * m_countY);
 	for (int32 i = 0; i < m_countX * m_countY; i++)
@@ -86,9 +139,9 @@ void b2VoronoiDiagram::Generate(float32 radius, float32 margin)
 	for (int32 k = 0; k < m_generatorCount; k++)
 	{
 		Generator& g = m_generatorBuffer[k];
-		g.center = inverseRadius * (g.center - lower);
-		int32 x = (int32) g.center.x;
-		int32 y = (int32) g.center.y;
+		g.center = inverseRadius * (g.center - origin);
+		int32 x = (int32) g.center.x - offsetX;
+		int32 y = (int32) g.center.y - offsetY;
 		if (x >=0 && y >= 0 && x < m_countX && y < m_countY)
 		{
 			queue.Push(b2VoronoiDiagramTask(x, y, x + y * m_countX, &g));
@@ -162,10 +215,13 @@ void b2VoronoiDiagram::Generate(float32 radius, float32 margin)
 		Generator* b = k;
 		if (a != b)
 		{
-			float32 ax = a->center.x - x;
-			float32 ay = a->center.y - y;
-			float32 bx = b->center.x - x;
-			float32 by = b->center.y - y;
+			// Measure in the coordinates of the whole raster.
+			int32 rx = x + offsetX;
+			int32 ry = y + offsetY;
+			float32 ax = a->center.x - rx;
+			float32 ay = a->center.y - ry;
+			float32 bx = b->center.x - rx;
+			float32 by = b->center.y - ry;
 			float32 a2 = ax * ax + ay * ay;
 			float32 b2 = bx * bx + by * by;
 			if (a2 > b2)
@@ -192,6 +248,13 @@ void b2VoronoiDiagram::Generate(float32 radius, float32 margin)
 	}
 }
 
+bool b2VoronoiDiagram::Reaches(const Generator* g, int32 x, int32 y) const
+{
+	return g->necessary &&
+		   b2Abs(g->center.x - (float32) (x + m_offsetX + 1)) <= m_reach &&
+		   b2Abs(g->center.y - (float32) (y + m_offsetY + 1)) <= m_reach;
+}
+
 void b2VoronoiDiagram::GetNodes(NodeCallback& callback) const
 {
 	for (int32 y = 0; y < m_countY - 1; y++)
@@ -206,12 +269,14 @@ void b2VoronoiDiagram::GetNodes(NodeCallback& callback) const
 			if (b != c)
 			{
 				if (a != b && a != c &&
-					(a->necessary || b->necessary || c->necessary))
+					(Reaches(a, x, y) || Reaches(b, x, y) ||
+					 Reaches(c, x, y)))
 				{
 					callback(a->tag, b->tag, c->tag);
 				}
 				if (d != b && d != c &&
-					(b->necessary || d->necessary || c->necessary))
+					(Reaches(b, x, y) || Reaches(d, x, y) ||
+					 Reaches(c, x, y)))
 				{
 					callback(b->tag, d->tag, c->tag);
 				}
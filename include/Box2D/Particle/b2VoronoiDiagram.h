@@ -44,6 +44,20 @@ public:
 	/// @param margin for which the range of the diagram is extended.
 	void Generate(float32 radius, float32 margin);
 
+	/// Generate the part of the diagram of [lower, upper] that holds the
+	/// nodes within margin of this diagram's necessary generators. The
+	/// raster is a window of the one Generate(radius, margin) builds when
+	/// the necessary generators span [lower, upper], padded by another
+	/// margin so that the generators missing beyond its edges do not change
+	/// those nodes. Diagrams of different generator subsets with the same
+	/// bounds thus report the same nodes for the same necessary generators.
+	/// @param the interval of the diagram.
+	/// @param margin for which the range of the diagram is extended.
+	/// @param the lower bound of the larger diagram's generators.
+	/// @param the upper bound of the larger diagram's generators.
+	void Generate(float32 radius, float32 margin,
+				  const b2Vec2& lower, const b2Vec2& upper);
+
 	/// Callback used by GetNodes().
 	class NodeCallback
 	{
@@ -53,7 +67,8 @@ public:
 		virtual void operator()(int32 a, int32 b, int32 c) = 0;
 	};
 
-	/// Enumerate all nodes that contain at least one necessary generator.
+	/// Enumerate all nodes with a necessary generator no farther than the
+	/// margin from the node.
 	/// @param a callback function object called for each node.
 	void GetNodes(NodeCallback& callback) const;
 
@@ -81,11 +96,22 @@ private:
 		}
 	};
 
+	// Rasterize the generators into m_countX * m_countY cells starting at
+	// cell (offsetX, offsetY) of the raster whose cell (0, 0) is at origin.
+	void Rasterize(float32 inverseRadius, const b2Vec2& origin,
+				   int32 offsetX, int32 offsetY);
+
+	// Whether g is necessary and within m_reach cells of the node at the
+	// corner shared by cells (x, y) and (x + 1, y + 1).
+	bool Reaches(const Generator* g, int32 x, int32 y) const;
+
 	b2StackAllocator *m_allocator;
 	Generator* m_generatorBuffer;
 	int32 m_generatorCapacity;
 	int32 m_generatorCount;
 	int32 m_countX, m_countY;
+	int32 m_offsetX, m_offsetY;
+	float32 m_reach;
 	Generator** m_diagram;
 
 };
@@ -3,12 +3,13 @@
 in vec2 v_TexCoord;
 out vec4 FragColor;
 uniform vec3 u_Color;
-uniform sampler2D u_Texture;
+uniform sampler2DArray u_Texture;
+uniform int u_TextureLayer;
 uniform bool u_UseTexture;
 
 void main() {
     if(u_UseTexture) {
-        FragColor = texture(u_Texture, v_TexCoord);
+        FragColor = texture(u_Texture, vec3(v_TexCoord, u_TextureLayer));
     } else {
         FragColor = vec4(u_Color, 1.0);
     }
@@ -2,40 +2,67 @@
 
 in vec3 FragPos;
 in vec3 Normal;
+flat in uint MaterialIndex;
 
 out vec4 FragColor;
 
 uniform vec3 cameraPos;
 
+// Laid out so std140 packs shininess next to ambient
 struct Material {
     vec3 ambient;
+    float shininess;
     vec3 diffuse;
     vec3 specular;
-    float shininess;
 };
 
-uniform Material material;
+// Kept in sync with RenderQueue::maxMaterials
+const int MAX_MATERIALS = 256;
+layout(std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
 
-const int MAX_LIGHTS = 8;
-uniform int numLights;
+// Kept in sync with LightClusters
+const int MAX_LIGHTS = 256;
+const ivec3 CLUSTER_COUNT = ivec3(16, 9, 24);
 
 struct Light {
-    int type;          // 0 = Directional, 1 = Point, 2 = Spotlight
     vec3 position;     // For point lights and spotlights
-    vec3 direction;    // For directional lights and spotlights
-    vec3 color;        // Light color
     float angle;       // For spotlights (cutoff angle in degrees)
+    vec3 direction;    // For directional lights and spotlights
     float penumbra;    // For spotlights (penumbra angle in degrees)
+    vec3 color;        // Light color
+    int type;          // 0 = Directional, 1 = Point, 2 = Spotlight
     vec3 attenuation;  // (k_c, k_l, k_q) for attenuation
+    float range;       // Where a local light ends, 0 for lights that reach everywhere
+};
+
+// Lights that reach every fragment first, then the local ones
+layout(std140) uniform Lights {
+    Light lights[MAX_LIGHTS];
 };
+uniform int numGlobalLights;
 
-uniform Light lights[MAX_LIGHTS];
+// Per cluster the first and count of its lights in lightIndices
+uniform usamplerBuffer clusterLights;
+uniform usamplerBuffer lightIndices;
+uniform vec4 clusterViewport;  // x, y, width, height in pixels
+uniform vec2 clusterDepth;     // slice = log(depth) * x + y
+uniform mat4 view;
 
 float calculateAttenuation(Light light, float distance) {
     float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * distance * distance);
     return attenuation;
 }
 
+// Fades the whole light out before the edge of the clusters it was binned into
+float calculateRangeWindow(Light light, float distance) {
+    if (light.range > 0.0) {
+        return 1.0 - smoothstep(0.75 * light.range, light.range, distance);
+    }
+    return 1.0;
+}
+
 float calculateSpotlightEffect(Light light, vec3 L, vec3 lightDir) {
     float cosTheta = dot(-L, lightDir);
     float cosInner = cos(radians(light.angle - light.penumbra));
@@ -44,66 +71,83 @@ float calculateSpotlightEffect(Light light, vec3 L, vec3 lightDir) {
     return intensity;
 }
 
+vec3 shade(Light light, Material material, vec3 N, vec3 V) {
+    vec3 L;
+    float attenuation = 1.0;
+    float spotlightEffect = 1.0;
+    float rangeWindow = 1.0;
+
+    if (light.type == 0) {
+        // Directional Light
+        L = normalize(-light.direction);
+    } else if (light.type == 1) {
+        // Point Light
+        vec3 lightPos = light.position;
+        L = normalize(lightPos - FragPos);
+        float distance = length(lightPos - FragPos);
+        attenuation = calculateAttenuation(light, distance);
+        rangeWindow = calculateRangeWindow(light, distance);
+    } else if (light.type == 2) {
+        // Spotlight
+        vec3 lightPos = light.position;
+        vec3 lightDir = normalize(light.direction);
+        L = normalize(lightPos - FragPos);
+        float distance = length(lightPos - FragPos);
+        attenuation = calculateAttenuation(light, distance);
+        rangeWindow = calculateRangeWindow(light, distance);
+        spotlightEffect = calculateSpotlightEffect(light, L, lightDir);
+    }
+
+    // Diffuse term
+    float diff = max(dot(N, L), 0.0);
+    vec3 diffuse = material.diffuse * diff * light.color;
+
+    // Specular term (using Phong model)
+    vec3 R = reflect(-L, N);
+    float spec = 0.0;
+    if (diff > 0.0) {
+        float specAngle = max(dot(R, V), 0.0);
+        if (specAngle > 0.0) {
+            spec = pow(specAngle, material.shininess);
+        }
+    }
+    vec3 specular = material.specular * spec * light.color;
+
+    // Apply attenuation and spotlight effect
+    diffuse *= attenuation * spotlightEffect * rangeWindow;
+
+    // Option 1: Modify attenuation impact on specular
+    float specularAttenuation = sqrt(attenuation * spotlightEffect);
+    specular *= specularAttenuation * rangeWindow;
+
+    // Option 2: Do not attenuate specular (uncomment if preferred)
+    // specular *= 1.0;
+
+    return diffuse + specular;
+}
+
 void main() {
     vec3 N = normalize(Normal);
     vec3 V = normalize(cameraPos - FragPos);
     vec3 totalColor = vec3(0.0);
+    Material material = materials[MaterialIndex];
 
     vec3 ambient = material.ambient * 0.1; // Adjust as needed
 
-    for (int i = 0; i < numLights; ++i) {
-        Light light = lights[i];
-        vec3 L;
-        float attenuation = 1.0;
-        float spotlightEffect = 1.0;
-
-        if (light.type == 0) {
-            // Directional Light
-            L = normalize(-light.direction);
-        } else if (light.type == 1) {
-            // Point Light
-            vec3 lightPos = light.position;
-            L = normalize(lightPos - FragPos);
-            float distance = length(lightPos - FragPos);
-            attenuation = calculateAttenuation(light, distance);
-        } else if (light.type == 2) {
-            // Spotlight
-            vec3 lightPos = light.position;
-            vec3 lightDir = normalize(light.direction);
-            L = normalize(lightPos - FragPos);
-            float distance = length(lightPos - FragPos);
-            attenuation = calculateAttenuation(light, distance);
-            spotlightEffect = calculateSpotlightEffect(light, L, lightDir);
-        }
-
-        // Diffuse term
-        float diff = max(dot(N, L), 0.0);
-        vec3 diffuse = material.diffuse * diff * light.color;
-
-        // Specular term (using Phong model)
-        vec3 R = reflect(-L, N);
-        float spec = 0.0;
-        if (diff > 0.0) {
-            float specAngle = max(dot(R, V), 0.0);
-            if (specAngle > 0.0) {
-                spec = pow(specAngle, material.shininess);
-            }
-        }
-        vec3 specular = material.specular * spec * light.color;
-
-        // Apply attenuation and spotlight effect
-        diffuse *= attenuation * spotlightEffect;
-
-        // Option 1: Modify attenuation impact on specular
-        float specularAttenuation = sqrt(attenuation * spotlightEffect);
-        specular *= specularAttenuation;
-
-        // Option 2: Do not attenuate specular (uncomment if preferred)
-        // specular *= 1.0;
+    for (int i = 0; i < numGlobalLights; ++i) {
+        totalColor += shade(lights[i], material, N, V);
+    }
 
-        // Combine results
-        vec3 lightColor = diffuse + specular;
-        totalColor += lightColor;
+    // The local lights binned into this fragment's cluster
+    vec2 tile = (gl_FragCoord.xy - clusterViewport.xy) / clusterViewport.zw * vec2(CLUSTER_COUNT.xy);
+    float depth = -(view * vec4(FragPos, 1.0)).z;
+    int slice = int(floor(log(depth) * clusterDepth.x + clusterDepth.y));
+    ivec3 cluster = clamp(ivec3(ivec2(tile), slice), ivec3(0), CLUSTER_COUNT - 1);
+    uvec2 range = texelFetch(clusterLights,
+                             (cluster.z * CLUSTER_COUNT.y + cluster.y) * CLUSTER_COUNT.x + cluster.x).rg;
+    for (uint i = 0u; i < range.y; ++i) {
+        int index = int(texelFetch(lightIndices, int(range.x + i)).r);
+        totalColor += shade(lights[index], material, N, V);
     }
 
     totalColor += ambient;
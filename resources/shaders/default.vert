@@ -3,25 +3,29 @@
 // Input vertex attributes
 layout(location = 0) in vec3 aPos;      // Vertex position
 layout(location = 1) in vec3 aNormal;   // Vertex normal
+layout(location = 2) in mat4 aModel;    // Model matrix, per instance
+layout(location = 6) in uint aMaterial; // Index into Materials, per instance
 
 // Outputs to the fragment shader
 out vec3 FragPos;    // Position in world space
 out vec3 Normal;     // Normal in world space
+flat out uint MaterialIndex;
 
 // Uniforms
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 proj;
 
 void main()
 {
     // Compute the position of the vertex in clip space
-    gl_Position = proj * view * model * vec4(aPos, 1.0);
+    gl_Position = proj * view * aModel * vec4(aPos, 1.0);
 
     // Compute the normal matrix to transform normals correctly
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
+    mat3 normalMatrix = transpose(inverse(mat3(aModel)));
     Normal = normalize(normalMatrix * aNormal);
 
     // Compute the position of the vertex in world space
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+
+    MaterialIndex = aMaterial;
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 330 core
+in vec2 v_texCoord;
+out vec4 FragColor;
+
+uniform sampler2D u_texture;
+uniform vec2 u_direction; // one texel along the blur axis
+
+const int radius = 6;
+const float sigma = 3.0;
+// Thickness difference at which a sample's weight has dropped to 1/e
+const float rangeSigma = 1.5;
+
+void main()
+{
+    // Bilateral blur of the splatted thickness and color: samples across a
+    // large jump in thickness, such as the water's edge, count for little,
+    // so the outline stays sharp while the splats inside merge
+    vec4 center = texture(u_texture, v_texCoord);
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int i = -radius; i <= radius; i++) {
+        vec4 neighbour = texture(u_texture, v_texCoord + float(i) * u_direction);
+        float spatial = exp(-float(i * i) / (2.0 * sigma * sigma));
+        float difference = (neighbour.a - center.a) / rangeSigma;
+        float weight = spatial * exp(-difference * difference);
+        sum += neighbour * weight;
+        weightSum += weight;
+    }
+    FragColor = sum / weightSum;
+}
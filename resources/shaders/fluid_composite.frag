@@ -0,0 +1,51 @@
+#version 330 core
+in vec2 v_texCoord;
+out vec4 FragColor;
+
+uniform sampler2D u_texture;
+uniform vec2 u_texelSize; // size of one texel of u_texture
+
+// Smoothed thickness at which a pixel counts as water
+const float surfaceThreshold = 0.4;
+// How steep the thickness slope looks when turned into normals
+const float normalScale = 6.0;
+// How quickly deep water hides what is behind it
+const float absorption = 0.5;
+
+float height(float thickness)
+{
+    return 1.0 - exp(-thickness);
+}
+
+void main()
+{
+    vec4 fluid = texture(u_texture, v_texCoord);
+    float thickness = fluid.a;
+    // Fade in over a narrow band around the threshold to antialias the edge
+    float coverage = smoothstep(surfaceThreshold * 0.75, surfaceThreshold * 1.25, thickness);
+    if (coverage <= 0.0) {
+        discard;
+    }
+    vec3 color = fluid.rgb / thickness;
+
+    // The thickness works as a height field whose slope gives the normal. It
+    // saturates in deep water, so the surface curves at the edges and the
+    // leftover bumps of single particles inside stay flat.
+    float left = height(texture(u_texture, v_texCoord - vec2(u_texelSize.x, 0.0)).a);
+    float right = height(texture(u_texture, v_texCoord + vec2(u_texelSize.x, 0.0)).a);
+    float down = height(texture(u_texture, v_texCoord - vec2(0.0, u_texelSize.y)).a);
+    float up = height(texture(u_texture, v_texCoord + vec2(0.0, u_texelSize.y)).a);
+    vec3 normal = normalize(vec3((left - right) * normalScale, (down - up) * normalScale, 1.0));
+
+    vec3 lightDir = normalize(vec3(-0.4, 0.6, 1.0));
+    vec3 halfway = normalize(lightDir + vec3(0.0, 0.0, 1.0));
+    float diffuse = max(dot(normal, lightDir), 0.0);
+    float specular = pow(max(dot(normal, halfway), 0.0), 64.0);
+    float fresnel = pow(1.0 - normal.z, 3.0);
+
+    // Thin water lets the background through, deep water shows its own color
+    float opacity = 1.0 - exp(-thickness * absorption);
+    vec3 shaded = color * (0.4 + 0.6 * diffuse) + vec3(0.3, 0.4, 0.5) * fresnel + vec3(specular);
+    float alpha = clamp(opacity + specular + fresnel, 0.0, 1.0) * coverage;
+    FragColor = vec4(shaded, alpha);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec3 v_Color;
+out vec4 FragColor;
+
+void main() {
+    // Each sprite is a sphere seen from above: its thickness is largest at
+    // the center and falls to zero at the rim. Color is weighted by it so
+    // the composite can recover the average color.
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    float distanceSq = dot(offset, offset);
+    if (distanceSq >= 1.0) {
+        discard;
+    }
+    float thickness = sqrt(1.0 - distanceSq);
+    FragColor = vec4(v_Color * thickness, thickness);
+}
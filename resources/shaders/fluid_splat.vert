@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) in vec2 a_Position;
+layout (location = 1) in vec4 a_Color;
+
+out vec3 v_Color;
+
+uniform mat4 u_Projection;
+uniform float u_PointSize;
+
+void main() {
+    gl_Position = u_Projection * vec4(a_Position, 0.0, 1.0);
+    gl_PointSize = u_PointSize;
+    v_Color = a_Color.rgb;
+}
@@ -3,66 +3,53 @@ in vec2 v_texCoord;
 out vec4 FragColor;
 
 uniform sampler2D u_texture;
-uniform int u_filterType; // 0: None, 1: Grayscale, 2: Invert, 3: Sharpen, 4: Blur
 
+// Each filter is compiled as its own program by defining one of
+// FILTER_GRAYSCALE, FILTER_INVERT, FILTER_SHARPEN or FILTER_BLUR. With none
+// defined the program copies its input, which also upsamples a
+// half-resolution result.
+
+#if defined(FILTER_SHARPEN)
 uniform vec2 u_texelSize; // Size of one texel
+#elif defined(FILTER_BLUR)
+uniform vec2 u_direction; // One source texel along the blur axis
+#endif
 
 void main()
 {
     vec4 color = texture(u_texture, v_texCoord);
 
-    if (u_filterType == 1)
-    {
-        // Grayscale filter
-        float gray = dot(color.rgb, vec3(0.299, 0.587, 0.114));
-        color = vec4(vec3(gray), color.a);
-    }
-    else if (u_filterType == 2)
-    {
-        // Invert filter
-        color.rgb = vec3(1.0) - color.rgb;
-    }
-    else if (u_filterType == 3) {
-    // Adjusted Sharpen filter
-    float kernel[9] = float[](
-         0, -1,  0,
-        -1,  5, -1,
-         0, -1,  0
-    );
-    vec3 result = vec3(0.0);
-    int index = 0;
-    for (int y = -1; y <= 1; y++) {
-        for (int x = -1; x <= 1; x++) {
-            vec2 offset = vec2(float(x), float(y)) * u_texelSize;
-            vec3 sample = texture(u_texture, v_texCoord + offset).rgb;
-            result += sample * kernel[index++];
-        }
-    }
-    // Optionally clamp the result to avoid artifacts
-    result = clamp(result, 0.0, 1.0);
+#if defined(FILTER_GRAYSCALE)
+    float gray = dot(color.rgb, vec3(0.299, 0.587, 0.114));
+    color = vec4(vec3(gray), color.a);
+
+#elif defined(FILTER_INVERT)
+    color.rgb = vec3(1.0) - color.rgb;
+
+#elif defined(FILTER_SHARPEN)
+    // Kernel  0 -1  0
+    //        -1  5 -1
+    //         0 -1  0
+    // The corners are zero, so only the center and its four neighbours are read
+    vec3 result = 5.0 * color.rgb
+        - texture(u_texture, v_texCoord + vec2(u_texelSize.x, 0.0)).rgb
+        - texture(u_texture, v_texCoord - vec2(u_texelSize.x, 0.0)).rgb
+        - texture(u_texture, v_texCoord + vec2(0.0, u_texelSize.y)).rgb
+        - texture(u_texture, v_texCoord - vec2(0.0, u_texelSize.y)).rgb;
+    // Clamp the result to avoid artifacts
+    color = vec4(clamp(result, 0.0, 1.0), color.a);
+
+#elif defined(FILTER_BLUR)
+    // One axis of a separable 5-tap binomial blur, (1 4 6 4 1) / 16, run
+    // once horizontally and once vertically. Each pair of outer taps is one
+    // bilinear fetch between them, at offset (1 * 4 + 2 * 1) / 5 = 1.2
+    // with weight 5 / 16, so a pass reads 3 times instead of 5.
+    vec2 offset = 1.2 * u_direction;
+    vec3 result = 0.375 * color.rgb
+        + 0.3125 * (texture(u_texture, v_texCoord + offset).rgb
+                    + texture(u_texture, v_texCoord - offset).rgb);
     color = vec4(result, color.a);
-}
-else if (u_filterType == 4) {
-    // Gaussian Blur filter
-    float kernel[25] = float[](
-        1,  4,  7,  4, 1,
-        4, 16, 26, 16, 4,
-        7, 26, 41, 26, 7,
-        4, 16, 26, 16, 4,
-        1,  4,  7,  4, 1
-    );
-    float kernelSum = 273.0;
-    vec3 result = vec3(0.0);
-    int index = 0;
-    for (int y = -2; y <= 2; y++) {
-        for (int x = -2; x <= 2; x++) {
-            vec2 offset = vec2(float(x), float(y)) * u_texelSize;
-            vec3 sample = texture(u_texture, v_texCoord + offset).rgb;
-            result += sample * kernel[index++];
-        }
-    }
-    color = vec4(result / kernelSum, color.a);
-}
+#endif
 
     FragColor = color;
-}
\ No newline at end of file
+}
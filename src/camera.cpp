@@ -1,4 +1,4 @@
-#include "Camera.h"
+#include "camera.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
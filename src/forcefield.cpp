@@ -0,0 +1,337 @@
+#include "forcefield.h"
+#include "simulation.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ForceFieldSet::Targets::resize(size_t count) {
+    for (auto *array : {&x, &y, &vx, &vy, &mass, &angularSpeed, &fx, &fy}) {
+        array->resize(count);
+    }
+    touched.resize(count);
+    std::fill(fx.begin(), fx.end(), 0.0f);
+    std::fill(fy.begin(), fy.end(), 0.0f);
+    std::fill(touched.begin(), touched.end(), 0.0f);
+}
+
+namespace {
+
+// Shape of a field, copied into locals by each pass
+struct FieldParams {
+    float cx, cy;
+    float minDistanceSq;
+    float radiusSq;
+    bool inverseDistance;
+    float strength;
+    float gain;
+
+    explicit FieldParams(const ForceField &field)
+        : cx(field.center.x), cy(field.center.y),
+          minDistanceSq(field.minDistance * field.minDistance),
+          radiusSq(field.radius > 0.0f ? field.radius * field.radius : INFINITY),
+          inverseDistance(field.falloff == ForceField::Falloff::InverseDistance),
+          strength(field.strength), gain(field.gain) {}
+};
+
+// Each pass adds one field's force to every target. Targets outside the
+// field still go through the arithmetic, with the distance clamped so
+// nothing divides by zero, and their force is masked to zero. Without
+// branches, and with __restrict ruling out overlapping arrays, the loops
+// vectorize; see the flags for this file in CMakeLists.txt.
+
+void radialPass(const FieldParams &field, size_t count, const float *__restrict x,
+                const float *__restrict y, const float *__restrict mass,
+                float *__restrict fx, float *__restrict fy, float *__restrict touched) {
+    const float cx = field.cx, cy = field.cy;
+    const float minDistanceSq = field.minDistanceSq, radiusSq = field.radiusSq;
+    const bool inverseDistance = field.inverseDistance;
+    const float strength = field.strength;
+    for (size_t i = 0; i < count; i++) {
+        float dx = x[i] - cx, dy = y[i] - cy;
+        float distanceSq = dx * dx + dy * dy;
+        float inside = distanceSq > minDistanceSq && distanceSq < radiusSq ? 1.0f : 0.0f;
+        float distance = std::sqrt(std::max(distanceSq, minDistanceSq));
+        float magnitude = strength * mass[i] / (inverseDistance ? distance : 1.0f);
+        float forceX = -dx / distance * magnitude;
+        float forceY = -dy / distance * magnitude;
+        fx[i] += inside * forceX;
+        fy[i] += inside * forceY;
+        touched[i] = std::max(touched[i], inside);
+    }
+}
+
+void burstPass(const FieldParams &field, size_t count, float burstMass,
+               const float *__restrict x, const float *__restrict y,
+               float *__restrict fx, float *__restrict fy, float *__restrict touched) {
+    const float cx = field.cx, cy = field.cy;
+    const float minDistanceSq = field.minDistanceSq, radiusSq = field.radiusSq;
+    const bool inverseDistance = field.inverseDistance;
+    const float strength = field.strength;
+    for (size_t i = 0; i < count; i++) {
+        float dx = x[i] - cx, dy = y[i] - cy;
+        float distanceSq = dx * dx + dy * dy;
+        float inside = distanceSq > minDistanceSq && distanceSq < radiusSq ? 1.0f : 0.0f;
+        float distance = std::sqrt(std::max(distanceSq, minDistanceSq));
+        float magnitude = strength * burstMass / (inverseDistance ? distance : 1.0f);
+        float forceX = dx / distance * magnitude;
+        float forceY = dy / distance * magnitude;
+        fx[i] += inside * forceX;
+        fy[i] += inside * forceY;
+        touched[i] = std::max(touched[i], inside);
+    }
+}
+
+void vortexPass(const FieldParams &field, size_t count, const float *__restrict x,
+                const float *__restrict y, const float *__restrict vx,
+                const float *__restrict vy, const float *__restrict mass,
+                const float *__restrict angularSpeed, float *__restrict fx,
+                float *__restrict fy, float *__restrict touched) {
+    const float cx = field.cx, cy = field.cy;
+    const float minDistanceSq = field.minDistanceSq, radiusSq = field.radiusSq;
+    const float strength = field.strength, gain = field.gain;
+    for (size_t i = 0; i < count; i++) {
+        float dx = x[i] - cx, dy = y[i] - cy;
+        float distanceSq = dx * dx + dy * dy;
+        float inside = distanceSq > minDistanceSq && distanceSq < radiusSq ? 1.0f : 0.0f;
+        float distance = std::sqrt(std::max(distanceSq, minDistanceSq));
+        float nx = dx / distance, ny = dy / distance;
+        float tx = -ny, ty = nx;
+
+        // Correct the tangential speed toward v = w * r, and supply the
+        // centripetal force that keeps the target on its circle
+        float desiredSpeed = strength * angularSpeed[i] * distance;
+        float tangentialSpeed = vx[i] * tx + vy[i] * ty;
+        float tangentForce = (desiredSpeed - tangentialSpeed) * gain * mass[i];
+        float centripetalForce = desiredSpeed * desiredSpeed / distance * mass[i];
+        float forceX = tx * tangentForce - nx * centripetalForce;
+        float forceY = ty * tangentForce - ny * centripetalForce;
+        fx[i] += inside * forceX;
+        fy[i] += inside * forceY;
+        touched[i] = std::max(touched[i], inside);
+    }
+}
+
+// Collects the dynamic bodies with a fixture in the query box
+class BodyQuery : public b2QueryCallback {
+public:
+    explicit BodyQuery(std::vector<b2Body *> &bodies) : m_bodies(bodies) {}
+
+    bool ReportFixture(b2Fixture *fixture) override {
+        b2Body *body = fixture->GetBody();
+        if (body->GetType() == b2_dynamicBody) {
+            m_bodies.push_back(body);
+        }
+        return true;
+    }
+
+    // Particles are queried from their system directly
+    bool ShouldQueryParticleSystem(const b2ParticleSystem *) override {
+        return false;
+    }
+
+private:
+    std::vector<b2Body *> &m_bodies;
+};
+
+// Collects the indices of the particles in the query box
+class ParticleQuery : public b2QueryCallback {
+public:
+    explicit ParticleQuery(std::vector<int32> &indices) : m_indices(indices) {}
+
+    bool ReportFixture(b2Fixture *) override {
+        return true;
+    }
+
+    bool ReportParticle(const b2ParticleSystem *, int32 index) override {
+        m_indices.push_back(index);
+        return true;
+    }
+
+private:
+    std::vector<int32> &m_indices;
+};
+
+} // namespace
+
+void ForceFieldSet::evaluate(const ForceField &field, Targets &t, size_t count) {
+    FieldParams params(field);
+    switch (field.type) {
+    case ForceField::Type::Radial:
+        radialPass(params, count, t.x.data(), t.y.data(), t.mass.data(),
+                   t.fx.data(), t.fy.data(), t.touched.data());
+        break;
+    case ForceField::Type::Burst:
+        burstPass(params, count, t.burstMass, t.x.data(), t.y.data(),
+                  t.fx.data(), t.fy.data(), t.touched.data());
+        break;
+    case ForceField::Type::Vortex:
+        if (!t.orbits) {
+            break;
+        }
+        vortexPass(params, count, t.x.data(), t.y.data(), t.vx.data(), t.vy.data(),
+                   t.mass.data(), t.angularSpeed.data(), t.fx.data(), t.fy.data(),
+                   t.touched.data());
+        break;
+    }
+}
+
+void ForceFieldSet::apply(std::vector<PhysObject> &objects, b2World *world,
+                          b2ParticleSystem *particles, float timeStep) {
+    applyGlobal(objects, particles);
+    for (const ForceField &field : m_fields) {
+        if (field.radius > 0.0f) {
+            applyBounded(field, world, particles, timeStep);
+        }
+    }
+}
+
+void ForceFieldSet::applyGlobal(std::vector<PhysObject> &objects, b2ParticleSystem *particles) {
+    bool hasGlobalField = false;
+    for (const ForceField &field : m_fields) {
+        hasGlobalField = hasGlobalField || field.radius <= 0.0f;
+    }
+    if (!hasGlobalField) {
+        return;
+    }
+
+    // Bodies
+    m_bodyObjects.clear();
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (objects[i].body->GetType() == b2_dynamicBody) {
+            m_bodyObjects.push_back(int(i));
+        }
+    }
+    size_t bodyCount = m_bodyObjects.size();
+    m_bodies.resize(bodyCount);
+    m_bodies.burstMass = 1.0f;
+    m_bodies.orbits = true;
+    for (size_t i = 0; i < bodyCount; i++) {
+        const PhysObject &obj = objects[m_bodyObjects[i]];
+        b2Vec2 position = obj.body->GetPosition();
+        b2Vec2 velocity = obj.body->GetLinearVelocity();
+        m_bodies.x[i] = position.x;
+        m_bodies.y[i] = position.y;
+        m_bodies.vx[i] = velocity.x;
+        m_bodies.vy[i] = velocity.y;
+        m_bodies.mass[i] = obj.body->GetMass();
+        m_bodies.angularSpeed[i] = obj.orbitAngularSpeed;
+    }
+    for (const ForceField &field : m_fields) {
+        if (field.radius <= 0.0f) {
+            evaluate(field, m_bodies, bodyCount);
+        }
+    }
+    for (size_t i = 0; i < bodyCount; i++) {
+        if (m_bodies.touched[i] != 0.0f) {
+            objects[m_bodyObjects[i]].body->ApplyForceToCenter(b2Vec2(m_bodies.fx[i], m_bodies.fy[i]), true);
+        }
+    }
+
+    // Particles, unless every field without a radius is a Vortex
+    bool hasParticleField = false;
+    for (const ForceField &field : m_fields) {
+        hasParticleField = hasParticleField ||
+                           (field.radius <= 0.0f && field.type != ForceField::Type::Vortex);
+    }
+    if (!hasParticleField || !particles || particles->GetParticleCount() == 0) {
+        return;
+    }
+    size_t particleCount = size_t(particles->GetParticleCount());
+    m_particles.resize(particleCount);
+    // A burst sized for bodies would fling particles, which weigh a fraction
+    // of them, so particles take its strength as an acceleration
+    m_particles.burstMass = particles->GetParticleMass();
+    const b2Vec2 *positions = particles->GetPositionBuffer();
+    const b2Vec2 *velocities = particles->GetVelocityBuffer();
+    std::fill(m_particles.mass.begin(), m_particles.mass.end(), particles->GetParticleMass());
+    for (size_t i = 0; i < particleCount; i++) {
+        m_particles.x[i] = positions[i].x;
+        m_particles.y[i] = positions[i].y;
+        m_particles.vx[i] = velocities[i].x;
+        m_particles.vy[i] = velocities[i].y;
+    }
+    for (const ForceField &field : m_fields) {
+        if (field.radius <= 0.0f) {
+            evaluate(field, m_particles, particleCount);
+        }
+    }
+    m_particleForces.resize(particleCount);
+    for (size_t i = 0; i < particleCount; i++) {
+        m_particleForces[i].Set(m_particles.fx[i], m_particles.fy[i]);
+    }
+    particles->ApplyForces(0, int32(particleCount), m_particleForces.data());
+}
+
+void ForceFieldSet::applyBounded(const ForceField &field, b2World *world,
+                                 b2ParticleSystem *particles, float timeStep) {
+    b2AABB box;
+    box.lowerBound.Set(field.center.x - field.radius, field.center.y - field.radius);
+    box.upperBound.Set(field.center.x + field.radius, field.center.y + field.radius);
+
+    // Bodies. A body with several fixtures in the box is reported once per
+    // fixture.
+    m_queriedBodies.clear();
+    BodyQuery bodyQuery(m_queriedBodies);
+    world->QueryAABB(&bodyQuery, box);
+    std::sort(m_queriedBodies.begin(), m_queriedBodies.end());
+    m_queriedBodies.erase(std::unique(m_queriedBodies.begin(), m_queriedBodies.end()),
+                          m_queriedBodies.end());
+    size_t bodyCount = m_queriedBodies.size();
+    if (bodyCount > 0) {
+        m_bodies.resize(bodyCount);
+        m_bodies.burstMass = 1.0f;
+        m_bodies.orbits = false;
+        for (size_t i = 0; i < bodyCount; i++) {
+            const b2Body *body = m_queriedBodies[i];
+            m_bodies.x[i] = body->GetPosition().x;
+            m_bodies.y[i] = body->GetPosition().y;
+            m_bodies.vx[i] = body->GetLinearVelocity().x;
+            m_bodies.vy[i] = body->GetLinearVelocity().y;
+            m_bodies.mass[i] = body->GetMass();
+        }
+        evaluate(field, m_bodies, bodyCount);
+        for (size_t i = 0; i < bodyCount; i++) {
+            if (m_bodies.touched[i] != 0.0f) {
+                m_queriedBodies[i]->ApplyForceToCenter(b2Vec2(m_bodies.fx[i], m_bodies.fy[i]), true);
+            }
+        }
+    }
+
+    // Particles. Their search proxies were sorted at the start of the step
+    // and they have moved since, by at most about a diameter, so the box
+    // grows by that much to still find them all.
+    if (field.type == ForceField::Type::Vortex || !particles ||
+        particles->GetParticleCount() == 0) {
+        return;
+    }
+    float margin = 2.0f * particles->GetRadius();
+    b2AABB particleBox = box;
+    particleBox.lowerBound -= b2Vec2(margin, margin);
+    particleBox.upperBound += b2Vec2(margin, margin);
+    m_queriedParticles.clear();
+    ParticleQuery particleQuery(m_queriedParticles);
+    particles->QueryAABB(&particleQuery, particleBox);
+    size_t particleCount = m_queriedParticles.size();
+    if (particleCount == 0) {
+        return;
+    }
+    m_particles.resize(particleCount);
+    m_particles.burstMass = particles->GetParticleMass();
+    const b2Vec2 *positions = particles->GetPositionBuffer();
+    const b2Vec2 *velocities = particles->GetVelocityBuffer();
+    std::fill(m_particles.mass.begin(), m_particles.mass.end(), particles->GetParticleMass());
+    for (size_t i = 0; i < particleCount; i++) {
+        int32 index = m_queriedParticles[i];
+        m_particles.x[i] = positions[index].x;
+        m_particles.y[i] = positions[index].y;
+        m_particles.vx[i] = velocities[index].x;
+        m_particles.vy[i] = velocities[index].y;
+    }
+    evaluate(field, m_particles, particleCount);
+    m_particleForces.resize(particleCount);
+    for (size_t i = 0; i < particleCount; i++) {
+        m_particleForces[i].Set(m_particles.fx[i] * timeStep, m_particles.fy[i] * timeStep);
+    }
+    particles->ApplyLinearImpulses(m_queriedParticles.data(), int32(particleCount),
+                                   m_particleForces.data());
+}
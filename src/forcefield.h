@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include <Box2D/Common/b2Math.h>
+
+class b2Body;
+class b2ParticleSystem;
+class b2World;
+struct PhysObject;
+
+// A force acting on everything around a center point
+struct ForceField {
+    enum class Type {
+        Radial, // pull toward the center, proportional to mass
+        Vortex, // steer objects onto their circular orbits around the center
+        Burst   // push away from the center
+    };
+    enum class Falloff {
+        Constant,
+        InverseDistance
+    };
+
+    Type type = Type::Radial;
+    Falloff falloff = Falloff::Constant;
+    glm::vec2 center = glm::vec2(0.0f);
+    // Radial and Burst: force scale. Vortex: multiplies each target's
+    // orbital angular speed.
+    float strength = 0.0f;
+    // Vortex: how fast velocities are corrected toward the orbit
+    float gain = 10.0f;
+    // Targets closer than this to the center are left alone
+    float minDistance = 0.01f;
+    // Targets at this distance or further are left alone; 0 for no limit
+    float radius = 0.0f;
+};
+
+// Evaluates a set of fields over the dynamic objects and particles.
+// Targets are gathered into dense arrays and each field is a single
+// branch-free pass over them that the compiler can vectorize; the summed
+// force is then applied once per target.
+//
+// Fields without a radius reach everything, so they share one pass over
+// every dynamic object and every particle, which receive their forces
+// through one ApplyForces range. A field with a radius only gathers what a
+// world and particle system query finds in its bounding box, so its cost
+// follows the size of the region, not of the scene. Particles found that
+// way get force * timeStep through ApplyLinearImpulses, the velocity change
+// the force would give over the step.
+//
+// A Vortex only steers targets with an orbital speed of their own: the
+// dynamic objects a field without a radius reaches. Particles and bodies
+// found by a query have none, and a target speed of zero would only brake
+// them, so Vortex fields leave them alone.
+class ForceFieldSet {
+public:
+    void clear() { m_fields.clear(); }
+    void add(const ForceField &field) { m_fields.push_back(field); }
+    bool empty() const { return m_fields.empty(); }
+
+    void apply(std::vector<PhysObject> &objects, b2World *world,
+               b2ParticleSystem *particles, float timeStep);
+
+private:
+    // One target array: positions, velocities, masses, orbital speeds and
+    // the accumulated forces. touched is 1 for targets a field acted on,
+    // which are woken up even if the forces cancel out; it is a float so the
+    // field loops work on a single element type.
+    struct Targets {
+        std::vector<float> x, y, vx, vy, mass, angularSpeed;
+        std::vector<float> fx, fy;
+        std::vector<float> touched;
+        // Mass a Burst pushes against, the same for every target
+        float burstMass = 1.0f;
+        // Whether angularSpeed is filled in; Vortex fields skip the targets
+        // otherwise
+        bool orbits = false;
+
+        void resize(size_t count);
+    };
+
+    static void evaluate(const ForceField &field, Targets &targets, size_t count);
+
+    void applyGlobal(std::vector<PhysObject> &objects, b2ParticleSystem *particles);
+    void applyBounded(const ForceField &field, b2World *world,
+                      b2ParticleSystem *particles, float timeStep);
+
+    std::vector<ForceField> m_fields;
+    Targets m_bodies;
+    Targets m_particles;
+    std::vector<b2Vec2> m_particleForces;
+    std::vector<int> m_bodyObjects; // index in objects of each body target
+    std::vector<b2Body *> m_queriedBodies;
+    std::vector<int32> m_queriedParticles;
+};
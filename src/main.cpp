@@ -1,11 +1,26 @@
 #include "mainwindow.h"
+#include "simulation.h"
 
 #include <QApplication>
 #include <QScreen>
 #include <iostream>
 #include <QSettings>
+#include <cstring>
 
 int main(int argc, char *argv[]) {
+    // --replay <file> re-runs a session recorded with --record, without a
+    // window and as fast as the simulation allows. --check-triads also
+    // verifies every incremental triad update against a full one.
+    bool checkTriads = false;
+    for (int i = 1; i < argc; i++) {
+        checkTriads = checkTriads || std::strcmp(argv[i], "--check-triads") == 0;
+    }
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], "--replay") == 0) {
+            return Simulation::replay(argv[i + 1], checkTriads) ? 0 : 1;
+        }
+    }
+
     QApplication a(argc, argv);
 
     QCoreApplication::setApplicationName("Projects 5 & 6: Lights, Camera & Action!");
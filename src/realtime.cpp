@@ -1,10 +1,11 @@
 #include "realtime.h"
 #include "glm/gtc/type_ptr.hpp"
 
-#include "utils/shaderloader.h"
 #include <QCoreApplication>
 #include <QMouseEvent>
 #include <QKeyEvent>
+#include <QDateTime>
+#include <QDir>
 #include <iostream>
 #include "settings.h"
 #include <glm/gtx/string_cast.hpp>
@@ -20,9 +21,21 @@ QString texturePaths[7] = {
     ":/resources/planetText/uranus.png",
     ":/resources/planetText/neptune.png"
 };
+const QString sunTexturePath = ":/resources/planetText/test.png";
+// Side of each layer of the planet texture array. Planets cover a few dozen
+// pixels on screen, so the 1280px sources are downsampled on upload.
+const int planetTextureSize = 512;
+// Size of saved images and recorded frames
+const int captureWidth = 1024;
+const int captureHeight = 768;
+// Quick save slot for F5 / F9
+const std::string snapshotPath = "snapshots/quicksave.snap";
+// Linked shader programs kept between runs
+const std::string shaderCacheDirectory = "shadercache";
 
 Realtime::Realtime(QWidget *parent)
-    : QOpenGLWidget(parent)
+    : QOpenGLWidget(parent),
+      m_programCache(shaderCacheDirectory)
 {
     m_prev_mouse_pos = glm::vec2(size().width()/2, size().height()/2);
     setMouseTracking(true);
@@ -47,20 +60,36 @@ void Realtime::finish() {
     killTimer(m_timer);
     makeCurrent();
 
-    // Delete OpenGL resources
-    for (const auto& shapeData : m_renderData.shapes) {
-        if (shapeData.VAO) {
-            glDeleteVertexArrays(1, &shapeData.VAO);
-            glDeleteBuffers(1, &shapeData.VBO);
-            if (shapeData.EBO) {
-                glDeleteBuffers(1, &shapeData.EBO);
-            }
-        }
+    // Take the screenshots still waiting for a readback slot while there is
+    // something to render
+    while (!m_pendingScreenshots.empty()) {
+        m_frameCapture.flush();
+        captureScreenshot(m_pendingScreenshots.front());
+        m_pendingScreenshots.pop_front();
     }
 
+    // Delete OpenGL resources
+    m_shapeCache.finish();
+    m_renderQueue.finish();
+    m_lightClusters.finish();
+
     // Delete shader programs
     glDeleteProgram(m_shaderProgram);
     glDeleteProgram(m_textureShader);
+    glDeleteProgram(m_phong_shader);
+
+    releaseObjectGeometry();
+    m_textureCache.clear();
+    m_fluidRenderer.finish();
+    m_postProcessor.finish();
+    if (m_simulation) {
+        m_simulation->stopRecording();
+    }
+    if (m_recorder.isRecording()) {
+        m_frameCapture.flush();
+        m_recorder.stop();
+    }
+    m_frameCapture.finish();
 
     // Delete FBO resources
     glDeleteFramebuffers(1, &m_fbo);
@@ -99,33 +128,40 @@ void Realtime::initializeGL() {
     // You can use a very basic shader:
     // Vertex shader: just pass through position
     // Fragment shader: output a solid color
-    m_shaderProgram2D = ShaderLoader::createShaderProgram(
+    m_shaderProgram2D = m_programCache.program(
         ":/resources/shaders/2D.vert",
         ":/resources/shaders/2D.frag"
         );
-
-    // Create Box2D world with gravity
-    b2Vec2 gravity(0.0f, -9.8f);
-
-    m_world = new b2World(gravity);
-
-    // Create ground body
-    {
-        b2BodyDef groundDef;
-        groundDef.position.Set(0.0f, -m_worldHeight / 2.0f - 1.0f);
-        m_groundBody = m_world->CreateBody(&groundDef);
-
-        b2PolygonShape groundBox;
-        groundBox.SetAsBox(m_worldWidth, 1.0f);
-        m_groundBody->CreateFixture(&groundBox, 0.0f);
-    }
-    {
-        b2ParticleSystemDef particleSystemDef;
-        particleSystemDef.radius = 0.05f; // Adjust for desired density
-        particleSystemDef.dampingStrength = 0.2f;
-        m_particleSystem = m_world->CreateParticleSystem(&particleSystemDef);
-        m_particleSystem->SetGravityScale(1.0f);
-        m_particleSystem->SetMaxParticleCount(5000); // Limit particle count
+    // Lit shading for the shapes of a loaded scene
+    m_phong_shader = m_programCache.program(
+        ":/resources/shaders/default.vert",
+        ":/resources/shaders/default.frag"
+        );
+    m_renderQueue.initialize(m_phong_shader);
+    m_lightClusters.initialize(m_phong_shader);
+
+    // Decode the planet textures once; switching scenes only looks up layers
+    std::vector<QString> planetTextures(std::begin(texturePaths), std::end(texturePaths));
+    planetTextures.push_back(sunTexturePath);
+    m_textureCache.buildArray(planetTextures, planetTextureSize);
+
+    m_fluidRenderer.initialize(m_programCache);
+    m_postProcessor.initialize(m_programCache);
+    std::cout << "Shader programs: " << m_programCache.hits() << " from cache, "
+              << m_programCache.misses() << " compiled" << std::endl;
+
+    m_simulation = std::make_unique<Simulation>(m_worldWidth, m_worldHeight);
+    m_simulation->setExplosionStrength(settings.shapeParameter1);
+    m_simulation->setOrbitSpeed(settings.shapeParameter2);
+
+    // --record <file> logs every input of the session for headless replay
+    QStringList arguments = QCoreApplication::arguments();
+    int recordIndex = arguments.indexOf("--record");
+    if (recordIndex >= 0 && recordIndex + 1 < arguments.size()) {
+        std::string path = arguments[recordIndex + 1].toStdString();
+        if (m_simulation->startRecording(path)) {
+            std::cout << "Recording inputs to " << path << std::endl;
+        }
     }
     m_timer = startTimer(16); // ~60FPS
 }
@@ -135,19 +171,46 @@ void Realtime::setup2DProjection(int w, int h) {
     m_screenWidth = w;
     m_screenHeight = h;
     m_worldHeight = m_worldWidth * (float(h)/float(w));
+    if (m_simulation) {
+        m_simulation->setWorldSize(m_worldWidth, m_worldHeight);
+    }
 
     // In a 2D shader, you'll just supply an orthographic matrix:
     // e.g. projection = glm::ortho(-m_worldWidth/2.0f, m_worldWidth/2.0f, -m_worldHeight/2.0f, m_worldHeight/2.0f, -1.0f, 1.0f);
     // Pass this uniform to your shaders every frame.
 }
 void Realtime::paintGL() {
+    // Hand finished screenshot readbacks to the encoder thread
+    m_frameCapture.poll();
+
+    // Retry a screenshot that found every readback slot busy
+    if (!m_capturingScreenshot && !m_pendingScreenshots.empty()) {
+        if (captureScreenshot(m_pendingScreenshots.front())) {
+            m_pendingScreenshots.pop_front();
+        }
+        if (!m_pendingScreenshots.empty()) {
+            update();
+        }
+    }
+
+    bool filtered = m_currentFilter != PostProcessor::Filter::None;
+    if (filtered) {
+        m_postProcessor.beginFrame();
+    }
+
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(m_shaderProgram2D);
+    // A loaded scene is the backdrop of the simulation
+    paintScene();
 
     glm::mat4 proj = glm::ortho(-m_worldWidth/2.0f, m_worldWidth/2.0f,
                                 -m_worldHeight/2.0f, m_worldHeight/2.0f,
                                 -1.0f, 1.0f);
+
+    // Water goes under the bodies
+    m_fluidRenderer.render(m_simulation->particleSystem(), proj);
+
+    glUseProgram(m_shaderProgram2D);
     GLint projLoc = glGetUniformLocation(m_shaderProgram2D, "u_Projection");
     glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(proj));
 
@@ -159,6 +222,7 @@ void Realtime::paintGL() {
 
     GLint useTextureLoc = glGetUniformLocation(m_shaderProgram2D, "u_UseTexture");
     GLint textureLoc = glGetUniformLocation(m_shaderProgram2D, "u_Texture");
+    GLint textureLayerLoc = glGetUniformLocation(m_shaderProgram2D, "u_TextureLayer");
 
     // Set light position (sun position, which is 0,0)
     glUniform2f(lightPosLoc, 0.0f, 0.0f);
@@ -167,59 +231,17 @@ void Realtime::paintGL() {
     float currentTime = m_elapsedTimer.elapsed() / 1000.0f;
     glUniform1f(timeLoc, currentTime);
 
-    int32 particleCount = m_particleSystem->GetParticleCount();
-    if (particleCount > 0) {
-        const b2Vec2* positions = m_particleSystem->GetPositionBuffer();
+    // Every textured body samples a layer of the same array texture, so it is
+    // bound once for the whole pass
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureCache.arrayTexture());
+    glUniform1i(textureLoc, 0);
 
-        // Initialize VAO/VBO once
-        if (!m_particleVAOInitialized) {
-            glGenVertexArrays(1, &m_particleVAO);
-            glBindVertexArray(m_particleVAO);
-
-            glGenBuffers(1, &m_particleVBO);
-            glBindBuffer(GL_ARRAY_BUFFER, m_particleVBO);
-
-            // Setup position attribute
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-            glEnableVertexAttribArray(0);
-
-            // Setup texCoord attribute with default values
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-            glEnableVertexAttribArray(1);
-
-            glBindVertexArray(0);
-            m_particleVAOInitialized = true;
+    for (auto &obj : m_simulation->objects()) {
+        if (!obj.VAO) {
+            uploadObjectGeometry(obj);
         }
 
-        // Create a buffer that includes both position and default texture coordinates
-        std::vector<float> vertexData;
-        vertexData.reserve(particleCount * 4); // 4 floats per particle (2 for pos, 2 for texCoord)
-        for (int i = 0; i < particleCount; i++) {
-            // Position
-            vertexData.push_back(positions[i].x);
-            vertexData.push_back(positions[i].y);
-            // Default texture coordinates
-            vertexData.push_back(0.0f);
-            vertexData.push_back(0.0f);
-        }
-
-        // Update particle positions into VBO
-        glBindBuffer(GL_ARRAY_BUFFER, m_particleVBO);
-        glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(), GL_DYNAMIC_DRAW);
-
-        // Set uniforms and draw
-        glm::mat4 particleModel = glm::mat4(1.0f);
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(particleModel));
-        glUniform3f(colorLoc, 0.0f, 0.0f, 1.0f);  // Blue color for water
-
-        glBindVertexArray(m_particleVAO);
-        glPointSize(5.0f);
-        glUniform1i(planetTypeLoc, 99); // or some value that corresponds to no masking
-
-        glDrawArrays(GL_POINTS, 0, particleCount);
-        glBindVertexArray(0);
-    }
-    for (auto &obj : m_objects) {
         b2Vec2 pos = obj.body->GetPosition();
         float angle = obj.body->GetAngle();
 
@@ -227,10 +249,8 @@ void Realtime::paintGL() {
         model = glm::rotate(model, angle, glm::vec3(0.f, 0.f, 1.f));
         glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
 
-        if (obj.hasTexture && obj.textureID != 0) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, obj.textureID);
-            glUniform1i(textureLoc, 0);
+        if (obj.hasTexture) {
+            glUniform1i(textureLayerLoc, obj.textureLayer);
             glUniform1i(useTextureLoc, 1);
         } else {
             glUniform3fv(colorLoc, 1, glm::value_ptr(obj.color));
@@ -258,9 +278,26 @@ void Realtime::paintGL() {
 
     glUseProgram(0);
 
+    if (filtered) {
+        m_postProcessor.endFrame(m_currentFilter);
+    }
+
+    // Record the frame drawn to the widget; screenshots render into the
+    // capture target instead and are not part of the recording
+    if (m_recorder.isRecording()) {
+        GLint framebuffer;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+        if ((GLuint)framebuffer == defaultFramebufferObject()) {
+            m_frameCapture.captureFramebuffer(framebuffer,
+                                              width() * devicePixelRatioF(),
+                                              height() * devicePixelRatioF(),
+                                              &m_recorder);
+        }
+    }
 }
 void Realtime::resizeGL(int w, int h) {
     setup2DProjection(w, h);
+    m_camera.updateProjectionMatrix(w, h);
     update();
 }
 void Realtime::sceneChanged() {
@@ -274,11 +311,19 @@ void Realtime::sceneChanged() {
         return;
     }
 
+    const SceneCameraData &cameraData = m_renderData.cameraData;
+    m_camera.position = glm::vec3(cameraData.pos);
+    m_camera.look = glm::vec3(cameraData.look);
+    m_camera.up = glm::vec3(cameraData.up);
+    m_camera.fovy = cameraData.heightAngle;
+    m_camera.nearPlane = settings.nearPlane;
+    m_camera.farPlane = settings.farPlane;
+    m_camera.updateViewMatrix();
+    m_camera.updateProjectionMatrix(width(), height());
 
+    initializeShapes();
 
-    // Initialize shapes (set up VAOs/VBOs)
-
-    // Initialize lights
+    m_lightClusters.setLights(m_renderData.lights);
 
     doneCurrent();
     update(); // Request a repaint
@@ -293,18 +338,10 @@ void Realtime::settingsChanged() {
     m_camera.farPlane = settings.farPlane;
     m_camera.updateProjectionMatrix(width(), height());
 
-    // Check if tessellation parameters have changed
-    m_explosionStrength = settings.shapeParameter1;
-    static int prevParam2 = settings.shapeParameter2;
-
-    if (settings.shapeParameter1 != m_explosionStrength || settings.shapeParameter2 != prevParam2) {
-        m_explosionStrength = settings.shapeParameter1;
-        prevParam2 = settings.shapeParameter2;
-
-        // Regenerate shapes with new tessellation parameters
-        makeCurrent();
- // Re-initialize shapes with updated parameters
-        doneCurrent();
+    // Explosion strength and orbit speed follow the parameter sliders
+    if (m_simulation) {
+        m_simulation->setExplosionStrength(settings.shapeParameter1);
+        m_simulation->setOrbitSpeed(settings.shapeParameter2);
     }
 
     update(); // Request a repaint
@@ -313,34 +350,10 @@ void Realtime::settingsChanged() {
 
 
 
-void Realtime::createPhysicsObject(float x, float y) {
-    // Make the OpenGL context current before creating VAOs and VBOs
-    makeCurrent();
-
-    b2BodyDef bodyDef;
-    bodyDef.type = b2_dynamicBody;
-    bodyDef.position.Set(x, y);
-    b2Body* body = m_world->CreateBody(&bodyDef);
-
-    PhysObject obj;
-    obj.body = body;
-    obj.shape = m_currentShape;
-    obj.color = m_currentColor;
-    float halfSize = m_currentSize;
-
-    if (obj.shape == ObjectShape::BOX) {
-        obj.isCircle = false;
-        obj.size = glm::vec2(halfSize);
-
-        b2PolygonShape dynamicBox;
-        dynamicBox.SetAsBox(halfSize, halfSize);
-
-        b2FixtureDef fixtureDef;
-        fixtureDef.shape = &dynamicBox;
-        fixtureDef.density = 1.0f;
-        fixtureDef.friction = 0.3f;
-        body->CreateFixture(&fixtureDef);
+void Realtime::uploadObjectGeometry(PhysObject &obj) {
+    float halfSize = obj.size.x;
 
+    if (!obj.isCircle) {
         GLfloat verts[] = {
             -halfSize, -halfSize,
             halfSize, -halfSize,
@@ -363,19 +376,7 @@ void Realtime::createPhysicsObject(float x, float y) {
 
         glBindVertexArray(0);
 
-    } else if (obj.shape == ObjectShape::CIRCLE) {
-        obj.isCircle = true;
-        obj.size = glm::vec2(halfSize);
-
-        b2CircleShape circle;
-        circle.m_radius = halfSize;
-
-        b2FixtureDef fixtureDef;
-        fixtureDef.shape = &circle;
-        fixtureDef.density = 1.0f;
-        fixtureDef.friction = 0.3f;
-        body->CreateFixture(&fixtureDef);
-
+    } else {
         const int NUM_SEGMENTS = 24;
         std::vector<GLfloat> circleVerts;
 
@@ -416,10 +417,23 @@ void Realtime::createPhysicsObject(float x, float y) {
         glBindVertexArray(0);
     }
 
-    m_objects.push_back(obj);
+    if (obj.planet == 0) {
+        assignPlanetTexture(obj, sunTexturePath);
+    } else if (obj.planet > 0) {
+        assignPlanetTexture(obj, texturePaths[obj.planet - 1]);
+    }
+}
 
-    // After finishing creation, you can let paintGL handle the rest.
-    // No need to call doneCurrent() here, as QOpenGLWidget will handle context switching appropriately.
+void Realtime::releaseObjectGeometry() {
+    if (!m_simulation) {
+        return;
+    }
+    makeCurrent();
+    for (auto &obj : m_simulation->objects()) {
+        glDeleteVertexArrays(1, &obj.VAO);
+        glDeleteBuffers(1, &obj.VBO);
+        obj.VAO = obj.VBO = 0;
+    }
 }
 
 // ================== Project 6: Action!
@@ -450,7 +464,7 @@ void Realtime::keyPressEvent(QKeyEvent *event) {
         m_selectingOrbitCenter = true;
         m_selectingGravityCenter = false;
         m_selectingExplosionCenter = false;
-        m_world->SetGravity(b2Vec2(0.0f, 0.0f));
+        m_simulation->setGravity(0.0f, 0.0f);
         std::cout << "Orbit mode activated. Click on the screen to make objects orbit." << std::endl;
         break;
     case Qt::Key_6:
@@ -485,80 +499,67 @@ void Realtime::keyPressEvent(QKeyEvent *event) {
     case Qt::Key_0:
         resetWorld();
         break;
+    case Qt::Key_V:
+        // V records a Y4M stream, Shift+V a PNG sequence
+        toggleRecording(event->modifiers() & Qt::ShiftModifier
+                            ? FrameRecorder::Format::PNGSequence
+                            : FrameRecorder::Format::Y4M);
+        break;
+    case Qt::Key_F: {
+        const char *names[] = {"None", "Grayscale", "Invert", "Sharpen", "Blur"};
+        int filter = (int(m_currentFilter) + 1) % 5;
+        m_currentFilter = PostProcessor::Filter(filter);
+        std::cout << "Filter: " << names[filter] << std::endl;
+        break;
+    }
+    case Qt::Key_H:
+        m_postProcessor.setHalfResolution(!m_postProcessor.halfResolution());
+        std::cout << "Half resolution blur: "
+                  << (m_postProcessor.halfResolution() ? "on" : "off") << std::endl;
+        break;
+    case Qt::Key_F5:
+        saveSnapshot();
+        break;
+    case Qt::Key_F9:
+        loadSnapshot();
+        break;
 
     default:
         break;
     }
 }
-GLuint loadTexture(const QString &filePath) {
-    QImage img;
-    if(!img.load(filePath)) {
-        std::cerr << "Failed to load texture: " << filePath.toStdString() << std::endl;
-        return 0;
-    }
-    img = img.convertToFormat(QImage::Format_RGBA8888);
-
-    GLuint texID;
-    glGenTextures(1, &texID);
-    glBindTexture(GL_TEXTURE_2D, texID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.width(), img.height(),
-                 0, GL_RGBA, GL_UNSIGNED_BYTE, img.constBits());
-
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    return texID;
+void Realtime::assignPlanetTexture(PhysObject &obj, const QString &path) {
+    obj.textureLayer = m_textureCache.layer(path);
+    obj.hasTexture = obj.textureLayer >= 0;
 }
 void Realtime::resetWorld() {
-    // Delete all Box2D bodies and reset vectors
-    for (auto& obj : m_objects) {
-        m_world->DestroyBody(obj.body);
-    }
-    m_objects.clear();
-
-    // Clear all particles
-    if (m_particleSystem) {
-        m_particleSystem->DestroyParticle(0, false);
-    }
-
-    // Clear all brush strokes (both visual and physical)
-    m_allBrushStrokes.clear();
-    m_currentStroke.clear();
+    releaseObjectGeometry();
+    m_simulation->resetWorld();
 
-    // Destroy all brush bodies
-    b2Body* body = m_world->GetBodyList();
-    while (body) {
-        b2Body* nextBody = body->GetNext(); // Get next before destroying current
-        if (body != m_groundBody) { // Don't destroy ground yet
-            m_world->DestroyBody(body);
-        }
-        body = nextBody;
-    }
-
-    // Reset current brush pointer
-    m_currentBrush = nullptr;
-
-    // Reset gravity and modes
-    m_world->SetGravity(b2Vec2(0.0f, -9.8f));
-    m_hasGravityCenter = false;
-    m_orbitMode = false;
     m_brushMode = false;
     setCursor(Qt::ArrowCursor);
 
-    // Recreate ground
-    if (m_groundBody) {
-        m_world->DestroyBody(m_groundBody);
+    update();
+}
+void Realtime::saveSnapshot() {
+    QDir().mkpath("snapshots");
+    if (m_simulation->saveSnapshot(snapshotPath)) {
+        std::cout << "Saved snapshot to " << snapshotPath << std::endl;
     }
-    b2BodyDef groundDef;
-    groundDef.position.Set(0.0f, -m_worldHeight / 2.0f - 1.0f);
-    m_groundBody = m_world->CreateBody(&groundDef);
-
-    b2PolygonShape groundBox;
-    groundBox.SetAsBox(m_worldWidth, 1.0f);
-    m_groundBody->CreateFixture(&groundBox, 0.0f);
-
+}
+void Realtime::loadSnapshot() {
+    // The objects are replaced, so their GL buffers go too
+    releaseObjectGeometry();
+    if (!m_simulation->loadSnapshot(snapshotPath)) {
+        return;
+    }
+    // Keep mapping clicks with the current view
+    m_simulation->setWorldSize(m_worldWidth, m_worldHeight);
+    // A stroke saved mid-drag has no mouse button left to finish it
+    if (m_simulation->isDrawingStroke()) {
+        m_simulation->endStroke();
+    }
+    std::cout << "Loaded snapshot " << snapshotPath << std::endl;
     update();
 }
 void Realtime::keyReleaseEvent(QKeyEvent *event) {
@@ -574,58 +575,32 @@ void Realtime::mousePressEvent(QMouseEvent *event) {
 
         if (settings.perPixelFilter) {
             // Set new gravity center
-            m_gravityCenter = glm::vec2(worldX, worldY);
-            m_hasGravityCenter = true;
+            m_simulation->setGravityCenter(worldX, worldY);
             m_selectingGravityCenter = false;
         }if (m_brushMode) {
             float x = ((float)event->pos().x() / width() - 0.5f) * m_worldWidth;
             float y = (0.5f - (float)event->pos().y() / height()) * m_worldHeight;
 
             // Start new stroke
-            m_currentStroke.clear();
-            m_currentStroke.push_back(b2Vec2(x, y));
+            m_simulation->beginStroke(x, y);
             m_mouseDown = true;
-
-            // Create static body for the brush stroke
-            b2BodyDef bodyDef;
-            bodyDef.type = b2_staticBody;
-            m_currentBrush = m_world->CreateBody(&bodyDef);
         }
 
         else if (settings.extraCredit2) {
-            m_explosionCenter = glm::vec2(worldX, worldY);
-            m_explosionMode = true;
+            m_simulation->explode(worldX, worldY);
             m_selectingExplosionCenter = false;
-            m_hasGravityCenter = false;
         }
 
         else if (m_selectingOrbitCenter) {
-            m_orbitCenter = glm::vec2(0.f);
-            m_orbitMode = true;
+            m_simulation->startOrbit();
             m_selectingOrbitCenter = false;
-            m_hasGravityCenter = false;
-            if (m_groundBody) {
-                m_world->DestroyBody(m_groundBody);
-                m_groundBody = nullptr;
-                std::cout << "Ground body destroyed for orbit mode." << std::endl;
-            }
         }else if (m_currentShape == ObjectShape::WATER) {
-            makeCurrent();
-            // Define a box of particles at clicked position
-            b2PolygonShape particleBox;
-            float halfSize = 0.5f;
-            particleBox.SetAsBox(halfSize, halfSize, b2Vec2(worldX, worldY), 0);
-
-            b2ParticleGroupDef groupDef;
-            groupDef.shape = &particleBox;
-            groupDef.flags = b2_waterParticle; // Water-like particles
-            groupDef.color.Set(0, 0, 155, 255); // Blue color (only if rendering particle color)
-            m_particleSystem->CreateParticleGroup(groupDef);
+            m_simulation->createWater(worldX, worldY);
         }
         
         else {
             // Create a new physics object
-            createPhysicsObject(worldX, worldY);
+            m_simulation->createObject(worldX, worldY, m_currentShape, m_currentSize, m_currentColor);
         }
     }
 }
@@ -634,239 +609,148 @@ void Realtime::mouseReleaseEvent(QMouseEvent *event) {
     if (!m_brushMode) return;
 
     // Save completed stroke
-    if (!m_currentStroke.empty()) {
-        m_allBrushStrokes.push_back(m_currentStroke);
-    }
-    m_currentBrush = nullptr;
+    m_simulation->endStroke();
     m_mouseDown = false;
 
 }
 
 void Realtime::timerEvent(QTimerEvent *event) {
-    float timeStep = 1.0f / 60.0f;
-    int32 velocityIterations = 6;
-    int32 positionIterations = 2;
-
-    m_world->Step(timeStep, velocityIterations, positionIterations);
-
-    if (m_hasGravityCenter) {
-        // Apply radial gravity toward m_gravityCenter
-        for (auto &obj : m_objects) {
-            b2Body* body = obj.body;
-            if (body->GetType() == b2_dynamicBody) {
-                b2Vec2 bodyPos = body->GetPosition();
-                glm::vec2 dir = glm::vec2(m_gravityCenter.x - bodyPos.x, m_gravityCenter.y - bodyPos.y);
-                float distSq = dir.x * dir.x + dir.y * dir.y;
-                if (distSq > 0.0001f) {
-                    float dist = sqrt(distSq);
-                    // Normalized direction
-                    glm::vec2 norm = dir / dist;
-
-                    float mass = body->GetMass();
-                    glm::vec2 force = norm * (m_gravityStrength * mass);
-
-                    body->ApplyForceToCenter(b2Vec2(force.x *2, force.y*2), true);
-                }
-            }
-        }
-    }
-
-    if (m_explosionMode) {
-        // Apply outward force from the click position
-        // glm::vec2 explosionCenter(worldX, worldY);
-        float explosionStrength = m_explosionStrength; // Adjust the strength of the explosion
-
-        for (auto &obj : m_objects) {
-            b2Body* body = obj.body;
-            if (body->GetType() == b2_dynamicBody) {
-                b2Vec2 bodyPos = body->GetPosition();
-                glm::vec2 direction = glm::vec2(bodyPos.x - m_explosionCenter.x, bodyPos.y - m_explosionCenter.y);
-
-                float distanceSq = direction.x * direction.x + direction.y * direction.y;
-
-                // Avoid division by zero and apply force only within a certain range
-                if (distanceSq > 0.0001f && distanceSq < 10.0f) {
-                    float distance = sqrt(distanceSq);
-                    glm::vec2 normalizedDirection = direction / distance;
-
-                    // Scale force by explosion strength and inverse distance
-                    glm::vec2 force = normalizedDirection * (explosionStrength / distance);
-
-                    body->ApplyForceToCenter(b2Vec2(force.x, force.y), true);
-                }
-            }
-        }
-        m_explosionMode = false;
+    // The constructor's timer can fire before the GL context exists
+    if (!m_simulation) {
+        return;
     }
-
-        if (m_orbitMode) {
-            for (auto &obj : m_objects) {
-                b2Body* body = obj.body;
-                if (body->GetType() == b2_dynamicBody) {
-                    b2Vec2 bodyPos = body->GetPosition();
-                    glm::vec2 pos(bodyPos.x, bodyPos.y);
-                    glm::vec2 diff = pos - m_orbitCenter;
-                    float dist = glm::length(diff);
-
-                    if (dist < 0.0001f) {
-                        continue;
-                    }
-
-                    glm::vec2 radialDir = diff / dist;
-                    glm::vec2 tangentialDir(-radialDir.y, radialDir.x);
-
-                    float angularSpeed = obj.orbitAngularSpeed;
-                    float desiredSpeed = (0.8+settings.shapeParameter2/5)*angularSpeed * dist; // v = ω * r
-
-                    b2Vec2 bVel = body->GetLinearVelocity();
-                    glm::vec2 vel(bVel.x, bVel.y);
-
-                    float tangentialComponent = glm::dot(vel, tangentialDir);
-                    float speedError = desiredSpeed - tangentialComponent;
-
-                    float tangentForceGain = 10.0f;
-                    glm::vec2 tangentForce = tangentialDir * speedError * tangentForceGain * body->GetMass();
-                    body->ApplyForceToCenter(b2Vec2(tangentForce.x, tangentForce.y), true);
-
-                    float centripetalForceMagnitude = (desiredSpeed * desiredSpeed / dist) * body->GetMass();
-                    glm::vec2 centripetalForce = -radialDir * centripetalForceMagnitude;
-                    body->ApplyForceToCenter(b2Vec2(centripetalForce.x, centripetalForce.y), true);
-                }
-            }
-        }
-
-
+    m_simulation->step();
 
     update(); // request a repaint
 }
 
 void Realtime::mouseMoveEvent(QMouseEvent *event) {
-    if (!m_brushMode || !m_currentBrush || !m_mouseDown) return;
+    if (!m_brushMode || !m_simulation->isDrawingStroke() || !m_mouseDown) return;
 
     float x = ((float)event->pos().x() / width() - 0.5f) * m_worldWidth;
     float y = (0.5f - (float)event->pos().y() / height()) * m_worldHeight;
 
-    b2Vec2 newPoint(x, y);
-    if (!m_currentStroke.empty()) {
-        b2Vec2 lastPoint = m_currentStroke.back();
-        float dist = b2Distance(newPoint, lastPoint);
-        if (dist < m_brushThickness) return;
-    }
-
-    m_currentStroke.push_back(newPoint);
-
-    // Create edge shape between last two points
-    if (m_currentStroke.size() >= 2 ) {
-        size_t last = m_currentStroke.size() - 1;
-
-        b2EdgeShape edge;
-        edge.Set(m_currentStroke[last-1], m_currentStroke[last]);
-
-        b2FixtureDef fixtureDef;
-        fixtureDef.shape = &edge;
-        fixtureDef.density = 0.0f;  // Static body
-        fixtureDef.friction = 0.3f;
-
-        m_currentBrush->CreateFixture(&fixtureDef);
-    }
+    m_simulation->extendStroke(x, y);
 
     update();
 }
 
 
-// DO NOT EDIT
 void Realtime::saveViewportImage(std::string filePath) {
     // Make sure we have the right context and everything has been drawn
     makeCurrent();
 
-    int fixedWidth = 1024;
-    int fixedHeight = 768;
-
-    // Create Frame Buffer
-    GLuint fbo;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    // Create a color attachment texture
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, fixedWidth, fixedHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
-
-    // Optional: Create a depth buffer if your rendering uses depth testing
-    GLuint rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, fixedWidth, fixedHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Error: Framebuffer is not complete!" << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // The capture target is created once and reused for every screenshot
+    if (!m_frameCapture.isInitialized() &&
+        !m_frameCapture.initialize(captureWidth, captureHeight)) {
         return;
     }
 
-    // Render to the FBO
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(0, 0, fixedWidth, fixedHeight);
+    // Queue the readback; the next paintGL() picks it up once the GPU is done
+    // and the PNG is written on the capture's encoder thread. If the ring is
+    // full the screenshot waits for a later frame rather than being lost.
+    if (!m_pendingScreenshots.empty() || !captureScreenshot(filePath)) {
+        m_pendingScreenshots.push_back(filePath);
+    }
+    update();
+}
 
-    // Clear and render your scene here
+bool Realtime::captureScreenshot(const std::string &filePath) {
+    m_capturingScreenshot = true;
+    m_frameCapture.beginFrame();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     paintGL();
+    bool queued = m_frameCapture.endFrame(filePath);
+    m_capturingScreenshot = false;
+    return queued;
+}
 
-    // Read pixels from framebuffer
-    std::vector<unsigned char> pixels(fixedWidth * fixedHeight * 3);
-    glReadPixels(0, 0, fixedWidth, fixedHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
-
-    // Unbind the framebuffer to return to default rendering to the screen
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void Realtime::toggleRecording(FrameRecorder::Format format) {
+    makeCurrent();
 
-    // Convert to QImage
-    QImage image(pixels.data(), fixedWidth, fixedHeight, QImage::Format_RGB888);
-    QImage flippedImage = image.mirrored(); // Flip the image vertically
+    if (m_recorder.isRecording()) {
+        // Frames still being read back belong to this recording
+        m_frameCapture.flush();
+        m_recorder.stop();
+        return;
+    }
 
-    // Save to file using Qt
-    QString qFilePath = QString::fromStdString(filePath);
-    if (!flippedImage.save(qFilePath)) {
-        std::cerr << "Failed to save image to " << filePath << std::endl;
+    if (!m_frameCapture.isInitialized() &&
+        !m_frameCapture.initialize(captureWidth, captureHeight)) {
+        return;
     }
 
-    // Clean up
-    glDeleteTextures(1, &texture);
-    glDeleteRenderbuffers(1, &rbo);
-    glDeleteFramebuffers(1, &fbo);
+    QDir().mkpath("recordings");
+    std::string path = "recordings/" +
+                       QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss").toStdString();
+    if (format == FrameRecorder::Format::Y4M) {
+        path += ".y4m";
+    }
+    if (m_recorder.start(path, format, captureWidth, captureHeight)) {
+        std::cout << "Recording to " << path << std::endl;
+    }
 }
 
 
 
 
 
+void Realtime::initializeShapes() {
+    // Every level is generated up front, so changing levels while drawing
+    // never uploads. Only the first scene generates anything.
+    m_levelOfDetail.initialize(m_shapeCache);
+    m_shapeCache.upload();
+    m_renderQueue.setMaterials(m_renderData.materials, m_renderData.globalData);
+    m_shapeBvh.build(m_renderData.shapes);
+    std::cout << "Scene: " << m_renderData.shapes.size() << " shapes, "
+              << m_renderData.materials.size() << " materials" << std::endl;
+}
+
+void Realtime::paintScene() {
+    if (m_renderData.shapes.empty()) {
+        return;
+    }
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // Only the shapes in the frustum get a level and reach the queue
+    m_shapeBvh.cull(m_renderData.shapes, m_camera);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    m_levelOfDetail.update(m_renderData.shapes, m_camera, viewport[3]);
+
+    glUseProgram(m_phong_shader);
+    glUniformMatrix4fv(glGetUniformLocation(m_phong_shader, "view"), 1, GL_FALSE,
+                       glm::value_ptr(m_camera.viewMatrix));
+    glUniformMatrix4fv(glGetUniformLocation(m_phong_shader, "proj"), 1, GL_FALSE,
+                       glm::value_ptr(m_camera.projectionMatrix));
+    glUniform3fv(glGetUniformLocation(m_phong_shader, "cameraPos"), 1,
+                 glm::value_ptr(m_camera.position));
+
+    m_lightClusters.update(m_camera, viewport);
+    m_lightClusters.bind(m_phong_shader);
+
+    // One instanced draw per mesh in use
+    m_renderQueue.update(m_renderData.shapes);
+    glBindVertexArray(m_shapeCache.vertexArray());
+    m_renderQueue.draw();
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    glDisable(GL_DEPTH_TEST);
+}
+
 void Realtime::clearScene() {
     // Ensure the OpenGL context is current
     makeCurrent();
 
-    // Delete VAOs, VBOs, and EBOs associated with the shapes
-    for (auto& shapeData : m_renderData.shapes) {
-        if (shapeData.VAO) {
-            glDeleteVertexArrays(1, &shapeData.VAO);
-            shapeData.VAO = 0;
-        }
-        if (shapeData.VBO) {
-            glDeleteBuffers(1, &shapeData.VBO);
-            shapeData.VBO = 0;
-        }
-        if (shapeData.EBO) {
-            glDeleteBuffers(1, &shapeData.EBO);
-            shapeData.EBO = 0;
-        }
-    }
-
-    // Clear the shapes vector
+    // The geometry stays in m_shapeCache for the next scene
     m_renderData.shapes.clear();
 
     // Clear lights and other scene data if necessary
     m_renderData.lights.clear();
+    m_renderData.materials.clear();
+    m_lightClusters.setLights(m_renderData.lights);
 
     // If you have textures or other resources, delete them here
 
@@ -874,137 +758,21 @@ void Realtime::clearScene() {
 }
 
 void Realtime::resetGravityCenter() {
-    m_gravityCenter = glm::vec2(0.0f);
-    m_hasGravityCenter = false;
     m_selectingGravityCenter = false;
-    m_orbitMode = false;
     m_selectingOrbitCenter = false;
-    m_world->SetGravity(b2Vec2(0.0f, -9.8f));
+    m_simulation->resetGravityCenter();
 
-    if (!m_groundBody) {
-        b2BodyDef groundDef;
-        groundDef.position.Set(0.0f, -m_worldHeight / 2.0f - 1.0f);
-        m_groundBody = m_world->CreateBody(&groundDef);
-
-        b2PolygonShape groundBox;
-        groundBox.SetAsBox(m_worldWidth, 1.0f);
-        m_groundBody->CreateFixture(&groundBox, 0.0f);
-    }
-    
     std::cout << "Gravity center reset." << std::endl;
 
     update();
 }
 
 void Realtime::initializeSolarSystem() {
-    // Clear and destroy existing objects
-    for (auto &obj : m_objects) {
-        m_world->DestroyBody(obj.body);
-    }
-    m_objects.clear();
-
-    if (m_groundBody) {
-        m_world->DestroyBody(m_groundBody);
-        m_groundBody = nullptr;
-    }
-
-    // Set gravity to zero and enable orbit mode
-    m_world->SetGravity(b2Vec2(0.0f, 0.0f));
-    m_orbitCenter = glm::vec2(0.0f, 0.0f);
-    m_orbitMode = true;
-
-    // Create the sun
-    {
-        b2BodyDef sunDef;
-        sunDef.type = b2_staticBody;
-        sunDef.position.Set(0.0f, 0.0f);
-        b2Body* sunBody = m_world->CreateBody(&sunDef);
-
-        b2CircleShape sunShape;
-        sunShape.m_radius = 0.25f;
-        b2FixtureDef fixtureDef;
-        fixtureDef.shape = &sunShape;
-        fixtureDef.density = 0.0f;
-        fixtureDef.friction = 0.0f;
-        sunBody->CreateFixture(&fixtureDef);
-
-        PhysObject sunObj;
-        sunObj.body = sunBody;
-        sunObj.shape = ObjectShape::CIRCLE;
-        sunObj.color = glm::vec3(1.0f, 1.0f, 0.0f);
-        float halfSize = 0.25f;
-
-        const int NUM_SEGMENTS = 24;
-        std::vector<GLfloat> circleVerts;
-        circleVerts.push_back(0.0f);
-        circleVerts.push_back(0.0f);
-        for (int i = 0; i <= NUM_SEGMENTS; i++) {
-            float angle = (float)i / (float)NUM_SEGMENTS * 2.0f * M_PI;
-            float xPos = halfSize * cos(angle);
-            float yPos = halfSize * sin(angle);
-            circleVerts.push_back(xPos);
-            circleVerts.push_back(yPos);
-        }
-
-        glGenVertexArrays(1, &sunObj.VAO);
-        glBindVertexArray(sunObj.VAO);
-
-        glGenBuffers(1, &sunObj.VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, sunObj.VBO);
-        glBufferData(GL_ARRAY_BUFFER, circleVerts.size() * sizeof(GLfloat), circleVerts.data(), GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-        glEnableVertexAttribArray(0);
-
-        glBindVertexArray(0);
-        sunObj.isCircle = true;
-        sunObj.size = glm::vec2(halfSize);
-
-        QString sunTexturePath = ":/resources/planetText/test.png";
-        GLuint sunTexID = loadTexture(sunTexturePath);
-        if (sunTexID != 0) {
-            sunObj.textureID = sunTexID;
-            sunObj.hasTexture = true;
-        } else {
-            sunObj.hasTexture = false;
-        }
-
-        m_objects.push_back(sunObj);
-    }
-
-    // Assign realistic(ish) angular speeds (in rad/s) to planets:
-    // Example using 1 simulated year = 60 seconds scaling:
-    // Mercury, Venus, Earth, Mars, Jupiter, Saturn, Uranus
-    std::vector<float> angularSpeeds = {
-        0.4345f,  // Mercury
-        0.1700f,  // Venus
-        0.1047f,  // Earth
-        0.0557f,  // Mars
-        0.00883f, // Jupiter
-        0.00355f, // Saturn
-        0.001247f // Uranus
-    };
+    releaseObjectGeometry();
+    m_simulation->initializeSolarSystem();
 
     m_currentShape = ObjectShape::CIRCLE;
     m_currentSize = 0.1f;
-    float baseRadius = 1.5f;
-    for (int i = 0; i < 7; i++) {
-        float radius = baseRadius + i * 0.5f;
-        createPhysicsObject(radius, 0.0f);
-        if (!m_objects.empty()) {
-            float hue = (float)i / 7.0f;
-            m_objects.back().color = glm::vec3(hue, 0.5f, 1.0f - hue);
-            m_objects.back().orbitAngularSpeed = angularSpeeds[i];
-
-            GLuint texID = loadTexture(texturePaths[i]);
-            if (texID != 0) {
-                m_objects.back().textureID = texID;
-                m_objects.back().hasTexture = true;
-            } else {
-                m_objects.back().hasTexture = false;
-            }
-        }
-    }
 }
 
 
@@ -1028,7 +796,7 @@ void Realtime::renderBrushStrokes() {
     glLineWidth(10.f);  // Make lines thicker and visible
 
     // Render all completed strokes
-    for (const auto& stroke : m_allBrushStrokes) {
+    for (const auto& stroke : m_simulation->brushStrokes()) {
         if (stroke.size() >= 2) {
             std::vector<float> vertices;
             for (const auto& point : stroke) {
@@ -1056,9 +824,10 @@ void Realtime::renderBrushStrokes() {
     }
 
     // Render current stroke if it exists
-    if (m_currentStroke.size() >= 2) {
+    const std::vector<b2Vec2> &currentStroke = m_simulation->currentStroke();
+    if (currentStroke.size() >= 2) {
         std::vector<float> vertices;
-        for (const auto& point : m_currentStroke) {
+        for (const auto& point : currentStroke) {
             vertices.push_back(point.x);
             vertices.push_back(point.y);
         }
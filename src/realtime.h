@@ -13,30 +13,20 @@
 #include <QTimer>
 #include "camera.h"
 #include "utils/sceneparser.h"
-
-#include <Box2D/Box2D.h>
-#include <Box2D/Particle/b2ParticleSystem.h>
-
-// A structure for physical objects integrated with OpenGL rendering
-enum class ObjectShape {
-    BOX,
-    CIRCLE,
-    WATER
-    // ... other shapes if any
-};
-struct PhysObject {
-    b2Body* body;
-    GLuint VAO;
-    GLuint VBO;
-    glm::vec2 size;  // half-size for box, radius for circle
-    bool isCircle;
-    glm::vec3 color; // Store the object color here
-    ObjectShape shape;
-    bool canBecomeStatic = false;
-    float orbitAngularSpeed = 0.0f;
-    GLuint textureID = 0;
-    bool hasTexture = false;
-};
+#include "utils/texturecache.h"
+#include "utils/framecapture.h"
+#include "utils/framerecorder.h"
+#include "utils/fluidrenderer.h"
+#include "utils/postprocessor.h"
+#include "utils/programcache.h"
+#include "utils/shapecache.h"
+#include "utils/levelofdetail.h"
+#include "utils/renderqueue.h"
+#include "utils/shapebvh.h"
+#include "utils/lightclusters.h"
+#include "simulation.h"
+#include <deque>
+#include <memory>
 
 class Realtime : public QOpenGLWidget {
     Q_OBJECT
@@ -52,19 +42,6 @@ public:
         glm::vec3 color;
     };
 
-    struct Light {
-        int type;          // 0 = Directional, 1 = Point, 2 = Spotlight
-        glm::vec3 position;
-        glm::vec3 direction;
-        glm::vec3 color;
-        float angle;       // Spotlight cutoff angle (degrees)
-        float penumbra;    // Spotlight penumbra angle (degrees)
-        glm::vec3 attenuation; // Attenuation (k_c, k_l, k_q)
-    };
-
-    const int MAX_LIGHTS = 8;
-    std::vector<Light> lights;
-
     Realtime(QWidget *parent = nullptr);
     void finish();                       // Called on program exit
     void sceneChanged();
@@ -87,7 +64,10 @@ protected:
 
 private:
     // Methods related to scene and rendering
+    // Create the meshes the scene's shapes can be drawn with
     void initializeShapes();
+    // Draw the loaded scene, if any, with depth testing
+    void paintScene();
     glm::mat4 computeModelMatrix(const std::vector<SceneTransformation>& transformations);
     void clearScene();
     void rotateAroundWorldUp(float angle);
@@ -101,7 +81,6 @@ private:
 
     // Physics-related methods
     void stepPhysics(float dt);
-    void createPhysicsObject(float x, float y);
 
     // Member variables
     glm::mat4 m_model = glm::mat4(1.f);
@@ -119,6 +98,11 @@ private:
 
     Camera m_camera;
     RenderData m_renderData;
+    ShapeCache m_shapeCache;
+    LevelOfDetail m_levelOfDetail;
+    RenderQueue m_renderQueue;
+    ShapeBvh m_shapeBvh;
+    LightClusters m_lightClusters;
     GLuint m_shaderProgram;
     GLuint m_shaderProgram2D;
     GLuint m_phong_shader;
@@ -138,13 +122,31 @@ private:
     GLuint m_fbo_texture;
     GLuint m_fbo_renderbuffer;
 
-    int m_currentFilter = 0;
-
-    // Box2D physics world and objects
-    b2World* m_world = nullptr;
+    // F cycles the full-screen filter, H toggles running it at half
+    // resolution
+    PostProcessor m_postProcessor;
+    PostProcessor::Filter m_currentFilter = PostProcessor::Filter::None;
+
+    // Offscreen target and asynchronous readback for saveViewportImage and
+    // recordings
+    FrameCapture m_frameCapture;
+    FrameRecorder m_recorder;
+    void toggleRecording(FrameRecorder::Format format);
+    // Render a screenshot into the capture target and queue its readback.
+    // Returns false if every readback slot was busy.
+    bool captureScreenshot(const std::string &filePath);
+    // Screenshots that found the readback ring full, retried one per frame
+    std::deque<std::string> m_pendingScreenshots;
+    bool m_capturingScreenshot = false;
+
+    // Box2D physics world and objects. Inputs from the key and mouse
+    // handlers go through the simulation so sessions can be recorded.
+    std::unique_ptr<Simulation> m_simulation;
     float m_worldWidth;
     float m_worldHeight;
-    std::vector<PhysObject> m_objects;
+    // F5 checkpoints the session, F9 jumps back to the checkpoint
+    void saveSnapshot();
+    void loadSnapshot();
 
     void setup2DProjection(int w, int h);
 
@@ -155,49 +157,35 @@ private:
     GLuint m_testVBO = 0;
 
 private:
-    b2Body* m_groundBody = nullptr;
     bool m_selectingGravityCenter = false;
     bool m_selectingExplosionCenter = false;
-    bool m_hasGravityCenter = false;
-    bool m_explosionMode = false;
-    int m_explosionStrength = 10;
-    glm::vec2 m_explosionCenter = glm::vec2(0.0f, 0.0f);
-    glm::vec2 m_gravityCenter = glm::vec2(0.0f, 0.0f);
-    float m_gravityStrength = 10.0f; // Adjust as needed
-
     bool m_selectingOrbitCenter = false;
-    bool m_orbitMode = false;
-    glm::vec2 m_orbitCenter = glm::vec2(0.0f);
-    float m_orbitRadius = 2.0f; // choose a radius you like
-    float m_orbitSpeed = 1.0f;  // angular velocity in rad/s
-    float m_radiusTolerance = 0.1f; // tolerance for deciding if at orbit radius
 
     void resetGravityCenter();
     void initializeSolarSystem();
+    void assignPlanetTexture(PhysObject &obj, const QString &path);
+    // Objects get their GL buffers when first drawn
+    void uploadObjectGeometry(PhysObject &obj);
+    void releaseObjectGeometry();
+
+    TextureCache m_textureCache;
 
-    b2ParticleSystem* m_particleSystem;
-    b2ParticleSystemDef m_particleSystemDef;
-    float m_particleRadius = 0.1f;
-    const float m_waterDensity = 1.0f;
     void renderWaterParticles();
     void createWaterParticles(float x, float y, int count = 20);
     void drawCircle(float radius);
 
 
-    // For rendering particles
-    GLuint m_particleVAO = 0;
-    GLuint m_particleVBO = 0;
-    bool m_particleVAOInitialized = false;
+    // Every shader program is built through the cache
+    ProgramCache m_programCache;
+
+    // Draws the particle water as a shaded surface
+    FluidRenderer m_fluidRenderer;
     std::vector<b2Vec2> m_drawPoints;
 
     bool m_brushMode = false;
-    b2Body* m_currentBrush = nullptr;
-    float m_brushThickness = 0.1f;
     void renderBrushStrokes();
     void resetWorld();
 
     bool m_justFinishStroke = false;
-    std::vector<b2Vec2> m_currentStroke;
-    std::vector<std::vector<b2Vec2>> m_allBrushStrokes;
 };
 
@@ -0,0 +1,761 @@
+#include "simulation.h"
+#include "utils/mappedfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+
+// Session snapshot layout: SnapshotHeader, one SnapshotObject per object,
+// the point count of every finished stroke followed by the one in progress,
+// all stroke points, then the b2WorldSnapshot at worldOffset. Bodies are
+// referred to by their position in the world body list, which a world
+// snapshot preserves.
+const char snapshotMagic[4] = {'S', 'I', 'M', 'S'};
+const uint32_t snapshotVersion = 1;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    float worldWidth, worldHeight;
+    uint32_t stepCount;
+    int32_t groundBody;   // -1 if there is no ground
+    int32_t currentBrush; // -1 unless a stroke is being drawn
+    uint8_t hasGravityCenter, explosionMode, orbitMode, padding;
+    float gravityCenter[2];
+    float explosionCenter[2];
+    float orbitCenter[2];
+    int32_t explosionStrength;
+    int32_t orbitSpeed;
+    uint32_t objectCount;
+    uint32_t strokeCount;
+    uint32_t strokePointCount;
+    uint32_t worldOffset;
+    uint32_t worldSize;
+};
+
+struct SnapshotObject {
+    int32_t body;
+    int32_t shape;
+    float size[2];
+    float color[3];
+    float orbitAngularSpeed;
+    int32_t planet;
+    uint8_t isCircle, canBecomeStatic, padding[2];
+};
+
+} // namespace
+
+Simulation::Simulation(float worldWidth, float worldHeight)
+    : m_worldWidth(worldWidth), m_worldHeight(worldHeight)
+{
+    // Create Box2D world with gravity
+    b2Vec2 gravity(0.0f, -9.8f);
+    m_world = new b2World(gravity);
+
+    createGround();
+
+    b2ParticleSystemDef particleSystemDef;
+    particleSystemDef.radius = 0.05f; // Adjust for desired density
+    particleSystemDef.dampingStrength = 0.2f;
+    m_particleSystem = m_world->CreateParticleSystem(&particleSystemDef);
+    m_particleSystem->SetGravityScale(1.0f);
+    m_particleSystem->SetMaxParticleCount(5000); // Limit particle count
+}
+
+Simulation::~Simulation() {
+    stopRecording();
+    delete m_world;
+}
+
+void Simulation::createGround() {
+    b2BodyDef groundDef;
+    groundDef.position.Set(0.0f, -m_worldHeight / 2.0f - 1.0f);
+    m_groundBody = m_world->CreateBody(&groundDef);
+
+    b2PolygonShape groundBox;
+    groundBox.SetAsBox(m_worldWidth, 1.0f);
+    m_groundBody->CreateFixture(&groundBox, 0.0f);
+}
+
+void Simulation::record(InputEvent::Type type, std::initializer_list<float> args, int32_t value) {
+    if (!m_log.isOpen()) {
+        return;
+    }
+    InputEvent event;
+    event.type = type;
+    event.step = m_stepCount;
+    event.value = value;
+    int i = 0;
+    for (float arg : args) {
+        event.args[i++] = arg;
+    }
+    m_log.append(event);
+}
+
+void Simulation::step() {
+    float timeStep = 1.0f / 60.0f;
+    int32 velocityIterations = 6;
+    int32 positionIterations = 2;
+
+    m_world->Step(timeStep, velocityIterations, positionIterations);
+    m_stepCount++;
+
+    // Forces of the active modes act on the next step
+    m_forceFields.clear();
+    if (m_hasGravityCenter) {
+        // Radial gravity toward m_gravityCenter
+        ForceField gravity;
+        gravity.type = ForceField::Type::Radial;
+        gravity.center = m_gravityCenter;
+        gravity.strength = m_gravityStrength * 2;
+        m_forceFields.add(gravity);
+    }
+    if (m_explosionMode) {
+        // One push outward from the click position, fading with distance
+        ForceField explosion;
+        explosion.type = ForceField::Type::Burst;
+        explosion.falloff = ForceField::Falloff::InverseDistance;
+        explosion.center = m_explosionCenter;
+        explosion.strength = float(m_explosionStrength);
+        explosion.radius = std::sqrt(10.0f);
+        m_forceFields.add(explosion);
+        m_explosionMode = false;
+    }
+    if (m_orbitMode) {
+        // Each object orbits at its own angular speed, v = w * r
+        ForceField orbit;
+        orbit.type = ForceField::Type::Vortex;
+        orbit.center = m_orbitCenter;
+        orbit.strength = float(0.8 + m_orbitSpeed / 5);
+        orbit.minDistance = 0.0001f;
+        m_forceFields.add(orbit);
+    }
+    m_forceFields.apply(m_objects, m_world, m_particleSystem, timeStep);
+}
+
+void Simulation::setWorldSize(float width, float height) {
+    if (width == m_worldWidth && height == m_worldHeight) {
+        return;
+    }
+    record(InputEvent::Type::SetWorldSize, {width, height});
+    m_worldWidth = width;
+    m_worldHeight = height;
+}
+
+PhysObject &Simulation::addObject(float x, float y, ObjectShape shape, float size,
+                                  const glm::vec3 &color) {
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_dynamicBody;
+    bodyDef.position.Set(x, y);
+    b2Body* body = m_world->CreateBody(&bodyDef);
+
+    PhysObject obj;
+    obj.body = body;
+    obj.shape = shape;
+    obj.color = color;
+    obj.isCircle = shape == ObjectShape::CIRCLE;
+    obj.size = glm::vec2(size);
+
+    b2PolygonShape dynamicBox;
+    b2CircleShape circle;
+    b2FixtureDef fixtureDef;
+    if (obj.isCircle) {
+        circle.m_radius = size;
+        fixtureDef.shape = &circle;
+    } else {
+        dynamicBox.SetAsBox(size, size);
+        fixtureDef.shape = &dynamicBox;
+    }
+    fixtureDef.density = 1.0f;
+    fixtureDef.friction = 0.3f;
+    body->CreateFixture(&fixtureDef);
+
+    m_objects.push_back(obj);
+    return m_objects.back();
+}
+
+void Simulation::createObject(float x, float y, ObjectShape shape, float size,
+                              const glm::vec3 &color) {
+    record(InputEvent::Type::CreateObject, {x, y, size, color.r, color.g, color.b}, int32_t(shape));
+    addObject(x, y, shape, size, color);
+}
+
+void Simulation::createWater(float x, float y) {
+    record(InputEvent::Type::CreateWater, {x, y});
+
+    // Define a box of particles at clicked position
+    b2PolygonShape particleBox;
+    float halfSize = 0.5f;
+    particleBox.SetAsBox(halfSize, halfSize, b2Vec2(x, y), 0);
+
+    b2ParticleGroupDef groupDef;
+    groupDef.shape = &particleBox;
+    groupDef.flags = b2_waterParticle; // Water-like particles
+    groupDef.color.Set(0, 0, 155, 255); // Blue color (only if rendering particle color)
+    m_particleSystem->CreateParticleGroup(groupDef);
+}
+
+void Simulation::setGravityCenter(float x, float y) {
+    record(InputEvent::Type::SetGravityCenter, {x, y});
+    m_gravityCenter = glm::vec2(x, y);
+    m_hasGravityCenter = true;
+}
+
+void Simulation::explode(float x, float y) {
+    record(InputEvent::Type::Explode, {x, y});
+    m_explosionCenter = glm::vec2(x, y);
+    m_explosionMode = true;
+    m_hasGravityCenter = false;
+}
+
+void Simulation::setGravity(float x, float y) {
+    record(InputEvent::Type::SetGravity, {x, y});
+    m_world->SetGravity(b2Vec2(x, y));
+}
+
+void Simulation::startOrbit() {
+    record(InputEvent::Type::StartOrbit);
+    m_orbitCenter = glm::vec2(0.f);
+    m_orbitMode = true;
+    m_hasGravityCenter = false;
+    if (m_groundBody) {
+        m_world->DestroyBody(m_groundBody);
+        m_groundBody = nullptr;
+        std::cout << "Ground body destroyed for orbit mode." << std::endl;
+    }
+}
+
+void Simulation::beginStroke(float x, float y) {
+    record(InputEvent::Type::BeginStroke, {x, y});
+
+    // Start new stroke
+    m_currentStroke.clear();
+    m_currentStroke.push_back(b2Vec2(x, y));
+
+    // Create static body for the brush stroke
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_staticBody;
+    m_currentBrush = m_world->CreateBody(&bodyDef);
+}
+
+void Simulation::extendStroke(float x, float y) {
+    if (!m_currentBrush) {
+        return;
+    }
+
+    b2Vec2 newPoint(x, y);
+    if (!m_currentStroke.empty()) {
+        b2Vec2 lastPoint = m_currentStroke.back();
+        float dist = b2Distance(newPoint, lastPoint);
+        if (dist < m_brushThickness) return;
+    }
+
+    // Points closer than the brush thickness never reach the world, so they
+    // are not logged either
+    record(InputEvent::Type::ExtendStroke, {x, y});
+    m_currentStroke.push_back(newPoint);
+
+    // Create edge shape between last two points
+    if (m_currentStroke.size() >= 2 ) {
+        size_t last = m_currentStroke.size() - 1;
+
+        b2EdgeShape edge;
+        edge.Set(m_currentStroke[last-1], m_currentStroke[last]);
+
+        b2FixtureDef fixtureDef;
+        fixtureDef.shape = &edge;
+        fixtureDef.density = 0.0f;  // Static body
+        fixtureDef.friction = 0.3f;
+
+        m_currentBrush->CreateFixture(&fixtureDef);
+    }
+}
+
+void Simulation::endStroke() {
+    record(InputEvent::Type::EndStroke);
+
+    // Save completed stroke
+    if (!m_currentStroke.empty()) {
+        m_allBrushStrokes.push_back(m_currentStroke);
+    }
+    m_currentBrush = nullptr;
+}
+
+void Simulation::resetGravityCenter() {
+    record(InputEvent::Type::ResetGravityCenter);
+
+    m_gravityCenter = glm::vec2(0.0f);
+    m_hasGravityCenter = false;
+    m_orbitMode = false;
+    m_world->SetGravity(b2Vec2(0.0f, -9.8f));
+
+    if (!m_groundBody) {
+        createGround();
+    }
+}
+
+void Simulation::initializeSolarSystem() {
+    record(InputEvent::Type::InitializeSolarSystem);
+
+    // Clear and destroy existing objects
+    for (auto &obj : m_objects) {
+        m_world->DestroyBody(obj.body);
+    }
+    m_objects.clear();
+
+    if (m_groundBody) {
+        m_world->DestroyBody(m_groundBody);
+        m_groundBody = nullptr;
+    }
+
+    // Set gravity to zero and enable orbit mode
+    m_world->SetGravity(b2Vec2(0.0f, 0.0f));
+    m_orbitCenter = glm::vec2(0.0f, 0.0f);
+    m_orbitMode = true;
+
+    // Create the sun
+    {
+        b2BodyDef sunDef;
+        sunDef.type = b2_staticBody;
+        sunDef.position.Set(0.0f, 0.0f);
+        b2Body* sunBody = m_world->CreateBody(&sunDef);
+
+        b2CircleShape sunShape;
+        sunShape.m_radius = 0.25f;
+        b2FixtureDef fixtureDef;
+        fixtureDef.shape = &sunShape;
+        fixtureDef.density = 0.0f;
+        fixtureDef.friction = 0.0f;
+        sunBody->CreateFixture(&fixtureDef);
+
+        PhysObject sunObj;
+        sunObj.body = sunBody;
+        sunObj.shape = ObjectShape::CIRCLE;
+        sunObj.color = glm::vec3(1.0f, 1.0f, 0.0f);
+        sunObj.isCircle = true;
+        sunObj.size = glm::vec2(0.25f);
+        sunObj.planet = 0;
+
+        m_objects.push_back(sunObj);
+    }
+
+    // Assign realistic(ish) angular speeds (in rad/s) to planets:
+    // Example using 1 simulated year = 60 seconds scaling:
+    // Mercury, Venus, Earth, Mars, Jupiter, Saturn, Uranus
+    std::vector<float> angularSpeeds = {
+        0.4345f,  // Mercury
+        0.1700f,  // Venus
+        0.1047f,  // Earth
+        0.0557f,  // Mars
+        0.00883f, // Jupiter
+        0.00355f, // Saturn
+        0.001247f // Uranus
+    };
+
+    float baseRadius = 1.5f;
+    for (int i = 0; i < 7; i++) {
+        float radius = baseRadius + i * 0.5f;
+        float hue = (float)i / 7.0f;
+        PhysObject &planet = addObject(radius, 0.0f, ObjectShape::CIRCLE, 0.1f,
+                                       glm::vec3(hue, 0.5f, 1.0f - hue));
+        planet.orbitAngularSpeed = angularSpeeds[i];
+        planet.planet = i + 1;
+    }
+}
+
+void Simulation::resetWorld() {
+    record(InputEvent::Type::ResetWorld);
+
+    // Delete all Box2D bodies and reset vectors
+    for (auto& obj : m_objects) {
+        m_world->DestroyBody(obj.body);
+    }
+    m_objects.clear();
+
+    // Clear all particles
+    if (m_particleSystem) {
+        m_particleSystem->DestroyParticle(0, false);
+    }
+
+    // Clear all brush strokes (both visual and physical)
+    m_allBrushStrokes.clear();
+    m_currentStroke.clear();
+
+    // Destroy all brush bodies
+    b2Body* body = m_world->GetBodyList();
+    while (body) {
+        b2Body* nextBody = body->GetNext(); // Get next before destroying current
+        if (body != m_groundBody) { // Don't destroy ground yet
+            m_world->DestroyBody(body);
+        }
+        body = nextBody;
+    }
+
+    // Reset current brush pointer
+    m_currentBrush = nullptr;
+
+    // Reset gravity and modes
+    m_world->SetGravity(b2Vec2(0.0f, -9.8f));
+    m_hasGravityCenter = false;
+    m_orbitMode = false;
+
+    // Recreate ground
+    if (m_groundBody) {
+        m_world->DestroyBody(m_groundBody);
+    }
+    createGround();
+}
+
+void Simulation::setExplosionStrength(int strength) {
+    if (strength == m_explosionStrength) {
+        return;
+    }
+    record(InputEvent::Type::SetExplosionStrength, {}, strength);
+    m_explosionStrength = strength;
+}
+
+void Simulation::setOrbitSpeed(int speed) {
+    if (speed == m_orbitSpeed) {
+        return;
+    }
+    record(InputEvent::Type::SetOrbitSpeed, {}, speed);
+    m_orbitSpeed = speed;
+}
+
+void Simulation::apply(const InputEvent &event) {
+    const float *a = event.args;
+    switch (event.type) {
+    case InputEvent::Type::SetWorldSize:
+        setWorldSize(a[0], a[1]);
+        break;
+    case InputEvent::Type::CreateObject:
+        createObject(a[0], a[1], ObjectShape(event.value), a[2], glm::vec3(a[3], a[4], a[5]));
+        break;
+    case InputEvent::Type::CreateWater:
+        createWater(a[0], a[1]);
+        break;
+    case InputEvent::Type::SetGravityCenter:
+        setGravityCenter(a[0], a[1]);
+        break;
+    case InputEvent::Type::Explode:
+        explode(a[0], a[1]);
+        break;
+    case InputEvent::Type::SetGravity:
+        setGravity(a[0], a[1]);
+        break;
+    case InputEvent::Type::StartOrbit:
+        startOrbit();
+        break;
+    case InputEvent::Type::BeginStroke:
+        beginStroke(a[0], a[1]);
+        break;
+    case InputEvent::Type::ExtendStroke:
+        extendStroke(a[0], a[1]);
+        break;
+    case InputEvent::Type::EndStroke:
+        endStroke();
+        break;
+    case InputEvent::Type::ResetGravityCenter:
+        resetGravityCenter();
+        break;
+    case InputEvent::Type::InitializeSolarSystem:
+        initializeSolarSystem();
+        break;
+    case InputEvent::Type::ResetWorld:
+        resetWorld();
+        break;
+    case InputEvent::Type::SetExplosionStrength:
+        setExplosionStrength(event.value);
+        break;
+    case InputEvent::Type::SetOrbitSpeed:
+        setOrbitSpeed(event.value);
+        break;
+    default:
+        break;
+    }
+}
+
+bool Simulation::startRecording(const std::string &path) {
+    if (m_stepCount != 0) {
+        std::cerr << "Input recording has to start before the first step" << std::endl;
+        return false;
+    }
+    if (!m_log.open(path, m_worldWidth, m_worldHeight)) {
+        return false;
+    }
+    // Settings applied before recording started are part of the initial state
+    record(InputEvent::Type::SetExplosionStrength, {}, m_explosionStrength);
+    record(InputEvent::Type::SetOrbitSpeed, {}, m_orbitSpeed);
+    return true;
+}
+
+void Simulation::stopRecording() {
+    m_log.close(m_stepCount);
+}
+
+bool Simulation::replay(const std::string &path, bool checkTriads) {
+    float worldWidth, worldHeight;
+    std::vector<InputEvent> events;
+    if (!InputLog::read(path, worldWidth, worldHeight, events)) {
+        return false;
+    }
+
+    Simulation simulation(worldWidth, worldHeight);
+    simulation.m_particleSystem->SetStrictTriadCheck(checkTriads);
+    uint32_t stepCount = events.back().step;
+    size_t nextEvent = 0;
+    double slowestStep = 0.0;
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    for (;;) {
+        // Inputs logged at step n happened after n steps had been taken
+        while (nextEvent < events.size() && events[nextEvent].step == simulation.m_stepCount) {
+            simulation.apply(events[nextEvent++]);
+        }
+        if (simulation.m_stepCount >= stepCount) {
+            break;
+        }
+        Clock::time_point stepStart = Clock::now();
+        simulation.step();
+        slowestStep = std::max(slowestStep,
+                               std::chrono::duration<double, std::milli>(Clock::now() - stepStart).count());
+    }
+    double total = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // Positions summed over the final state; identical runs print identical sums
+    double checksum = 0.0;
+    for (b2Body* body = simulation.m_world->GetBodyList(); body; body = body->GetNext()) {
+        checksum += body->GetPosition().x + body->GetPosition().y;
+    }
+    const b2Vec2* particles = simulation.m_particleSystem->GetPositionBuffer();
+    for (int32 i = 0; i < simulation.m_particleSystem->GetParticleCount(); i++) {
+        checksum += particles[i].x + particles[i].y;
+    }
+
+    std::cout << "Replayed " << stepCount << " steps and " << events.size() - 1
+              << " inputs in " << total << " ms ("
+              << (stepCount ? total / stepCount : 0.0) << " ms/step, slowest "
+              << slowestStep << " ms)" << std::endl;
+    std::cout << "Final state: " << simulation.m_world->GetBodyCount() << " bodies, "
+              << simulation.m_particleSystem->GetParticleCount() << " particles, checksum "
+              << std::setprecision(12) << checksum << std::endl;
+    if (checkTriads) {
+        int32 failures = simulation.m_particleSystem->GetTriadCheckFailureCount();
+        std::cout << "Triad check: " << failures
+                  << " incremental updates differed from a full re-triangulation" << std::endl;
+        return failures == 0;
+    }
+    return true;
+}
+
+bool Simulation::saveSnapshot(const std::string &path) const {
+    std::unordered_map<const b2Body*, int32_t> bodyIndices;
+    bodyIndices.reserve(m_world->GetBodyCount());
+    for (const b2Body* body = m_world->GetBodyList(); body; body = body->GetNext()) {
+        bodyIndices.emplace(body, int32_t(bodyIndices.size()));
+    }
+    auto bodyIndex = [&bodyIndices](const b2Body* body) {
+        auto it = bodyIndices.find(body);
+        return it == bodyIndices.end() ? -1 : it->second;
+    };
+
+    std::vector<uint32_t> strokeSizes;
+    std::vector<float> strokePoints;
+    auto addStroke = [&](const std::vector<b2Vec2> &stroke) {
+        strokeSizes.push_back(uint32_t(stroke.size()));
+        for (const b2Vec2 &point : stroke) {
+            strokePoints.push_back(point.x);
+            strokePoints.push_back(point.y);
+        }
+    };
+    for (const auto &stroke : m_allBrushStrokes) {
+        addStroke(stroke);
+    }
+    addStroke(m_currentStroke);
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = snapshotVersion;
+    header.worldWidth = m_worldWidth;
+    header.worldHeight = m_worldHeight;
+    header.stepCount = m_stepCount;
+    header.groundBody = bodyIndex(m_groundBody);
+    header.currentBrush = bodyIndex(m_currentBrush);
+    header.hasGravityCenter = m_hasGravityCenter;
+    header.explosionMode = m_explosionMode;
+    header.orbitMode = m_orbitMode;
+    header.gravityCenter[0] = m_gravityCenter.x;
+    header.gravityCenter[1] = m_gravityCenter.y;
+    header.explosionCenter[0] = m_explosionCenter.x;
+    header.explosionCenter[1] = m_explosionCenter.y;
+    header.orbitCenter[0] = m_orbitCenter.x;
+    header.orbitCenter[1] = m_orbitCenter.y;
+    header.explosionStrength = m_explosionStrength;
+    header.orbitSpeed = m_orbitSpeed;
+    header.objectCount = uint32_t(m_objects.size());
+    header.strokeCount = uint32_t(m_allBrushStrokes.size());
+    header.strokePointCount = uint32_t(strokePoints.size() / 2);
+
+    size_t sessionSize = sizeof(SnapshotHeader) + m_objects.size() * sizeof(SnapshotObject) +
+                         strokeSizes.size() * sizeof(uint32_t) + strokePoints.size() * sizeof(float);
+    // The world snapshot is read in place, so it starts 8 byte aligned
+    header.worldOffset = uint32_t((sessionSize + 7) & ~size_t(7));
+    header.worldSize = b2WorldSnapshot::GetSize(m_world);
+
+    std::vector<uint64_t> buffer((header.worldOffset + header.worldSize + 7) / 8, 0);
+    unsigned char *out = reinterpret_cast<unsigned char *>(buffer.data());
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    for (const PhysObject &obj : m_objects) {
+        SnapshotObject record = {};
+        record.body = bodyIndex(obj.body);
+        record.shape = int32_t(obj.shape);
+        record.size[0] = obj.size.x;
+        record.size[1] = obj.size.y;
+        record.color[0] = obj.color.r;
+        record.color[1] = obj.color.g;
+        record.color[2] = obj.color.b;
+        record.orbitAngularSpeed = obj.orbitAngularSpeed;
+        record.planet = obj.planet;
+        record.isCircle = obj.isCircle;
+        record.canBecomeStatic = obj.canBecomeStatic;
+        std::memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+    }
+    std::memcpy(out, strokeSizes.data(), strokeSizes.size() * sizeof(uint32_t));
+    out += strokeSizes.size() * sizeof(uint32_t);
+    std::memcpy(out, strokePoints.data(), strokePoints.size() * sizeof(float));
+
+    unsigned char *world = reinterpret_cast<unsigned char *>(buffer.data()) + header.worldOffset;
+    if (b2WorldSnapshot::Save(m_world, world, header.worldSize) == 0) {
+        std::cerr << "Failed to snapshot the world" << std::endl;
+        return false;
+    }
+
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to open snapshot " << path << std::endl;
+        return false;
+    }
+    size_t size = header.worldOffset + header.worldSize;
+    bool written = std::fwrite(buffer.data(), 1, size, file) == size;
+    written = std::fclose(file) == 0 && written;
+    if (!written) {
+        std::cerr << "Failed to write snapshot " << path << std::endl;
+    }
+    return written;
+}
+
+bool Simulation::loadSnapshot(const std::string &path) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    const unsigned char *data = file.data();
+    SnapshotHeader header;
+    bool valid = file.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, data, sizeof(header));
+        size_t objectsEnd = sizeof(header) + size_t(header.objectCount) * sizeof(SnapshotObject);
+        size_t strokesEnd = objectsEnd + (size_t(header.strokeCount) + 1) * sizeof(uint32_t) +
+                            size_t(header.strokePointCount) * 2 * sizeof(float);
+        valid = std::memcmp(header.magic, snapshotMagic, sizeof(header.magic)) == 0 &&
+                header.version == snapshotVersion &&
+                header.objectCount <= file.size() && header.strokeCount <= file.size() &&
+                header.strokePointCount <= file.size() &&
+                strokesEnd <= header.worldOffset && header.worldOffset % 8 == 0 &&
+                size_t(header.worldOffset) + header.worldSize <= file.size();
+    }
+    if (!valid) {
+        std::cerr << "Not a supported snapshot: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<SnapshotObject> objects(header.objectCount);
+    std::memcpy(objects.data(), data + sizeof(header), objects.size() * sizeof(SnapshotObject));
+    std::vector<uint32_t> strokeSizes(header.strokeCount + 1);
+    const unsigned char *strokeData = data + sizeof(header) + objects.size() * sizeof(SnapshotObject);
+    std::memcpy(strokeSizes.data(), strokeData, strokeSizes.size() * sizeof(uint32_t));
+    uint64_t strokePointTotal = 0;
+    for (uint32_t size : strokeSizes) {
+        strokePointTotal += size;
+    }
+    if (strokePointTotal != header.strokePointCount) {
+        std::cerr << "Not a supported snapshot: " << path << std::endl;
+        return false;
+    }
+
+    if (!b2WorldSnapshot::Restore(m_world, data + header.worldOffset, header.worldSize)) {
+        std::cerr << "Corrupt world snapshot: " << path << std::endl;
+        return false;
+    }
+
+    if (isRecording()) {
+        std::cout << "Input recording stopped: the log cannot replay a loaded snapshot" << std::endl;
+        stopRecording();
+    }
+
+    std::vector<b2Body*> bodies;
+    for (b2Body* body = m_world->GetBodyList(); body; body = body->GetNext()) {
+        bodies.push_back(body);
+    }
+    auto bodyAt = [&bodies](int32_t index) {
+        return index >= 0 && size_t(index) < bodies.size() ? bodies[index] : nullptr;
+    };
+
+    m_particleSystem = m_world->GetParticleSystemList();
+    m_worldWidth = header.worldWidth;
+    m_worldHeight = header.worldHeight;
+    m_stepCount = header.stepCount;
+    m_groundBody = bodyAt(header.groundBody);
+    m_currentBrush = bodyAt(header.currentBrush);
+    m_hasGravityCenter = header.hasGravityCenter;
+    m_explosionMode = header.explosionMode;
+    m_orbitMode = header.orbitMode;
+    m_gravityCenter = glm::vec2(header.gravityCenter[0], header.gravityCenter[1]);
+    m_explosionCenter = glm::vec2(header.explosionCenter[0], header.explosionCenter[1]);
+    m_orbitCenter = glm::vec2(header.orbitCenter[0], header.orbitCenter[1]);
+    m_explosionStrength = header.explosionStrength;
+    m_orbitSpeed = header.orbitSpeed;
+
+    m_objects.clear();
+    for (const SnapshotObject &record : objects) {
+        b2Body* body = bodyAt(record.body);
+        if (!body) {
+            continue;
+        }
+        PhysObject obj;
+        obj.body = body;
+        obj.shape = ObjectShape(record.shape);
+        obj.size = glm::vec2(record.size[0], record.size[1]);
+        obj.color = glm::vec3(record.color[0], record.color[1], record.color[2]);
+        obj.orbitAngularSpeed = record.orbitAngularSpeed;
+        obj.planet = record.planet;
+        obj.isCircle = record.isCircle;
+        obj.canBecomeStatic = record.canBecomeStatic;
+        m_objects.push_back(obj);
+    }
+
+    const float *points = reinterpret_cast<const float *>(strokeData + strokeSizes.size() * sizeof(uint32_t));
+    m_allBrushStrokes.clear();
+    for (size_t i = 0; i < strokeSizes.size(); i++) {
+        std::vector<b2Vec2> stroke;
+        for (uint32_t k = 0; k < strokeSizes[i]; k++, points += 2) {
+            stroke.push_back(b2Vec2(points[0], points[1]));
+        }
+        if (i < header.strokeCount) {
+            m_allBrushStrokes.push_back(std::move(stroke));
+        } else {
+            m_currentStroke = std::move(stroke);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "forcefield.h"
+#include "utils/inputlog.h"
+
+#include <Box2D/Box2D.h>
+#include <Box2D/Particle/b2ParticleSystem.h>
+
+// A structure for physical objects integrated with OpenGL rendering
+enum class ObjectShape {
+    BOX,
+    CIRCLE,
+    WATER
+    // ... other shapes if any
+};
+struct PhysObject {
+    b2Body* body;
+    // GL buffers, created by the renderer the first time the object is drawn
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    glm::vec2 size;  // half-size for box, radius for circle
+    bool isCircle;
+    glm::vec3 color; // Store the object color here
+    ObjectShape shape;
+    bool canBecomeStatic = false;
+    float orbitAngularSpeed = 0.0f;
+    int planet = -1;        // 0 for the sun, 1-7 for planets, -1 otherwise
+    int textureLayer = -1;  // layer in the planet texture array
+    bool hasTexture = false;
+};
+
+// The physics side of the sandbox: the Box2D world, its objects and the
+// force modes driven by user input. It has no GL or Qt dependency, so a
+// session can be stepped without a window. Every input that changes the
+// world goes through one of the methods below and is appended to the input
+// log while recording, keyed by the current step.
+class Simulation {
+public:
+    Simulation(float worldWidth, float worldHeight);
+    ~Simulation();
+
+    // Advance the world by one fixed 1/60 s step and apply the active forces
+    void step();
+    uint32_t stepCount() const { return m_stepCount; }
+
+    // Inputs
+    void setWorldSize(float width, float height);
+    void createObject(float x, float y, ObjectShape shape, float size, const glm::vec3 &color);
+    void createWater(float x, float y);
+    void setGravityCenter(float x, float y);
+    void explode(float x, float y);
+    void setGravity(float x, float y);
+    void startOrbit();
+    void beginStroke(float x, float y);
+    void extendStroke(float x, float y);
+    void endStroke();
+    void resetGravityCenter();
+    void initializeSolarSystem();
+    void resetWorld();
+    void setExplosionStrength(int strength);
+    void setOrbitSpeed(int speed);
+
+    // Apply a logged input
+    void apply(const InputEvent &event);
+
+    // Log every following input to path. Only valid before the first step,
+    // so that the log replays from the same initial state.
+    bool startRecording(const std::string &path);
+    void stopRecording();
+    bool isRecording() const { return m_log.isOpen(); }
+
+    // Re-execute a recorded session as fast as possible and print timings.
+    // With checkTriads every incremental triad update is compared with a
+    // full re-triangulation and the mismatches are reported. Returns false
+    // if the log cannot be read or a triad update differed.
+    static bool replay(const std::string &path, bool checkTriads = false);
+
+    // Checkpoint the whole session: the Box2D world (see b2WorldSnapshot),
+    // the objects, strokes and force modes. Loading maps the file and
+    // restores the world from it in place; on failure the current state is
+    // kept. Loading stops input recording, since a log only replays from
+    // the initial state.
+    bool saveSnapshot(const std::string &path) const;
+    bool loadSnapshot(const std::string &path);
+
+    b2World* world() const { return m_world; }
+    b2ParticleSystem* particleSystem() const { return m_particleSystem; }
+    float worldWidth() const { return m_worldWidth; }
+    float worldHeight() const { return m_worldHeight; }
+    std::vector<PhysObject> &objects() { return m_objects; }
+    bool isDrawingStroke() const { return m_currentBrush != nullptr; }
+    const std::vector<b2Vec2> &currentStroke() const { return m_currentStroke; }
+    const std::vector<std::vector<b2Vec2>> &brushStrokes() const { return m_allBrushStrokes; }
+
+private:
+    void record(InputEvent::Type type, std::initializer_list<float> args = {}, int32_t value = 0);
+    void createGround();
+    PhysObject &addObject(float x, float y, ObjectShape shape, float size, const glm::vec3 &color);
+
+    b2World* m_world = nullptr;
+    b2Body* m_groundBody = nullptr;
+    b2ParticleSystem* m_particleSystem = nullptr;
+    float m_worldWidth;
+    float m_worldHeight;
+    std::vector<PhysObject> m_objects;
+    uint32_t m_stepCount = 0;
+
+    InputLog m_log;
+    ForceFieldSet m_forceFields;
+
+    bool m_hasGravityCenter = false;
+    glm::vec2 m_gravityCenter = glm::vec2(0.0f, 0.0f);
+    float m_gravityStrength = 10.0f; // Adjust as needed
+
+    bool m_explosionMode = false;
+    int m_explosionStrength = 10;
+    glm::vec2 m_explosionCenter = glm::vec2(0.0f, 0.0f);
+
+    bool m_orbitMode = false;
+    glm::vec2 m_orbitCenter = glm::vec2(0.0f);
+    int m_orbitSpeed = 1;
+
+    b2Body* m_currentBrush = nullptr;
+    float m_brushThickness = 0.1f;
+    std::vector<b2Vec2> m_currentStroke;
+    std::vector<std::vector<b2Vec2>> m_allBrushStrokes;
+};
@@ -0,0 +1,41 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+unsigned char *alignUp(unsigned char *pointer, size_t alignment) {
+    uintptr_t address = (uintptr_t(pointer) + alignment - 1) & ~uintptr_t(alignment - 1);
+    return reinterpret_cast<unsigned char *>(address);
+}
+
+} // namespace
+
+void *Arena::allocate(size_t size, size_t alignment) {
+    unsigned char *object = alignUp(m_next, alignment);
+    if (!m_next || object > m_end || size > size_t(m_end - object)) {
+        // Objects larger than a block get a block of their own
+        size_t blockSize = std::max(m_blockSize, size + alignment);
+        m_blocks.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[blockSize]), blockSize});
+        m_next = m_blocks.back().memory.get();
+        m_end = m_next + blockSize;
+        object = alignUp(m_next, alignment);
+    }
+    m_next = object + size;
+    return object;
+}
+
+void Arena::clear() {
+    for (Destructor *entry = m_destructors; entry; entry = entry->next) {
+        entry->destroy(entry->object);
+    }
+    m_destructors = nullptr;
+
+    m_next = m_end = nullptr;
+    if (!m_blocks.empty()) {
+        m_blocks.resize(1);
+        m_next = m_blocks[0].memory.get();
+        m_end = m_next + m_blocks[0].size;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for objects that all die together. Objects are placed one
+// after another in large blocks, so creating one is a pointer increment and
+// freeing them all is a handful of frees, however many there are. Objects
+// with destructors are destroyed by clear() and the destructor, in reverse
+// order of creation; objects cannot be freed one at a time.
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 64 * 1024) : m_blockSize(blockSize) {}
+    ~Arena() { clear(); }
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args) {
+        if constexpr (std::is_trivially_destructible_v<T>) {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        } else {
+            void *entryMemory = allocate(sizeof(Destructor), alignof(Destructor));
+            T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            m_destructors = new (entryMemory) Destructor{
+                [](void *pointer) { static_cast<T *>(pointer)->~T(); }, object, m_destructors};
+            return object;
+        }
+    }
+
+    // Uninitialized memory, valid until clear()
+    void *allocate(size_t size, size_t alignment);
+
+    // Destroy every object and release the memory. The first block is kept
+    // for reuse.
+    void clear();
+
+private:
+    struct Destructor {
+        void (*destroy)(void *);
+        void *object;
+        Destructor *next;
+    };
+
+    struct Block {
+        std::unique_ptr<unsigned char[]> memory;
+        size_t size;
+    };
+
+    size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    unsigned char *m_next = nullptr;
+    unsigned char *m_end = nullptr;
+    Destructor *m_destructors = nullptr;
+};
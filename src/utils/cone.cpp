@@ -1,4 +1,4 @@
-#include "Cone.h"
+#include "cone.h"
 #include "glm/ext/scalar_constants.hpp"
 
 void Cone::updateParams(int param1, int param2) {
@@ -7,7 +7,7 @@ class Cone
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+    const std::vector<float> &generateShape() const { return m_vertexData; }
 
 private:
     void insertVec3(std::vector<float> &data, glm::vec3 v);
@@ -1,4 +1,4 @@
-#include "Cube.h"
+#include "cube.h"
 
 void Cube::updateParams(int param1) {
     m_vertexData = std::vector<float>();
@@ -75,20 +75,6 @@ void Cube::makeFace(glm::vec3 topLeft,
 }
 
 void Cube::setVertexData() {
-    // Uncomment these lines for Task 2, then comment them out for Task 3:
-
-    makeTile(glm::vec3(-0.5f,  0.5f, 0.5f),
-             glm::vec3( 0.5f,  0.5f, 0.5f),
-             glm::vec3(-0.5f, -0.5f, 0.5f),
-             glm::vec3( 0.5f, -0.5f, 0.5f));
-
-    // Uncomment these lines for Task 3:
-
-    makeFace(glm::vec3(-0.5f,  0.5f, 0.5f),
-             glm::vec3( 0.5f,  0.5f, 0.5f),
-             glm::vec3(-0.5f, -0.5f, 0.5f),
-             glm::vec3( 0.5f, -0.5f, 0.5f));
-
     // Task 4: Use the makeFace() function to make all 6 sides of the cube
     glm::vec3 p0(-0.5f,  0.5f,  0.5f); // Top-left-front
     glm::vec3 p1( 0.5f,  0.5f,  0.5f); // Top-right-front
@@ -1,4 +1,4 @@
-#include "Cylinder.h"
+#include "cylinder.h"
 #include "glm/ext/scalar_constants.hpp"
 
 void Cylinder::updateParams(int param1, int param2) {
@@ -0,0 +1,210 @@
+#include "fluidrenderer.h"
+#include "programcache.h"
+
+#include <Box2D/Particle/b2ParticleSystem.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <iostream>
+
+// The splat and blur targets are this many times smaller than the viewport
+// on each side
+const int resolutionDivisor = 2;
+// Sprites are drawn wider than a particle so neighbours overlap into one
+// sheet of water
+const float spriteScale = 2.0f;
+
+void FluidRenderer::initialize(ProgramCache &programs) {
+    m_splatProgram = programs.program(
+        ":/resources/shaders/fluid_splat.vert",
+        ":/resources/shaders/fluid_splat.frag");
+    m_blurProgram = programs.program(
+        ":/resources/shaders/screen_quad.vert",
+        ":/resources/shaders/fluid_blur.frag");
+    m_compositeProgram = programs.program(
+        ":/resources/shaders/screen_quad.vert",
+        ":/resources/shaders/fluid_composite.frag");
+
+    // Positions and colors are copied as they are in the particle system
+    // buffers, so they live in two vertex buffers
+    glGenVertexArrays(1, &m_particleVAO);
+    glBindVertexArray(m_particleVAO);
+
+    glGenBuffers(1, &m_positionVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_positionVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(b2Vec2), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glGenBuffers(1, &m_colorVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_colorVBO);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(b2ParticleColor), (void*)0);
+    glEnableVertexAttribArray(1);
+
+    // Fullscreen quad for screen_quad.vert: position, then texture coordinates
+    GLfloat quad[] = {
+        -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+        -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+         1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+         1.0f, -1.0f, 0.0f, 1.0f, 0.0f
+    };
+    glGenVertexArrays(1, &m_quadVAO);
+    glBindVertexArray(m_quadVAO);
+
+    glGenBuffers(1, &m_quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void FluidRenderer::resizeTargets(int width, int height) {
+    glDeleteFramebuffers(2, m_targetFBOs);
+    glDeleteTextures(2, m_targetTextures);
+
+    m_targetWidth = std::max(width / resolutionDivisor, 1);
+    m_targetHeight = std::max(height / resolutionDivisor, 1);
+
+    // Half floats, since splats add up well past 1 inside a body of water
+    glGenFramebuffers(2, m_targetFBOs);
+    glGenTextures(2, m_targetTextures);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, m_targetTextures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_targetWidth, m_targetHeight, 0,
+                     GL_RGBA, GL_HALF_FLOAT, nullptr);
+        // Linear filtering smooths the upsampling in the composite pass
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_targetFBOs[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               m_targetTextures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Error: Fluid framebuffer is not complete!" << std::endl;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void FluidRenderer::render(const b2ParticleSystem *particles, const glm::mat4 &projection) {
+    int count = particles->GetParticleCount();
+    if (count == 0) {
+        return;
+    }
+
+    GLint framebuffer;
+    GLint viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+    GLint blendSource, blendDestination;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSource);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDestination);
+
+    if (viewport[2] != m_viewportWidth || viewport[3] != m_viewportHeight) {
+        m_viewportWidth = viewport[2];
+        m_viewportHeight = viewport[3];
+        resizeTargets(m_viewportWidth, m_viewportHeight);
+    }
+
+    // Orphan the previous frame's buffers so the upload doesn't wait for
+    // them to be drawn
+    glBindBuffer(GL_ARRAY_BUFFER, m_positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(b2Vec2), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(b2Vec2), particles->GetPositionBuffer());
+    glBindBuffer(GL_ARRAY_BUFFER, m_colorVBO);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(b2ParticleColor), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(b2ParticleColor), particles->GetColorBuffer());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Splat: sum every sprite's thickness and weighted color
+    glBindFramebuffer(GL_FRAMEBUFFER, m_targetFBOs[0]);
+    glViewport(0, 0, m_targetWidth, m_targetHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    // The x scale of the projection is half the target width per world unit
+    float pixelsPerUnit = projection[0][0] * 0.5f * m_targetWidth;
+    float pointSize = 2.0f * particles->GetRadius() * spriteScale * pixelsPerUnit;
+    glUseProgram(m_splatProgram);
+    glUniformMatrix4fv(glGetUniformLocation(m_splatProgram, "u_Projection"), 1, GL_FALSE,
+                       glm::value_ptr(projection));
+    glUniform1f(glGetUniformLocation(m_splatProgram, "u_PointSize"), pointSize);
+    glBindVertexArray(m_particleVAO);
+    glDrawArrays(GL_POINTS, 0, count);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glDisable(GL_BLEND);
+
+    // Smooth horizontally into target 1, then vertically back into target 0
+    glUseProgram(m_blurProgram);
+    glUniform1i(glGetUniformLocation(m_blurProgram, "u_texture"), 0);
+    GLint directionLoc = glGetUniformLocation(m_blurProgram, "u_direction");
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_targetFBOs[1]);
+    glBindTexture(GL_TEXTURE_2D, m_targetTextures[0]);
+    glUniform2f(directionLoc, 1.0f / m_targetWidth, 0.0f);
+    drawFullscreenQuad();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_targetFBOs[0]);
+    glBindTexture(GL_TEXTURE_2D, m_targetTextures[1]);
+    glUniform2f(directionLoc, 0.0f, 1.0f / m_targetHeight);
+    drawFullscreenQuad();
+
+    // Shade the surface over the caller's framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(m_compositeProgram);
+    glUniform1i(glGetUniformLocation(m_compositeProgram, "u_texture"), 0);
+    glUniform2f(glGetUniformLocation(m_compositeProgram, "u_texelSize"),
+                1.0f / m_targetWidth, 1.0f / m_targetHeight);
+    glBindTexture(GL_TEXTURE_2D, m_targetTextures[0]);
+    drawFullscreenQuad();
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBlendFunc(blendSource, blendDestination);
+    if (!blendEnabled) {
+        glDisable(GL_BLEND);
+    }
+}
+
+void FluidRenderer::drawFullscreenQuad() {
+    glBindVertexArray(m_quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void FluidRenderer::finish() {
+    glDeleteProgram(m_splatProgram);
+    glDeleteProgram(m_blurProgram);
+    glDeleteProgram(m_compositeProgram);
+    m_splatProgram = m_blurProgram = m_compositeProgram = 0;
+
+    glDeleteVertexArrays(1, &m_particleVAO);
+    glDeleteBuffers(1, &m_positionVBO);
+    glDeleteBuffers(1, &m_colorVBO);
+    glDeleteVertexArrays(1, &m_quadVAO);
+    glDeleteBuffers(1, &m_quadVBO);
+    m_particleVAO = m_positionVBO = m_colorVBO = m_quadVAO = m_quadVBO = 0;
+
+    glDeleteFramebuffers(2, m_targetFBOs);
+    glDeleteTextures(2, m_targetTextures);
+    m_targetFBOs[0] = m_targetFBOs[1] = 0;
+    m_targetTextures[0] = m_targetTextures[1] = 0;
+    m_viewportWidth = m_viewportHeight = 0;
+}
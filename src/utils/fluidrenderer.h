@@ -0,0 +1,61 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class b2ParticleSystem;
+class ProgramCache;
+
+// Draws particle water as a continuous surface instead of separate points.
+// Every particle is splatted as a point sprite into a reduced resolution
+// target, adding up its thickness and its color weighted by that
+// thickness. The result is smoothed by a separable bilateral blur, which
+// merges neighbouring splats without bleeding across the water's edge, and
+// composited over the current framebuffer: the smoothed thickness gives the
+// surface outline, its gradient the normals for shading, and its value how
+// much of the background shows through. The passes after the splat cost the
+// same per pixel however many particles there are.
+class FluidRenderer {
+public:
+    // Build the shaders and create the particle buffers. Requires a current
+    // GL context.
+    void initialize(ProgramCache &programs);
+    bool isInitialized() const { return m_splatProgram != 0; }
+
+    // Draw the particles into the currently bound framebuffer, covering its
+    // viewport. projection maps world coordinates to clip space. Leaves the
+    // framebuffer, viewport, clear color and blend state as they were; the
+    // current program, vertex array and texture bindings are reset.
+    void render(const b2ParticleSystem *particles, const glm::mat4 &projection);
+
+    // Release the GL objects. Requires a current GL context.
+    void finish();
+
+private:
+    // (Re)create the splat and blur targets when the viewport size changes
+    void resizeTargets(int width, int height);
+    void drawFullscreenQuad();
+
+    GLuint m_splatProgram = 0;
+    GLuint m_blurProgram = 0;
+    GLuint m_compositeProgram = 0;
+
+    GLuint m_particleVAO = 0;
+    GLuint m_positionVBO = 0;
+    GLuint m_colorVBO = 0;
+    GLuint m_quadVAO = 0;
+    GLuint m_quadVBO = 0;
+
+    // Ping-pong targets: the splat lands in 0, the horizontal blur writes 1
+    // and the vertical blur writes back to 0
+    GLuint m_targetFBOs[2] = {0, 0};
+    GLuint m_targetTextures[2] = {0, 0};
+    int m_viewportWidth = 0;
+    int m_viewportHeight = 0;
+    int m_targetWidth = 0;
+    int m_targetHeight = 0;
+};
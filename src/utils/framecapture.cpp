@@ -0,0 +1,270 @@
+#include "framecapture.h"
+#include "framerecorder.h"
+
+#include <QString>
+#include <cstring>
+#include <iostream>
+
+FrameCapture::~FrameCapture() {
+    // GL objects are released in finish(), which needs a current context;
+    // the encoder thread only needs to drain its queue
+    if (m_encoder.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_jobAvailable.notify_one();
+        m_encoder.join();
+    }
+}
+
+bool FrameCapture::initialize(int width, int height, int ringSize) {
+    m_width = width;
+    m_height = height;
+
+    GLint previousFramebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+    // Render target, with a depth buffer in case the scene uses depth testing
+    glGenFramebuffers(1, &m_renderFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_renderFBO);
+
+    glGenRenderbuffers(1, &m_colorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRenderbuffer);
+
+    glGenRenderbuffers(1, &m_depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    // Blit destination holding the frame in top-down row order
+    glGenFramebuffers(1, &m_flipFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_flipFBO);
+
+    glGenRenderbuffers(1, &m_flipRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_flipRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_flipRenderbuffer);
+
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+    if (!complete) {
+        std::cerr << "Error: Capture framebuffer is not complete!" << std::endl;
+        finish();
+        return false;
+    }
+
+    m_slots.resize(ringSize);
+    for (Slot &slot : m_slots) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 3, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_nextSlot = 0;
+    m_pendingSlot = 0;
+
+    if (!m_encoder.joinable()) {
+        m_stopping = false;
+        m_encoder = std::thread(&FrameCapture::encoderLoop, this);
+    }
+    return true;
+}
+
+void FrameCapture::beginFrame() {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_renderFBO);
+    glViewport(0, 0, m_width, m_height);
+}
+
+bool FrameCapture::endFrame(const std::string &filePath) {
+    bool queued = readback(m_renderFBO, m_width, m_height, filePath, nullptr);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+    glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+    return queued;
+}
+
+void FrameCapture::captureFramebuffer(GLuint framebuffer, int width, int height,
+                                      FrameRecorder *recorder) {
+    GLint readFramebuffer, drawFramebuffer;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+
+    readback(framebuffer, width, height, std::string(), recorder);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+}
+
+bool FrameCapture::readback(GLuint source, int width, int height, const std::string &filePath,
+                            FrameRecorder *recorder) {
+    Slot &slot = m_slots[m_nextSlot];
+    if (slot.fence) {
+        // The ring is full. Reuse the oldest slot if the GPU has finished
+        // with it; otherwise skip this frame rather than wait
+        if (!collect(slot, false)) {
+            if (recorder) {
+                recorder->dropFrame();
+            }
+            return false;
+        }
+        m_pendingSlot = (m_nextSlot + 1) % m_slots.size();
+    }
+
+    // Flip vertically while copying, so rows come back top-down
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_flipFBO);
+    glBlitFramebuffer(0, 0, width, height,
+                      0, m_height, m_width, 0,
+                      GL_COLOR_BUFFER_BIT,
+                      width == m_width && height == m_height ? GL_NEAREST : GL_LINEAR);
+
+    // Start the transfer into the pixel pack buffer; glReadPixels returns
+    // without waiting for the GPU
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_flipFBO);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.filePath = filePath;
+    slot.recorder = recorder;
+    m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+    glFlush();
+    return true;
+}
+
+void FrameCapture::poll() {
+    // Readbacks complete in submission order, so stop at the first one the
+    // GPU has not finished
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        Slot &slot = m_slots[m_pendingSlot];
+        if (!slot.fence || !collect(slot, false)) {
+            return;
+        }
+        m_pendingSlot = (m_pendingSlot + 1) % m_slots.size();
+    }
+}
+
+void FrameCapture::flush() {
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        Slot &slot = m_slots[(m_pendingSlot + i) % m_slots.size()];
+        if (slot.fence) {
+            collect(slot, true);
+        }
+    }
+    m_pendingSlot = m_nextSlot;
+}
+
+bool FrameCapture::collect(Slot &slot, bool wait) {
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        return false;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const unsigned char *pixels = static_cast<const unsigned char *>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_width * m_height * 3, GL_MAP_READ_BIT));
+
+    if (slot.recorder) {
+        if (pixels && slot.recorder->isRecording()) {
+            slot.recorder->submit(pixels);
+        }
+        if (pixels) {
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.recorder = nullptr;
+        return true;
+    }
+
+    QImage image(m_width, m_height, QImage::Format_RGB888);
+    if (pixels) {
+        // QImage pads scanlines to 4 bytes, so copy row by row
+        for (int y = 0; y < m_height; y++) {
+            std::memcpy(image.scanLine(y), pixels + y * m_width * 3, m_width * 3);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (pixels) {
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_jobs.size() < maxQueuedJobs) {
+                m_jobs.push_back({std::move(image), std::move(slot.filePath)});
+                queued = true;
+            }
+        }
+        if (queued) {
+            m_jobAvailable.notify_one();
+        } else {
+            std::cerr << "Screenshot queue is full, dropping " << slot.filePath << std::endl;
+        }
+    } else {
+        std::cerr << "Failed to map capture buffer for " << slot.filePath << std::endl;
+    }
+    slot.filePath.clear();
+    return true;
+}
+
+void FrameCapture::encoderLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+        if (m_jobs.empty()) {
+            return;
+        }
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_encoding = true;
+        lock.unlock();
+
+        if (!job.image.save(QString::fromStdString(job.filePath))) {
+            std::cerr << "Failed to save image to " << job.filePath << std::endl;
+        }
+
+        lock.lock();
+        m_encoding = false;
+        m_jobsDone.notify_all();
+    }
+}
+
+void FrameCapture::finish() {
+    flush();
+
+    // Let the encoder write everything queued before returning
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobsDone.wait(lock, [this] { return m_jobs.empty() && !m_encoding; });
+    }
+
+    for (Slot &slot : m_slots) {
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    m_slots.clear();
+
+    glDeleteRenderbuffers(1, &m_colorRenderbuffer);
+    glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+    glDeleteRenderbuffers(1, &m_flipRenderbuffer);
+    glDeleteFramebuffers(1, &m_renderFBO);
+    glDeleteFramebuffers(1, &m_flipFBO);
+    m_colorRenderbuffer = m_depthRenderbuffer = m_flipRenderbuffer = 0;
+    m_renderFBO = m_flipFBO = 0;
+}
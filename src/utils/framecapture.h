@@ -0,0 +1,113 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <QImage>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameRecorder;
+
+// Captures rendered frames without stalling the GUI thread. Frames are drawn
+// into a reusable offscreen target, flipped to top-down row order by a
+// framebuffer blit and read into a ring of pixel pack buffers. Each readback
+// is fenced and collected by poll() once the GPU has finished it, usually a
+// frame later. Screenshots are then written to disk on an encoder thread;
+// recorded frames are handed to their FrameRecorder.
+class FrameCapture {
+public:
+    // Screenshots waiting for the encoder thread. Further screenshots are
+    // refused until it catches up, so a slow disk cannot grow the queue.
+    static const size_t maxQueuedJobs = 4;
+
+    ~FrameCapture();
+
+    // Create the capture target and the readback ring. Requires a current GL
+    // context. Returns false if the framebuffer is incomplete.
+    bool initialize(int width, int height, int ringSize = 3);
+    bool isInitialized() const { return m_renderFBO != 0; }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // Bind the capture target and set the viewport to its size. The caller
+    // then renders the frame.
+    void beginFrame();
+
+    // Queue the readback of the frame rendered since beginFrame() and
+    // restore the previous framebuffer and viewport. The image is saved to
+    // filePath once the readback completes. Returns false, queueing nothing,
+    // if every readback slot is still busy; the caller renders the frame
+    // again later.
+    bool endFrame(const std::string &filePath);
+
+    // Queue the readback of a framebuffer of the given size, scaled to the
+    // capture size, for a recording. Leaves the framebuffer bindings as they
+    // were.
+    void captureFramebuffer(GLuint framebuffer, int width, int height, FrameRecorder *recorder);
+
+    // Hand every completed readback to the encoder thread or recorder.
+    // Requires a current GL context; called once per frame.
+    void poll();
+
+    // Complete all pending readbacks, blocking until the GPU is done.
+    void flush();
+
+    // Complete all pending readbacks, wait for the encoder to write them and
+    // release the GL objects. Requires a current GL context.
+    void finish();
+
+private:
+    struct Slot {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        std::string filePath;              // screenshot destination, or
+        FrameRecorder *recorder = nullptr; // recording receiving the frame
+    };
+
+    struct Job {
+        QImage image;
+        std::string filePath;
+    };
+
+    // Flip and scale the source framebuffer into the readback target and
+    // start the transfer into the next slot. If every slot is still waiting
+    // on the GPU the frame is skipped instead and false returned.
+    bool readback(GLuint source, int width, int height, const std::string &filePath,
+                  FrameRecorder *recorder);
+    // Copy a finished readback out of its pixel pack buffer, optionally
+    // blocking until the GPU is done with it. Returns false if still pending.
+    bool collect(Slot &slot, bool wait);
+    void encoderLoop();
+
+    int m_width = 0;
+    int m_height = 0;
+
+    GLuint m_renderFBO = 0;
+    GLuint m_colorRenderbuffer = 0;
+    GLuint m_depthRenderbuffer = 0;
+    GLuint m_flipFBO = 0;
+    GLuint m_flipRenderbuffer = 0;
+
+    std::vector<Slot> m_slots;
+    int m_nextSlot = 0;    // slot the next endFrame() writes
+    int m_pendingSlot = 0; // oldest slot that may hold a readback
+
+    GLint m_savedFramebuffer = 0;
+    GLint m_savedViewport[4] = {0, 0, 0, 0};
+
+    std::thread m_encoder;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_jobsDone;
+    std::deque<Job> m_jobs;
+    bool m_encoding = false;
+    bool m_stopping = false;
+};
@@ -0,0 +1,129 @@
+#include "framerecorder.h"
+
+#include <QImage>
+#include <QString>
+#include <cstring>
+#include <iostream>
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+}
+
+bool FrameRecorder::start(const std::string &path, Format format, int width, int height,
+                          int fps, int poolSize) {
+    stop();
+
+    m_format = format;
+    m_path = path;
+    m_width = width;
+    m_height = height;
+
+    if (format == Format::Y4M) {
+        m_file = std::fopen(path.c_str(), "wb");
+        if (!m_file) {
+            std::cerr << "Failed to open recording " << path << std::endl;
+            return false;
+        }
+        std::fprintf(m_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+        m_planes.resize(width * height * 3);
+    }
+
+    m_frames.assign(poolSize, std::vector<unsigned char>(width * height * 3));
+    m_freeFrames.reset(poolSize);
+    m_filledFrames.reset(poolSize);
+    for (int i = 0; i < poolSize; i++) {
+        m_freeFrames.push(i);
+    }
+
+    m_recordedFrames = 0;
+    m_droppedFrames = 0;
+    m_stopping = false;
+    m_recording = true;
+    m_encoder = std::thread(&FrameRecorder::encoderLoop, this);
+    return true;
+}
+
+void FrameRecorder::stop() {
+    if (!m_recording) {
+        return;
+    }
+    m_stopping = true;
+    m_signal.fetch_add(1);
+    m_signal.notify_one();
+    m_encoder.join();
+
+    if (m_file) {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    m_recording = false;
+    std::cout << "Recorded " << m_recordedFrames << " frames to " << m_path
+              << " (" << m_droppedFrames << " dropped)" << std::endl;
+
+    m_frames.clear();
+    m_planes.clear();
+}
+
+void FrameRecorder::submit(const unsigned char *rgb) {
+    int index;
+    if (!m_freeFrames.pop(index)) {
+        // The encoder is behind; keep the simulation running instead
+        m_droppedFrames++;
+        return;
+    }
+    std::memcpy(m_frames[index].data(), rgb, m_frames[index].size());
+    m_filledFrames.push(index);
+    m_signal.fetch_add(1);
+    m_signal.notify_one();
+}
+
+void FrameRecorder::encoderLoop() {
+    for (;;) {
+        unsigned int seen = m_signal.load();
+        // Read before draining: every frame submitted before stop() is then
+        // visible to the drain below
+        bool stopping = m_stopping;
+        int index;
+        while (m_filledFrames.pop(index)) {
+            if (m_format == Format::Y4M) {
+                writeY4M(m_frames[index].data());
+            } else {
+                writePNG(m_frames[index].data());
+            }
+            m_recordedFrames++;
+            m_freeFrames.push(index);
+        }
+        if (stopping) {
+            return;
+        }
+        m_signal.wait(seen);
+    }
+}
+
+void FrameRecorder::writeY4M(const unsigned char *rgb) {
+    // BT.601 studio-range RGB to planar YUV 4:4:4
+    int pixelCount = m_width * m_height;
+    unsigned char *y = m_planes.data();
+    unsigned char *u = y + pixelCount;
+    unsigned char *v = u + pixelCount;
+    for (int i = 0; i < pixelCount; i++) {
+        int r = rgb[3 * i];
+        int g = rgb[3 * i + 1];
+        int b = rgb[3 * i + 2];
+        y[i] = (unsigned char)(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+        u[i] = (unsigned char)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+        v[i] = (unsigned char)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+    }
+    std::fputs("FRAME\n", m_file);
+    std::fwrite(m_planes.data(), 1, m_planes.size(), m_file);
+}
+
+void FrameRecorder::writePNG(const unsigned char *rgb) {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_%06d.png", m_recordedFrames.load());
+    QImage image(rgb, m_width, m_height, m_width * 3, QImage::Format_RGB888);
+    // Favor encoding speed over file size
+    if (!image.save(QString::fromStdString(m_path + suffix), "PNG", 90)) {
+        std::cerr << "Failed to save frame to " << m_path << suffix << std::endl;
+    }
+}
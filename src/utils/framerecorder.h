@@ -0,0 +1,70 @@
+#pragma once
+
+#include "spscqueue.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams captured frames to disk on an encoder thread. Frames are copied
+// into a fixed pool of buffers that circulate between the GUI thread and the
+// encoder through two lock-free queues, so memory stays bounded and the GUI
+// thread never waits: when the encoder falls behind and no buffer is free,
+// the frame is dropped from the recording rather than stalling the
+// simulation.
+class FrameRecorder {
+public:
+    enum class Format {
+        Y4M,        // one uncompressed YUV4MPEG2 (4:4:4) stream, e.g. path.y4m
+        PNGSequence // numbered PNG files, e.g. path_000000.png
+    };
+
+    ~FrameRecorder();
+
+    // Start recording width x height frames. For Y4M, path is the output
+    // file; for PNGSequence it is the prefix of the numbered files.
+    bool start(const std::string &path, Format format, int width, int height,
+               int fps = 60, int poolSize = 8);
+
+    // Write every frame already submitted, then close the output.
+    void stop();
+
+    bool isRecording() const { return m_recording; }
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int recordedFrames() const { return m_recordedFrames.load(); }
+    int droppedFrames() const { return m_droppedFrames; }
+
+    // Queue a top-down, tightly packed RGB frame. Called on the GUI thread.
+    void submit(const unsigned char *rgb);
+
+    // Count a frame that was lost before it could be submitted, e.g. because
+    // its readback could not be started.
+    void dropFrame() { m_droppedFrames++; }
+
+private:
+    void encoderLoop();
+    void writeY4M(const unsigned char *rgb);
+    void writePNG(const unsigned char *rgb);
+
+    bool m_recording = false;
+    Format m_format = Format::Y4M;
+    std::string m_path;
+    int m_width = 0;
+    int m_height = 0;
+    FILE *m_file = nullptr;
+
+    // Pool of frame buffers; the queues carry indices into it
+    std::vector<std::vector<unsigned char>> m_frames;
+    SpscQueue<int> m_freeFrames;   // encoder -> GUI thread
+    SpscQueue<int> m_filledFrames; // GUI thread -> encoder
+    std::vector<unsigned char> m_planes; // Y4M conversion scratch
+
+    std::thread m_encoder;
+    // Bumped with every submitted frame and on stop; the encoder sleeps on it
+    std::atomic<unsigned int> m_signal{0};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<int> m_recordedFrames{0};
+    int m_droppedFrames = 0;
+};
@@ -0,0 +1,205 @@
+#include "inputlog.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char logMagic[4] = {'I', 'N', 'P', 'L'};
+const uint8_t logVersion = 1;
+
+// Arguments stored for each event type
+struct EventLayout {
+    uint8_t floatCount;
+    bool hasValue;
+};
+
+const EventLayout eventLayouts[] = {
+    {0, true},  // End
+    {2, false}, // SetWorldSize
+    {6, true},  // CreateObject
+    {2, false}, // CreateWater
+    {2, false}, // SetGravityCenter
+    {2, false}, // Explode
+    {2, false}, // SetGravity
+    {0, false}, // StartOrbit
+    {2, false}, // BeginStroke
+    {2, false}, // ExtendStroke
+    {0, false}, // EndStroke
+    {0, false}, // ResetGravityCenter
+    {0, false}, // InitializeSolarSystem
+    {0, false}, // ResetWorld
+    {0, true},  // SetExplosionStrength
+    {0, true},  // SetOrbitSpeed
+};
+static_assert(sizeof(eventLayouts) / sizeof(eventLayouts[0]) == size_t(InputEvent::Type::Count),
+              "every event type needs a layout");
+
+// Cursor over the bytes of a log being read
+struct Reader {
+    const std::vector<unsigned char> &data;
+    size_t offset = 0;
+
+    bool readVarint(uint32_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (offset >= data.size()) {
+                return false;
+            }
+            unsigned char byte = data[offset++];
+            value |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readFloat(float &value) {
+        if (offset + 4 > data.size()) {
+            return false;
+        }
+        uint32_t bits = data[offset] | (data[offset + 1] << 8) |
+                        (data[offset + 2] << 16) | (uint32_t(data[offset + 3]) << 24);
+        std::memcpy(&value, &bits, sizeof(value));
+        offset += 4;
+        return true;
+    }
+};
+
+} // namespace
+
+InputLog::~InputLog() {
+    if (m_file) {
+        std::fclose(m_file);
+    }
+}
+
+bool InputLog::open(const std::string &path, float worldWidth, float worldHeight) {
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) {
+        std::cerr << "Failed to open input log " << path << std::endl;
+        return false;
+    }
+    std::fwrite(logMagic, 1, sizeof(logMagic), m_file);
+    std::fputc(logVersion, m_file);
+    writeFloat(worldWidth);
+    writeFloat(worldHeight);
+    m_lastStep = 0;
+    return true;
+}
+
+void InputLog::append(const InputEvent &event) {
+    if (!m_file) {
+        return;
+    }
+    const EventLayout &layout = eventLayouts[size_t(event.type)];
+    std::fputc(uint8_t(event.type), m_file);
+    writeVarint(event.step - m_lastStep);
+    m_lastStep = event.step;
+    if (layout.hasValue) {
+        writeVarint((uint32_t(event.value) << 1) ^ uint32_t(event.value >> 31));
+    }
+    for (int i = 0; i < layout.floatCount; i++) {
+        writeFloat(event.args[i]);
+    }
+}
+
+void InputLog::close(uint32_t stepCount) {
+    if (!m_file) {
+        return;
+    }
+    InputEvent end;
+    end.step = stepCount;
+    end.value = int32_t(stepCount);
+    append(end);
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+bool InputLog::read(const std::string &path, float &worldWidth, float &worldHeight,
+                    std::vector<InputEvent> &events) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Failed to open input log " << path << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> data;
+    unsigned char buffer[4096];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    std::fclose(file);
+
+    Reader reader{data};
+    if (data.size() < sizeof(logMagic) + 1 ||
+        std::memcmp(data.data(), logMagic, sizeof(logMagic)) != 0 ||
+        data[sizeof(logMagic)] != logVersion) {
+        std::cerr << "Not a supported input log: " << path << std::endl;
+        return false;
+    }
+    reader.offset = sizeof(logMagic) + 1;
+    if (!reader.readFloat(worldWidth) || !reader.readFloat(worldHeight)) {
+        std::cerr << "Truncated input log: " << path << std::endl;
+        return false;
+    }
+
+    events.clear();
+    uint32_t step = 0;
+    while (reader.offset < data.size()) {
+        InputEvent event;
+        uint8_t type = data[reader.offset++];
+        if (type >= uint8_t(InputEvent::Type::Count)) {
+            std::cerr << "Corrupt input log: " << path << std::endl;
+            return false;
+        }
+        event.type = InputEvent::Type(type);
+        const EventLayout &layout = eventLayouts[type];
+
+        uint32_t delta, value = 0;
+        bool ok = reader.readVarint(delta);
+        if (ok && layout.hasValue) {
+            ok = reader.readVarint(value);
+        }
+        for (int i = 0; ok && i < layout.floatCount; i++) {
+            ok = reader.readFloat(event.args[i]);
+        }
+        if (!ok) {
+            std::cerr << "Truncated input log: " << path << std::endl;
+            return false;
+        }
+        step += delta;
+        event.step = step;
+        event.value = int32_t(value >> 1) ^ -int32_t(value & 1);
+        events.push_back(event);
+        if (event.type == InputEvent::Type::End) {
+            return true;
+        }
+    }
+
+    // The session did not shut down cleanly; replay up to the last input
+    InputEvent end;
+    end.step = step;
+    end.value = int32_t(step);
+    events.push_back(end);
+    return true;
+}
+
+void InputLog::writeVarint(uint32_t value) {
+    while (value >= 0x80) {
+        std::fputc(int(value & 0x7f) | 0x80, m_file);
+        value >>= 7;
+    }
+    std::fputc(int(value), m_file);
+}
+
+void InputLog::writeFloat(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    unsigned char bytes[4] = {
+        (unsigned char)bits, (unsigned char)(bits >> 8),
+        (unsigned char)(bits >> 16), (unsigned char)(bits >> 24)
+    };
+    std::fwrite(bytes, 1, sizeof(bytes), m_file);
+}
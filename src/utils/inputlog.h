@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// One user input applied to the simulation. Events are keyed by the number
+// of world steps taken before they happened, so replaying them in front of
+// the same steps reproduces the session exactly.
+struct InputEvent {
+    enum class Type : uint8_t {
+        End = 0,              // value = total number of steps
+        SetWorldSize,         // args = width, height
+        CreateObject,         // args = x, y, size, r, g, b; value = ObjectShape
+        CreateWater,          // args = x, y
+        SetGravityCenter,     // args = x, y
+        Explode,              // args = x, y
+        SetGravity,           // args = x, y
+        StartOrbit,
+        BeginStroke,          // args = x, y
+        ExtendStroke,         // args = x, y
+        EndStroke,
+        ResetGravityCenter,
+        InitializeSolarSystem,
+        ResetWorld,
+        SetExplosionStrength, // value
+        SetOrbitSpeed,        // value
+        Count
+    };
+
+    Type type = Type::End;
+    uint32_t step = 0;
+    float args[6] = {0, 0, 0, 0, 0, 0};
+    int32_t value = 0;
+};
+
+// Compact binary log of InputEvents. After a short header each event is
+// stored as its type byte, the step delta to the previous event as a varint,
+// then only the arguments its type uses: a zigzag varint for the value and
+// little-endian floats.
+class InputLog {
+public:
+    ~InputLog();
+
+    // Create the log file, recording the initial world size
+    bool open(const std::string &path, float worldWidth, float worldHeight);
+    bool isOpen() const { return m_file != nullptr; }
+    void append(const InputEvent &event);
+    // Write the End event carrying the final step count and close the file
+    void close(uint32_t stepCount);
+
+    // Read a whole log. The last event is always an End event.
+    static bool read(const std::string &path, float &worldWidth, float &worldHeight,
+                     std::vector<InputEvent> &events);
+
+private:
+    void writeVarint(uint32_t value);
+    void writeFloat(float value);
+
+    FILE *m_file = nullptr;
+    uint32_t m_lastStep = 0;
+};
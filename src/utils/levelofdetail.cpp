@@ -0,0 +1,85 @@
+#include "levelofdetail.h"
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Tessellation parameters of each level, finest first
+const int levelParameters[LevelOfDetail::levelCount][2] = {
+    {24, 48},
+    {12, 24},
+    {6, 12},
+    {3, 6}
+};
+
+// Smallest projected radius in pixels each level but the last is used at
+const float levelThresholds[LevelOfDetail::levelCount - 1] = {96.0f, 24.0f, 6.0f};
+
+// A shape only coarsens once it is this fraction of the threshold
+const float hysteresis = 0.8f;
+
+// Radius of the sphere around each unit primitive, centered at the origin
+float boundingRadius(PrimitiveType type) {
+    switch (type) {
+    case PrimitiveType::PRIMITIVE_CUBE:
+        return 0.8660254f; // corner at (0.5, 0.5, 0.5)
+    case PrimitiveType::PRIMITIVE_CONE:
+    case PrimitiveType::PRIMITIVE_CYLINDER:
+        return 0.7071068f; // rim at radius 0.5, height 0.5
+    default:
+        return 0.5f;
+    }
+}
+
+} // namespace
+
+void LevelOfDetail::initialize(ShapeCache &shapes) {
+    for (int type = 0; type <= int(PrimitiveType::PRIMITIVE_MESH); type++) {
+        for (int level = 0; level < levelCount; level++) {
+            m_meshes[type][level] = shapes.mesh(PrimitiveType(type),
+                                                levelParameters[level][0],
+                                                levelParameters[level][1]);
+        }
+    }
+}
+
+void LevelOfDetail::update(RenderShapes &shapes, const Camera &camera,
+                           int viewportHeight) const {
+    // Pixels per unit of radius at unit distance in front of the camera
+    float pixelScale = camera.projectionMatrix[1][1] * 0.5f * float(viewportHeight);
+
+    for (size_t i = 0; i < shapes.size(); i++) {
+        if (!shapes.visible[i]) {
+            continue;
+        }
+        const glm::mat4 &ctm = shapes.ctms[i];
+        PrimitiveType type = shapes.types[i];
+        float scale = std::sqrt(std::max({glm::dot(glm::vec3(ctm[0]), glm::vec3(ctm[0])),
+                                          glm::dot(glm::vec3(ctm[1]), glm::vec3(ctm[1])),
+                                          glm::dot(glm::vec3(ctm[2]), glm::vec3(ctm[2]))}));
+        float radius = boundingRadius(type) * scale;
+        float depth = -(camera.viewMatrix * ctm[3]).z;
+
+        int level = 0;
+        if (depth > radius) {
+            float size = radius * pixelScale / depth;
+            if (shapes.lods[i] < 0) {
+                while (level < levelCount - 1 && size < levelThresholds[level]) {
+                    level++;
+                }
+            } else {
+                level = shapes.lods[i];
+                while (level > 0 && size >= levelThresholds[level - 1]) {
+                    level--;
+                }
+                while (level < levelCount - 1 && size < levelThresholds[level] * hysteresis) {
+                    level++;
+                }
+            }
+        }
+        shapes.lods[i] = level;
+        shapes.meshes[i] = m_meshes[int(type)][level];
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "sceneparser.h"
+#include "shapecache.h"
+
+class Camera;
+
+// Picks the tessellation of every scene shape from how large it is on
+// screen, so distant shapes cost a few dozen triangles and close ones stay
+// smooth. A shape's size is the radius in pixels of its bounding sphere
+// projected with the camera's projection matrix. A shape moves to a finer
+// level as soon as it grows past the level's threshold, but only back to a
+// coarser one once it has shrunk a margin below it, so shapes hovering at a
+// threshold do not switch meshes every frame.
+class LevelOfDetail {
+public:
+    static const int levelCount = 4;
+
+    // Generate every level of every primitive in shapes. The meshes still
+    // have to be uploaded.
+    void initialize(ShapeCache &shapes);
+
+    // Set the level and mesh of each visible shape for the camera, drawing
+    // into a viewport viewportHeight pixels high. Hidden shapes keep theirs.
+    void update(RenderShapes &shapes, const Camera &camera, int viewportHeight) const;
+
+private:
+    // Meshes by primitive type, finest level first
+    ShapeCache::Mesh m_meshes[int(PrimitiveType::PRIMITIVE_MESH) + 1][levelCount];
+};
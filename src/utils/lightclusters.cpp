@@ -0,0 +1,327 @@
+#include "lightclusters.h"
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// A light's reach ends where its attenuated diffuse color falls below one
+// step of an 8-bit channel. default.frag fades the whole light out over the
+// last quarter of the range, so the diffuse cut is not visible. Specular
+// highlights fall off with the square root of the attenuation and are cut
+// by the same window; sizing the range for them would make it a few hundred
+// times longer and put every light in every cluster.
+const float contributionThreshold = 1.0f / 256.0f;
+
+const int clusterCount = LightClusters::tilesX * LightClusters::tilesY * LightClusters::slices;
+
+// The distance past which the light's contribution stays below the
+// threshold, or infinity if it never falls off
+float lightRange(const SceneLightData &light) {
+    float brightest = std::max({light.color.r, light.color.g, light.color.b});
+    if (brightest <= 0.0f) {
+        return 0.0f;
+    }
+    // Out of range once brightest / (c + l d + q d^2) <= threshold
+    float limit = brightest / contributionThreshold;
+    float c = light.function.x, l = light.function.y, q = light.function.z;
+    if (c >= limit) {
+        return 0.0f;
+    }
+    float range;
+    if (q > 0.0f) {
+        range = (-l + std::sqrt(l * l + 4.0f * q * (limit - c))) / (2.0f * q);
+    } else if (l > 0.0f) {
+        range = (limit - c) / l;
+    } else {
+        return INFINITY;
+    }
+    return std::max(range, 0.0f);
+}
+
+bool sphereOverlapsBox(const glm::vec3 &center, float radius, const glm::vec3 &min,
+                       const glm::vec3 &max) {
+    glm::vec3 offset = center - glm::clamp(center, min, max);
+    return glm::dot(offset, offset) <= radius * radius;
+}
+
+} // namespace
+
+void LightClusters::initialize(GLuint program) {
+    GLuint block = glGetUniformBlockIndex(program, "Lights");
+    glUniformBlockBinding(program, block, lightBinding);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "clusterLights"), clusterUnit);
+    glUniform1i(glGetUniformLocation(program, "lightIndices"), indexUnit);
+    glUseProgram(0);
+
+    glGenBuffers(1, &m_lightBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_lightBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, maxLights * sizeof(LightRecord), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Every cluster starts out empty
+    m_clusterRanges.assign(2 * clusterCount, 0);
+    glGenBuffers(1, &m_clusterBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_clusterBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_clusterRanges.size() * sizeof(uint32_t),
+                 m_clusterRanges.data(), GL_DYNAMIC_DRAW);
+    m_indexCapacity = 256;
+    glGenBuffers(1, &m_indexBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_indexCapacity, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &m_clusterTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_clusterTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_clusterBuffer);
+    glGenTextures(1, &m_indexTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_indexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, m_indexBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::setLights(const std::vector<SceneLightData> &lights) {
+    if (lights.size() > size_t(maxLights)) {
+        std::cerr << "Scene has " << lights.size() << " lights; only the first " << maxLights
+                  << " are drawn" << std::endl;
+    }
+
+    // default.frag takes angles in degrees and light types in its own order
+    m_lights.clear();
+    m_localLights.clear();
+    m_ranges.clear();
+    for (size_t i = 0; i < lights.size() && i < size_t(maxLights); i++) {
+        const SceneLightData &light = lights[i];
+        LightRecord record = {};
+        switch (light.type) {
+        case LightType::LIGHT_DIRECTIONAL: record.type = 0; break;
+        case LightType::LIGHT_POINT: record.type = 1; break;
+        case LightType::LIGHT_SPOT: record.type = 2; break;
+        }
+        record.position = glm::vec3(light.pos);
+        record.direction = glm::vec3(light.dir);
+        record.color = glm::vec3(light.color);
+        record.angle = glm::degrees(light.angle);
+        record.penumbra = glm::degrees(light.penumbra);
+        record.attenuation = light.function;
+
+        float range = light.type == LightType::LIGHT_DIRECTIONAL ? INFINITY : lightRange(light);
+        if (std::isinf(range)) {
+            m_lights.push_back(record);
+        } else {
+            record.range = range;
+            m_localLights.push_back(record);
+            m_ranges.push_back(range);
+        }
+    }
+    m_sceneGlobalCount = int(m_lights.size());
+    m_globalCount = m_sceneGlobalCount;
+    m_dirty = true;
+}
+
+int LightClusters::sliceOf(float depth) const {
+    int slice = int(std::floor(std::log(depth) * m_sliceScale + m_sliceBias));
+    return std::clamp(slice, 0, slices - 1);
+}
+
+void LightClusters::buildClusterBoxes(const glm::mat4 &projection, float nearPlane,
+                                      float farPlane) {
+    m_nearPlane = nearPlane;
+    m_farPlane = farPlane;
+    float logRatio = std::log(farPlane / nearPlane);
+    m_sliceScale = slices / logRatio;
+    m_sliceBias = -slices * std::log(nearPlane) / logRatio;
+
+    int corner = 0;
+    for (float depth : {nearPlane, farPlane}) {
+        for (float nx : {-1.0f, 1.0f}) {
+            for (float ny : {-1.0f, 1.0f}) {
+                m_frustumCorners[corner++] = glm::vec3(nx * depth / projection[0][0],
+                                                       ny * depth / projection[1][1], -depth);
+            }
+        }
+    }
+
+    m_clusterBoxes.resize(clusterCount);
+    for (int slice = 0; slice < slices; slice++) {
+        float depths[2] = {nearPlane * std::pow(farPlane / nearPlane, float(slice) / slices),
+                           nearPlane * std::pow(farPlane / nearPlane, float(slice + 1) / slices)};
+        for (int y = 0; y < tilesY; y++) {
+            for (int x = 0; x < tilesX; x++) {
+                // The tile's corners in normalized device coordinates
+                float ndcX[2] = {-1.0f + 2.0f * x / tilesX, -1.0f + 2.0f * (x + 1) / tilesX};
+                float ndcY[2] = {-1.0f + 2.0f * y / tilesY, -1.0f + 2.0f * (y + 1) / tilesY};
+                Box box = {glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+                for (float depth : depths) {
+                    for (float nx : ndcX) {
+                        for (float ny : ndcY) {
+                            glm::vec3 corner(nx * depth / projection[0][0],
+                                             ny * depth / projection[1][1], -depth);
+                            box.min = glm::min(box.min, corner);
+                            box.max = glm::max(box.max, corner);
+                        }
+                    }
+                }
+                m_clusterBoxes[(slice * tilesY + y) * tilesX + x] = box;
+            }
+        }
+    }
+}
+
+void LightClusters::update(const Camera &camera, const GLint viewport[4]) {
+    if (!m_dirty && camera.viewMatrix == m_view && camera.projectionMatrix == m_projection &&
+        std::equal(viewport, viewport + 4, m_viewport)) {
+        return;
+    }
+    if (m_clusterBoxes.empty() || camera.projectionMatrix != m_projection ||
+        camera.nearPlane != m_nearPlane || camera.farPlane != m_farPlane) {
+        buildClusterBoxes(camera.projectionMatrix, camera.nearPlane, camera.farPlane);
+    }
+    m_dirty = false;
+    m_view = camera.viewMatrix;
+    m_projection = camera.projectionMatrix;
+    std::copy(viewport, viewport + 4, m_viewport);
+
+    // A local light whose sphere holds the whole view frustum would be
+    // binned into every cluster, so it joins the global lights for this view
+    // and costs no index fetches. The lights are uploaded in that order.
+    m_lights.resize(m_sceneGlobalCount);
+    m_binned.clear();
+    for (size_t i = 0; i < m_localLights.size(); i++) {
+        glm::vec3 center = glm::vec3(m_view * glm::vec4(m_localLights[i].position, 1.0f));
+        bool coversView = true;
+        for (const glm::vec3 &corner : m_frustumCorners) {
+            glm::vec3 offset = corner - center;
+            coversView = coversView && glm::dot(offset, offset) <= m_ranges[i] * m_ranges[i];
+        }
+        if (coversView) {
+            m_lights.push_back(m_localLights[i]);
+        } else {
+            m_binned.push_back(uint32_t(i));
+        }
+    }
+    m_globalCount = int(m_lights.size());
+    for (uint32_t i : m_binned) {
+        m_lights.push_back(m_localLights[i]);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, m_lightBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, m_lights.size() * sizeof(LightRecord), m_lights.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Every other local light against the clusters its bounding sphere may
+    // reach
+    m_pairs.clear();
+    for (size_t i = 0; i < m_binned.size(); i++) {
+        const LightRecord &light = m_lights[m_globalCount + i];
+        glm::vec3 center = glm::vec3(m_view * glm::vec4(light.position, 1.0f));
+        float radius = m_ranges[m_binned[i]];
+        float depth = -center.z;
+        if (depth + radius < m_nearPlane || depth - radius > m_farPlane) {
+            continue;
+        }
+        int firstSlice = sliceOf(std::max(depth - radius, m_nearPlane));
+        int lastSlice = sliceOf(std::min(depth + radius, m_farPlane));
+
+        // Tiles under the projection of the sphere's box, unless it reaches
+        // behind the near plane
+        int firstX = 0, lastX = tilesX - 1, firstY = 0, lastY = tilesY - 1;
+        if (depth - radius > m_nearPlane) {
+            glm::vec2 min(INFINITY), max(-INFINITY);
+            for (float cornerDepth : {depth - radius, depth + radius}) {
+                for (float dx : {-radius, radius}) {
+                    for (float dy : {-radius, radius}) {
+                        glm::vec2 ndc(m_projection[0][0] * (center.x + dx) / cornerDepth,
+                                      m_projection[1][1] * (center.y + dy) / cornerDepth);
+                        min = glm::min(min, ndc);
+                        max = glm::max(max, ndc);
+                    }
+                }
+            }
+            if (max.x < -1.0f || min.x > 1.0f || max.y < -1.0f || min.y > 1.0f) {
+                continue;
+            }
+            firstX = std::clamp(int((min.x * 0.5f + 0.5f) * tilesX), 0, tilesX - 1);
+            lastX = std::clamp(int((max.x * 0.5f + 0.5f) * tilesX), 0, tilesX - 1);
+            firstY = std::clamp(int((min.y * 0.5f + 0.5f) * tilesY), 0, tilesY - 1);
+            lastY = std::clamp(int((max.y * 0.5f + 0.5f) * tilesY), 0, tilesY - 1);
+        }
+
+        uint8_t index = uint8_t(m_globalCount + i);
+        for (int slice = firstSlice; slice <= lastSlice; slice++) {
+            for (int y = firstY; y <= lastY; y++) {
+                for (int x = firstX; x <= lastX; x++) {
+                    uint32_t cluster = (slice * tilesY + y) * tilesX + x;
+                    const Box &box = m_clusterBoxes[cluster];
+                    if (sphereOverlapsBox(center, radius, box.min, box.max)) {
+                        m_pairs.push_back({cluster, index});
+                    }
+                }
+            }
+        }
+    }
+
+    // Group the indices by cluster
+    std::fill(m_clusterRanges.begin(), m_clusterRanges.end(), 0);
+    for (const auto &pair : m_pairs) {
+        m_clusterRanges[2 * pair.first + 1]++;
+    }
+    uint32_t first = 0;
+    for (int cluster = 0; cluster < clusterCount; cluster++) {
+        m_clusterRanges[2 * cluster] = first;
+        first += m_clusterRanges[2 * cluster + 1];
+    }
+    m_indices.resize(m_pairs.size());
+    std::vector<uint32_t> next(clusterCount);
+    for (int cluster = 0; cluster < clusterCount; cluster++) {
+        next[cluster] = m_clusterRanges[2 * cluster];
+    }
+    for (const auto &pair : m_pairs) {
+        m_indices[next[pair.first]++] = pair.second;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_clusterBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, m_clusterRanges.size() * sizeof(uint32_t),
+                    m_clusterRanges.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+    if (m_indices.size() > m_indexCapacity) {
+        m_indexCapacity = std::max(m_indices.size(), 2 * m_indexCapacity);
+        glBufferData(GL_TEXTURE_BUFFER, m_indexCapacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, m_indices.size(), m_indices.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::bind(GLuint program) const {
+    glUniform1i(glGetUniformLocation(program, "numGlobalLights"), m_globalCount);
+    glUniform4f(glGetUniformLocation(program, "clusterViewport"), float(m_viewport[0]),
+                float(m_viewport[1]), float(m_viewport[2]), float(m_viewport[3]));
+    glUniform2f(glGetUniformLocation(program, "clusterDepth"), m_sliceScale, m_sliceBias);
+    glBindBufferBase(GL_UNIFORM_BUFFER, lightBinding, m_lightBuffer);
+
+    glActiveTexture(GL_TEXTURE0 + clusterUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, m_clusterTexture);
+    glActiveTexture(GL_TEXTURE0 + indexUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, m_indexTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void LightClusters::finish() {
+    glDeleteBuffers(1, &m_lightBuffer);
+    glDeleteBuffers(1, &m_clusterBuffer);
+    glDeleteBuffers(1, &m_indexBuffer);
+    glDeleteTextures(1, &m_clusterTexture);
+    glDeleteTextures(1, &m_indexTexture);
+    m_lightBuffer = m_clusterBuffer = m_indexBuffer = 0;
+    m_clusterTexture = m_indexTexture = 0;
+    m_indexCapacity = 0;
+    m_lights.clear();
+    m_localLights.clear();
+    m_ranges.clear();
+    m_binned.clear();
+    m_sceneGlobalCount = m_globalCount = 0;
+    m_clusterBoxes.clear();
+    m_dirty = true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "scenedata.h"
+
+class Camera;
+
+// Clustered forward lighting for the scene shapes. The lights live in a
+// std140 uniform block of maxLights entries. Directional lights, and point
+// and spot lights whose attenuation never falls off, light every fragment
+// and come first. The others only reach as far as their contribution is
+// visible, and are binned on the CPU into a grid of clusters: tiles of the
+// viewport, each split into slices exponentially spaced in view depth. A
+// fragment looks up its cluster and only evaluates the lights binned into
+// it, so a scene can hold hundreds of local lights at the cost of the few
+// that overlap each fragment. Local lights that reach the whole view
+// frustum are treated as global for that view instead.
+//
+// GL 4.1 has no storage buffers, so each cluster's range of light indices
+// and the indices themselves are read through buffer textures. The bins
+// are rebuilt when the camera, the viewport or the lights change.
+class LightClusters {
+public:
+    // Entries of default.frag's Lights block
+    static const int maxLights = 256;
+    static const int tilesX = 16;
+    static const int tilesY = 9;
+    static const int slices = 24;
+    static const GLuint lightBinding = 1;
+    // Texture units of the cluster and light index buffers
+    static const int clusterUnit = 1;
+    static const int indexUnit = 2;
+
+    // Bind program's Lights block and samplers. Requires a current GL
+    // context.
+    void initialize(GLuint program);
+
+    // Upload the lights of a new scene. Requires a current GL context.
+    void setLights(const std::vector<SceneLightData> &lights);
+
+    // Bin the local lights for the camera and viewport if either changed
+    // since the last call. Requires a current GL context.
+    void update(const Camera &camera, const GLint viewport[4]);
+
+    // Set program's cluster uniforms and bind the buffers for drawing with
+    // it. Leaves texture unit 0 active.
+    void bind(GLuint program) const;
+
+    // Release the GL objects. Requires a current GL context.
+    void finish();
+
+private:
+    // Lights block entry, in std140 layout
+    struct LightRecord {
+        glm::vec3 position;
+        float angle;           // spotlight cutoff, in degrees
+        glm::vec3 direction;
+        float penumbra;        // in degrees
+        glm::vec3 color;
+        int32_t type;          // 0 = directional, 1 = point, 2 = spotlight
+        glm::vec3 attenuation; // (k_c, k_l, k_q)
+        float range;           // 0 for lights that reach everywhere
+    };
+
+    struct Box {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    void buildClusterBoxes(const glm::mat4 &projection, float nearPlane, float farPlane);
+    int sliceOf(float depth) const;
+
+    std::vector<LightRecord> m_localLights;
+    std::vector<float> m_ranges;       // of the local lights
+    int m_sceneGlobalCount = 0;        // directional and unattenuated lights
+    // As uploaded for the current view: global lights first, then the
+    // binned local lights in m_binned order
+    std::vector<LightRecord> m_lights;
+    std::vector<uint32_t> m_binned;    // indices into m_localLights
+    int m_globalCount = 0;
+
+    // View space bounds of every cluster and of the view frustum, for the
+    // current projection
+    std::vector<Box> m_clusterBoxes;
+    glm::vec3 m_frustumCorners[8];
+    float m_nearPlane = 0.0f;
+    float m_farPlane = 0.0f;
+    float m_sliceScale = 0.0f;
+    float m_sliceBias = 0.0f;
+
+    // The state the bins were built for
+    bool m_dirty = true;
+    glm::mat4 m_view = glm::mat4(0.0f);
+    glm::mat4 m_projection = glm::mat4(0.0f);
+    GLint m_viewport[4] = {0, 0, 0, 0};
+
+    // Per cluster, the lights overlapping it
+    std::vector<uint32_t> m_clusterRanges; // first and count
+    std::vector<uint8_t> m_indices;
+    std::vector<std::pair<uint32_t, uint8_t>> m_pairs; // cluster, light
+
+    GLuint m_lightBuffer = 0;
+    GLuint m_clusterBuffer = 0;
+    GLuint m_clusterTexture = 0;
+    GLuint m_indexBuffer = 0;
+    GLuint m_indexTexture = 0;
+    size_t m_indexCapacity = 0;
+};
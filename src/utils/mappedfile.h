@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The contents are paged in on
+// first access instead of being copied into a buffer up front. The mapping
+// starts on a page boundary, so data aligned within the file stays aligned
+// in memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const unsigned char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const unsigned char *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void *m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,204 @@
+#include "meshindexer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const uint32_t emptySlot = UINT32_MAX;
+
+// Size of the simulated post-transform cache. Larger than most hardware
+// caches, which only makes the optimizer plan further ahead.
+const int cacheSize = 32;
+
+uint32_t hashVertex(const float *vertex, int vertexFloats) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < vertexFloats; i++) {
+        uint32_t bits;
+        std::memcpy(&bits, &vertex[i], sizeof(bits));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    return hash;
+}
+
+// Merge vertices with equal attributes and drop the triangles that
+// collapse, such as those of a sphere's tiles touching a pole
+IndexedMesh weld(const std::vector<float> &triangles, int vertexFloats) {
+    IndexedMesh mesh;
+    size_t inputCount = triangles.size() / vertexFloats;
+    size_t tableSize = 1;
+    while (tableSize < 2 * inputCount) {
+        tableSize *= 2;
+    }
+    std::vector<uint32_t> table(tableSize, emptySlot);
+    std::vector<float> vertex(vertexFloats);
+
+    for (size_t i = 0; i < inputCount; i++) {
+        // Adding +0 turns -0 into +0, so both hash the same
+        for (int j = 0; j < vertexFloats; j++) {
+            vertex[j] = triangles[i * vertexFloats + j] + 0.0f;
+        }
+        size_t slot = hashVertex(vertex.data(), vertexFloats) & (tableSize - 1);
+        while (table[slot] != emptySlot &&
+               std::memcmp(&mesh.vertices[size_t(table[slot]) * vertexFloats], vertex.data(),
+                           vertexFloats * sizeof(float)) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == emptySlot) {
+            table[slot] = uint32_t(mesh.vertices.size() / vertexFloats);
+            mesh.vertices.insert(mesh.vertices.end(), vertex.begin(), vertex.end());
+        }
+        mesh.indices.push_back(table[slot]);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+        if (a != b && b != c && c != a) {
+            mesh.indices[kept++] = a;
+            mesh.indices[kept++] = b;
+            mesh.indices[kept++] = c;
+        }
+    }
+    mesh.indices.resize(kept);
+    return mesh;
+}
+
+// How much drawing a triangle through this vertex is worth: more if the
+// vertex is recent in the cache, and more if it has few triangles left, so
+// lone triangles are not stranded
+float vertexScore(int cachePosition, int remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // Used by the previous triangle. Scored a bit lower than the next
+            // entries, which favours strips over fans.
+            score = 0.75f;
+        } else {
+            score = std::pow(1.0f - float(cachePosition - 3) / (cacheSize - 3), 1.5f);
+        }
+    }
+    return score + 2.0f / std::sqrt(float(remainingTriangles));
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+
+    // The triangles still to draw that use each vertex, as ranges of
+    // triangles starting at offsets[vertex], remaining[vertex] long
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t index : indices) {
+        offsets[index + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<int> remaining(vertexCount, 0);
+    std::vector<uint32_t> triangles(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        uint32_t v = indices[i];
+        triangles[offsets[v] + remaining[v]++] = uint32_t(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> drawn(triangleCount, false);
+    int best = -1;
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+        if (best < 0 || triangleScore[t] > triangleScore[best]) {
+            best = int(t);
+        }
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache, nextCache;
+    size_t scan = 0;
+    while (result.size() < indices.size()) {
+        if (best < 0) {
+            // Nothing in the cache has triangles left; start anew from the
+            // first undrawn triangle
+            while (drawn[scan]) {
+                scan++;
+            }
+            best = int(scan);
+        }
+        drawn[best] = true;
+        const uint32_t *triangle = &indices[3 * size_t(best)];
+        nextCache.assign(triangle, triangle + 3);
+        for (int i = 0; i < 3; i++) {
+            uint32_t v = triangle[i];
+            result.push_back(v);
+            uint32_t *begin = &triangles[offsets[v]];
+            uint32_t *end = begin + remaining[v];
+            *std::find(begin, end, uint32_t(best)) = *(end - 1);
+            remaining[v]--;
+        }
+
+        // The triangle's vertices move to the front of the cache
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                nextCache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            uint32_t v = nextCache[i];
+            cachePosition[v] = i < size_t(cacheSize) ? int(i) : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+
+        // Only triangles touching the cache changed score
+        best = -1;
+        for (uint32_t v : nextCache) {
+            for (int i = 0; i < remaining[v]; i++) {
+                uint32_t t = triangles[offsets[v] + i];
+                triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+                if (best < 0 || triangleScore[t] > triangleScore[best]) {
+                    best = int(t);
+                }
+            }
+        }
+        if (nextCache.size() > size_t(cacheSize)) {
+            nextCache.resize(cacheSize);
+        }
+        std::swap(cache, nextCache);
+    }
+    indices.swap(result);
+}
+
+// Renumber the vertices in order of first use
+void optimizeVertexFetch(IndexedMesh &mesh, int vertexFloats) {
+    size_t vertexCount = mesh.vertices.size() / vertexFloats;
+    std::vector<uint32_t> remap(vertexCount, emptySlot);
+    std::vector<float> vertices(mesh.vertices.size());
+    uint32_t next = 0;
+    for (uint32_t &index : mesh.indices) {
+        if (remap[index] == emptySlot) {
+            std::memcpy(&vertices[size_t(next) * vertexFloats], &mesh.vertices[size_t(index) * vertexFloats],
+                        vertexFloats * sizeof(float));
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    // Vertices only used by dropped triangles go
+    vertices.resize(size_t(next) * vertexFloats);
+    mesh.vertices.swap(vertices);
+}
+
+} // namespace
+
+IndexedMesh indexTriangles(const std::vector<float> &triangles, int vertexFloats) {
+    IndexedMesh mesh = weld(triangles, vertexFloats);
+    optimizeVertexCache(mesh.indices, mesh.vertices.size() / vertexFloats);
+    optimizeVertexFetch(mesh, vertexFloats);
+    return mesh;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A triangle list as unique vertices and three indices per triangle
+struct IndexedMesh {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// Turn the non-indexed triangles the primitive generators emit, vertexFloats
+// floats per vertex, into an indexed mesh:
+// - Vertices with bitwise equal attributes are welded, so a tile's corner is
+//   stored once instead of once per triangle using it. -0 and +0 count as
+//   equal; vertices that only share a position, such as the corners of a
+//   cube, keep their own normals.
+// - Triangles are reordered so vertices are reused while they are still in
+//   the GPU's post-transform cache, using Forsyth's linear-speed optimizer.
+// - Vertices are then renumbered in the order the triangles first use them,
+//   so vertex fetches walk the buffer forwards.
+IndexedMesh indexTriangles(const std::vector<float> &triangles, int vertexFloats);
@@ -0,0 +1,178 @@
+#include "postprocessor.h"
+#include "programcache.h"
+
+#include <algorithm>
+#include <iostream>
+
+void PostProcessor::initialize(ProgramCache &programs) {
+    // In the order of Filter
+    const char *defines[] = {
+        "",
+        "#define FILTER_GRAYSCALE\n",
+        "#define FILTER_INVERT\n",
+        "#define FILTER_SHARPEN\n",
+        "#define FILTER_BLUR\n"
+    };
+    for (int i = 0; i < 5; i++) {
+        m_programs[i] = programs.program(
+            ":/resources/shaders/screen_quad.vert",
+            ":/resources/shaders/post_processing.frag",
+            defines[i]);
+        glUseProgram(m_programs[i]);
+        glUniform1i(glGetUniformLocation(m_programs[i], "u_texture"), 0);
+    }
+    glUseProgram(0);
+
+    // Fullscreen quad for screen_quad.vert: position, then texture coordinates
+    GLfloat quad[] = {
+        -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+        -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+         1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+         1.0f, -1.0f, 0.0f, 1.0f, 0.0f
+    };
+    glGenVertexArrays(1, &m_quadVAO);
+    glBindVertexArray(m_quadVAO);
+
+    glGenBuffers(1, &m_quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void PostProcessor::createTarget(Target &target, int width, int height, bool withDepth) {
+    deleteTarget(target);
+    target.width = width;
+    target.height = height;
+
+    glGenTextures(1, &target.texture);
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    // The blur and the upsampling rely on bilinear fetches
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+    if (withDepth) {
+        glGenRenderbuffers(1, &target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Error: Post-processing framebuffer is not complete!" << std::endl;
+    }
+}
+
+void PostProcessor::deleteTarget(Target &target) {
+    glDeleteFramebuffers(1, &target.fbo);
+    glDeleteTextures(1, &target.texture);
+    glDeleteRenderbuffers(1, &target.depth);
+    target = Target();
+}
+
+void PostProcessor::beginFrame() {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+
+    int width = m_savedViewport[2];
+    int height = m_savedViewport[3];
+    if (width != m_frame.width || height != m_frame.height) {
+        // Scenes are drawn with depth testing
+        createTarget(m_frame, width, height, true);
+        // The others are created by the first frame that needs them
+        deleteTarget(m_intermediate);
+        deleteTarget(m_halfTargets[0]);
+        deleteTarget(m_halfTargets[1]);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_frame.fbo);
+    glViewport(0, 0, width, height);
+}
+
+void PostProcessor::runPass(GLuint program, const Target &source, const Target *target) {
+    if (target) {
+        glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+        glViewport(0, 0, target->width, target->height);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+        glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+    }
+    glUseProgram(program);
+    glBindTexture(GL_TEXTURE_2D, source.texture);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void PostProcessor::endFrame(Filter filter) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(m_quadVAO);
+
+    GLuint program = m_programs[int(filter)];
+    if (filter == Filter::Blur) {
+        // Offsets stay in full resolution texels at either resolution, so the
+        // blur has the same width on screen
+        GLint directionLoc = glGetUniformLocation(program, "u_direction");
+        glUseProgram(program);
+        if (m_halfResolution) {
+            int halfWidth = std::max(m_frame.width / 2, 1);
+            int halfHeight = std::max(m_frame.height / 2, 1);
+            for (Target &target : m_halfTargets) {
+                if (!target.fbo) {
+                    createTarget(target, halfWidth, halfHeight);
+                }
+            }
+            // The horizontal pass also downsamples: each of its fetches
+            // lands between full resolution texels and averages them
+            glUniform2f(directionLoc, 1.0f / m_frame.width, 0.0f);
+            runPass(program, m_frame, &m_halfTargets[0]);
+            glUniform2f(directionLoc, 0.0f, 1.0f / m_frame.height);
+            runPass(program, m_halfTargets[0], &m_halfTargets[1]);
+            runPass(m_programs[int(Filter::None)], m_halfTargets[1], nullptr);
+        } else {
+            if (!m_intermediate.fbo) {
+                createTarget(m_intermediate, m_frame.width, m_frame.height);
+            }
+            glUniform2f(directionLoc, 1.0f / m_frame.width, 0.0f);
+            runPass(program, m_frame, &m_intermediate);
+            glUniform2f(directionLoc, 0.0f, 1.0f / m_frame.height);
+            runPass(program, m_intermediate, nullptr);
+        }
+    } else {
+        if (filter == Filter::Sharpen) {
+            glUseProgram(program);
+            glUniform2f(glGetUniformLocation(program, "u_texelSize"),
+                        1.0f / m_frame.width, 1.0f / m_frame.height);
+        }
+        runPass(program, m_frame, nullptr);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+void PostProcessor::finish() {
+    for (GLuint &program : m_programs) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+    glDeleteVertexArrays(1, &m_quadVAO);
+    glDeleteBuffers(1, &m_quadVBO);
+    m_quadVAO = m_quadVBO = 0;
+
+    deleteTarget(m_frame);
+    deleteTarget(m_intermediate);
+    deleteTarget(m_halfTargets[0]);
+    deleteTarget(m_halfTargets[1]);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+class ProgramCache;
+
+// Applies a full-screen filter to a rendered frame. The frame is drawn into
+// an offscreen texture between beginFrame() and endFrame(), which then runs
+// the filter into the framebuffer that was bound before.
+//
+// Every filter is its own program, compiled from post_processing.frag with
+// the filter's define, so no fragment branches on the filter type. The blur
+// is separable: a horizontal and a vertical pass of 3 bilinear fetches each
+// instead of one 25-tap pass. With half resolution on, the blur passes run
+// on a target a quarter of the size and the result is upsampled, which
+// keeps the cost down on high-DPI screens where the blur hides the lost
+// detail anyway.
+class PostProcessor {
+public:
+    enum class Filter {
+        None,
+        Grayscale,
+        Invert,
+        Sharpen,
+        Blur
+    };
+
+    // Build the filter programs. Requires a current GL context.
+    void initialize(ProgramCache &programs);
+
+    // Redirect rendering to the offscreen frame, sized to the current
+    // viewport.
+    void beginFrame();
+
+    // Filter the frame into the framebuffer bound at beginFrame() and
+    // restore that framebuffer and viewport. Resets the current program,
+    // vertex array and texture bindings.
+    void endFrame(Filter filter);
+
+    void setHalfResolution(bool halfResolution) { m_halfResolution = halfResolution; }
+    bool halfResolution() const { return m_halfResolution; }
+
+    // Release the GL objects. Requires a current GL context.
+    void finish();
+
+private:
+    struct Target {
+        GLuint fbo = 0;
+        GLuint texture = 0;
+        GLuint depth = 0; // renderbuffer, only on the frame
+        int width = 0;
+        int height = 0;
+    };
+
+    void createTarget(Target &target, int width, int height, bool withDepth = false);
+    void deleteTarget(Target &target);
+    // Draw source through program into target, or into the saved
+    // framebuffer if target is null
+    void runPass(GLuint program, const Target &source, const Target *target);
+
+    GLuint m_programs[5] = {0, 0, 0, 0, 0}; // indexed by Filter; None copies
+    GLuint m_quadVAO = 0;
+    GLuint m_quadVBO = 0;
+
+    Target m_frame;         // the scene, at full resolution
+    Target m_intermediate;  // between the blur passes at full resolution
+    Target m_halfTargets[2];
+    bool m_halfResolution = false;
+
+    GLint m_savedFramebuffer = 0;
+    GLint m_savedViewport[4] = {0, 0, 0, 0};
+};
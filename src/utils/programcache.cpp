@@ -0,0 +1,141 @@
+#include "programcache.h"
+#include "mappedfile.h"
+#include "shaderloader.h"
+
+#include <QDir>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const char cacheMagic[4] = {'P', 'B', 'I', 'N'};
+const uint32_t cacheVersion = 1;
+
+// Written in front of every cached binary
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format; // binary format reported by glGetProgramBinary
+    uint32_t length; // bytes of binary after the header
+};
+
+// 64-bit FNV-1a, continued from hash
+uint64_t hashBytes(const std::string &bytes, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char byte : bytes) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    // Separates consecutive strings, so "ab" + "c" and "a" + "bc" differ
+    hash ^= 0xff;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+std::string glString(GLenum name) {
+    const GLubyte *value = glGetString(name);
+    return value ? reinterpret_cast<const char *>(value) : "";
+}
+
+} // namespace
+
+GLuint ProgramCache::program(const char *vertexPath, const char *fragmentPath,
+                             const std::string &defines) {
+    if (!m_queried) {
+        m_queried = true;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        m_binariesSupported = formats > 0 && QDir().mkpath(QString::fromStdString(m_directory));
+        m_driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+    }
+
+    std::string vertexCode = ShaderLoader::readShader(vertexPath);
+    std::string fragmentCode = ShaderLoader::readShader(fragmentPath, defines);
+    if (!m_binariesSupported) {
+        m_misses++;
+        return ShaderLoader::createProgramFromSource(vertexCode, fragmentCode);
+    }
+
+    uint64_t key = hashBytes(m_driver, hashBytes(fragmentCode, hashBytes(vertexCode)));
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    std::string path = m_directory + "/" + name;
+
+    GLuint program = load(path, key);
+    if (program) {
+        m_hits++;
+        return program;
+    }
+    m_misses++;
+    program = ShaderLoader::createProgramFromSource(vertexCode, fragmentCode, true);
+    store(path, key, program);
+    return program;
+}
+
+GLuint ProgramCache::load(const std::string &path, uint64_t key) {
+    if (!QFile::exists(QString::fromStdString(path))) {
+        return 0;
+    }
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(CacheHeader)) {
+        return 0;
+    }
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+        header.version != cacheVersion || header.key != key ||
+        header.length != file.size() - sizeof(CacheHeader)) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, file.data() + sizeof(CacheHeader), header.length);
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        // Usually a driver that changed without changing its version string
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::store(const std::string &path, uint64_t key, GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<unsigned char> buffer(sizeof(CacheHeader) + length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, buffer.data() + sizeof(CacheHeader));
+
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.key = key;
+    header.format = format;
+    header.length = uint32_t(length);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    // Written under a temporary name, so a crash never leaves a truncated
+    // binary behind
+    std::string temporaryPath = path + ".tmp";
+    FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to write " << temporaryPath << std::endl;
+        return;
+    }
+    size_t size = sizeof(CacheHeader) + size_t(length);
+    bool written = std::fwrite(buffer.data(), 1, size, file) == size;
+    written = std::fclose(file) == 0 && written;
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write " << path << std::endl;
+        std::remove(temporaryPath.c_str());
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+
+// Builds shader programs through an on-disk cache of linked binaries, so a
+// restart skips compiling and linking. Each program is keyed by a hash of
+// its vertex and fragment source, after defines are inserted, and of the
+// GL vendor, renderer and version strings, so editing a shader or updating
+// the driver just misses the cache. A binary the driver rejects is rebuilt
+// from source and replaced. Drivers that report no binary formats, such as
+// macOS, always compile from source.
+class ProgramCache {
+public:
+    explicit ProgramCache(std::string directory) : m_directory(std::move(directory)) {}
+
+    // Like ShaderLoader::createShaderProgram. Requires a current GL context.
+    // Throws if the program does not compile or link.
+    GLuint program(const char *vertexPath, const char *fragmentPath,
+                   const std::string &defines = std::string());
+
+    // Programs loaded from the cache and built from source so far
+    int hits() const { return m_hits; }
+    int misses() const { return m_misses; }
+
+private:
+    GLuint load(const std::string &path, uint64_t key);
+    void store(const std::string &path, uint64_t key, GLuint program);
+
+    std::string m_directory;
+    bool m_queried = false;
+    bool m_binariesSupported = false;
+    std::string m_driver;
+    int m_hits = 0;
+    int m_misses = 0;
+};
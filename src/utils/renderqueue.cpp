@@ -0,0 +1,134 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+void RenderQueue::initialize(GLuint program) {
+    GLuint block = glGetUniformBlockIndex(program, "Materials");
+    glUniformBlockBinding(program, block, materialBinding);
+}
+
+void RenderQueue::setMaterials(const std::vector<SceneMaterial> &materials,
+                               const SceneGlobalData &global) {
+    // Whole windows, so every window can be bound at its full size
+    m_materialWindows = std::max<uint32_t>(1, (materials.size() + maxMaterials - 1) / maxMaterials);
+    std::vector<MaterialRecord> records(m_materialWindows * maxMaterials, MaterialRecord());
+    for (size_t i = 0; i < materials.size(); i++) {
+        const SceneMaterial &material = materials[i];
+        records[i].ambient = global.ka * glm::vec3(material.cAmbient);
+        records[i].diffuse = global.kd * glm::vec3(material.cDiffuse);
+        records[i].specular = global.ks * glm::vec3(material.cSpecular);
+        records[i].shininess = material.shininess;
+    }
+    if (!m_materialBuffer) {
+        glGenBuffers(1, &m_materialBuffer);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, records.size() * sizeof(MaterialRecord), records.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // A new scene, so the next update rebuilds the queue
+    m_keys.clear();
+}
+
+void RenderQueue::update(const RenderShapes &shapes) {
+    size_t count = shapes.size();
+    bool changed = m_keys.size() != count;
+    m_keys.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = UINT64_MAX;
+        if (shapes.visible[i]) {
+            key = uint64_t(uint32_t(shapes.meshes[i].baseVertex)) << 32 | shapes.materials[i];
+        }
+        if (key != m_keys[i]) {
+            m_keys[i] = key;
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+
+    // The batches hold the visible shapes and are sorted by the key of
+    // their first shape. Batch order breaks ties, so equal keys keep their
+    // instance order.
+    m_batches.update(shapes);
+    const std::vector<ShapeInstances::Batch> &batches = m_batches.batches();
+    const std::vector<uint32_t> &batchShapes = m_batches.shapes();
+    m_order.resize(batches.size());
+    for (uint32_t i = 0; i < batches.size(); i++) {
+        m_order[i] = i;
+    }
+    auto batchKey = [&](uint32_t batch) { return m_keys[batchShapes[batches[batch].first]]; };
+    std::sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) {
+        uint64_t keyA = batchKey(a), keyB = batchKey(b);
+        return keyA != keyB ? keyA < keyB : a < b;
+    });
+
+    m_instances.resize(batchShapes.size());
+    m_buckets.clear();
+    GLsizei next = 0;
+    for (uint32_t index : m_order) {
+        const ShapeInstances::Batch &batch = batches[index];
+        uint32_t window = batch.material / maxMaterials;
+        if (m_buckets.empty() || m_buckets.back().mesh.baseVertex != batch.mesh.baseVertex ||
+            m_buckets.back().window != window) {
+            m_buckets.push_back({batch.mesh, next, 0, window});
+        }
+        for (uint32_t i = batch.first; i < batch.first + batch.count; i++) {
+            m_instances[next++] = {shapes.ctms[batchShapes[i]], batch.material % maxMaterials};
+        }
+        m_buckets.back().count += GLsizei(batch.count);
+    }
+
+    if (!m_instanceBuffer) {
+        glGenBuffers(1, &m_instanceBuffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_instances.size() * sizeof(Instance), m_instances.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void RenderQueue::draw() const {
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttribDivisor(modelAttribute + column, 1);
+        glEnableVertexAttribArray(modelAttribute + column);
+    }
+    glVertexAttribDivisor(materialAttribute, 1);
+    glEnableVertexAttribArray(materialAttribute);
+
+    const GLsizeiptr windowBytes = maxMaterials * sizeof(MaterialRecord);
+    uint32_t boundWindow = m_materialWindows;
+    for (const Bucket &bucket : m_buckets) {
+        if (bucket.window != boundWindow) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, materialBinding, m_materialBuffer,
+                              bucket.window * windowBytes, windowBytes);
+            boundWindow = bucket.window;
+        }
+        size_t offset = bucket.first * sizeof(Instance);
+        for (GLuint column = 0; column < 4; column++) {
+            glVertexAttribPointer(modelAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                  (void*)(offset + column * sizeof(glm::vec4)));
+        }
+        glVertexAttribIPointer(materialAttribute, 1, GL_UNSIGNED_INT, sizeof(Instance),
+                               (void*)(offset + offsetof(Instance, material)));
+        ShapeCache::drawInstanced(bucket.mesh, bucket.count);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void RenderQueue::finish() {
+    glDeleteBuffers(1, &m_instanceBuffer);
+    glDeleteBuffers(1, &m_materialBuffer);
+    m_instanceBuffer = m_materialBuffer = 0;
+    m_materialWindows = 0;
+    m_keys.clear();
+    m_batches.clear();
+    m_order.clear();
+    m_instances.clear();
+    m_buckets.clear();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "sceneparser.h"
+#include "shapecache.h"
+#include "shapeinstances.h"
+
+// Submits the scene shapes in as few draw calls as their meshes allow.
+// ShapeInstances splits the instance lists into batches of one mesh and
+// material; the batches are sorted by mesh and then material, and every
+// run of batches sharing a mesh is one instanced draw, whatever their
+// materials, so the number of draws depends on the tessellations in use
+// rather than on the number of shapes, and the sort on the number of
+// batches.
+//
+// Per-instance data, the CTM and the material index, is streamed into one
+// buffer and fed to default.vert's aModel and aMaterial attributes. GL 4.1
+// has no base instance, so a bucket is selected by pointing the attributes
+// at its first record. The materials live in a std140 uniform block of
+// maxMaterials entries; scenes with more are drawn in windows of that many,
+// and a bucket also ends where the window changes.
+//
+// Shapes culled from the view are left out. The queue is only rebuilt and
+// uploaded when a shape's mesh or visibility changes, so a still camera
+// costs a pass over the shapes and no uploads.
+class RenderQueue {
+public:
+    // Entries of default.frag's Materials block
+    static const int maxMaterials = 256;
+    // The aModel attribute, a mat4 taking this location and the next three
+    static const GLuint modelAttribute = 2;
+    static const GLuint materialAttribute = 6;
+    static const GLuint materialBinding = 0;
+
+    // Bind program's Materials block. Requires a current GL context.
+    void initialize(GLuint program);
+
+    // Upload the material table of a new scene, with the global
+    // coefficients applied. Requires a current GL context.
+    void setMaterials(const std::vector<SceneMaterial> &materials,
+                      const SceneGlobalData &global);
+
+    // Batch and sort the shapes by their current meshes and upload the
+    // instances if the order changed. Requires a current GL context.
+    void update(const RenderShapes &shapes);
+
+    // Draw every bucket with ShapeCache's vertex array bound
+    void draw() const;
+
+    // Draw calls issued by draw()
+    size_t bucketCount() const { return m_buckets.size(); }
+
+    // Release the GL objects. Requires a current GL context.
+    void finish();
+
+private:
+    // Materials block entry, in std140 layout
+    struct MaterialRecord {
+        glm::vec3 ambient;
+        float shininess;
+        glm::vec3 diffuse;
+        float pad0;
+        glm::vec3 specular;
+        float pad1;
+    };
+
+    struct Instance {
+        glm::mat4 model;
+        uint32_t material; // within the bucket's window
+    };
+
+    struct Bucket {
+        ShapeCache::Mesh mesh;
+        GLsizei first; // into the instance buffer
+        GLsizei count;
+        uint32_t window; // of maxMaterials materials
+    };
+
+    // Mesh in the high half, material in the low half; all ones if hidden
+    std::vector<uint64_t> m_keys;    // by shape
+    ShapeInstances m_batches;
+    std::vector<uint32_t> m_order;   // batches sorted by key
+    std::vector<Instance> m_instances;
+    std::vector<Bucket> m_buckets;
+
+    GLuint m_instanceBuffer = 0;
+    GLuint m_materialBuffer = 0;
+    uint32_t m_materialWindows = 0;
+};
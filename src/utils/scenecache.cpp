@@ -0,0 +1,256 @@
+#include "scenecache.h"
+#include "mappedfile.h"
+#include "sceneparser.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <type_traits>
+
+namespace {
+
+// Cache layout: SceneCacheHeader, lightCount SceneLightData,
+// materialCount MaterialRecord, shapeCount CTMs, shapeCount primitive
+// types, shapeCount material indices, instanceListCount instance lists,
+// then stringBytes of texture file names the records point into. Plain
+// structs are stored as they are in memory; the version has to change with
+// any of them.
+const char cacheMagic[4] = {'S', 'C', 'N', 'C'};
+const uint32_t cacheVersion = 3;
+
+struct SceneCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    SceneGlobalData globalData;
+    SceneCameraData cameraData;
+    uint32_t lightCount;
+    uint32_t materialCount;
+    uint32_t shapeCount;
+    uint32_t instanceListCount;
+    uint32_t stringBytes;
+};
+
+struct FileMapRecord {
+    uint32_t isUsed;
+    float repeatU, repeatV;
+    uint32_t nameOffset, nameLength; // into the strings
+};
+
+struct MaterialRecord {
+    SceneColor cAmbient, cDiffuse, cSpecular, cReflective, cTransparent, cEmissive;
+    float shininess, ior, blend;
+    FileMapRecord textureMap, bumpMap;
+};
+
+static_assert(std::is_trivially_copyable<SceneLightData>::value, "lights are stored as they are");
+static_assert(std::is_trivially_copyable<SceneCameraData>::value, "camera is stored as it is");
+
+size_t cacheSize(const SceneCacheHeader &header) {
+    return sizeof(SceneCacheHeader) + header.lightCount * sizeof(SceneLightData) +
+           header.materialCount * sizeof(MaterialRecord) +
+           header.shapeCount * (sizeof(glm::mat4) + 2 * sizeof(uint32_t)) +
+           header.instanceListCount * sizeof(RenderShapes::InstanceList) + header.stringBytes;
+}
+
+FileMapRecord writeMap(const SceneFileMap &map, std::string &strings) {
+    FileMapRecord record = {};
+    record.isUsed = map.isUsed;
+    record.repeatU = map.repeatU;
+    record.repeatV = map.repeatV;
+    record.nameOffset = uint32_t(strings.size());
+    record.nameLength = uint32_t(map.filename.size());
+    strings += map.filename;
+    return record;
+}
+
+bool readMap(const FileMapRecord &record, const char *strings, uint32_t stringBytes,
+             SceneFileMap &map) {
+    if (record.nameOffset > stringBytes || record.nameLength > stringBytes - record.nameOffset) {
+        return false;
+    }
+    map.isUsed = record.isUsed != 0;
+    map.repeatU = record.repeatU;
+    map.repeatV = record.repeatV;
+    map.filename.assign(strings + record.nameOffset, record.nameLength);
+    return true;
+}
+
+} // namespace
+
+std::string SceneCache::cachePath(const std::string &scenePath) {
+    return scenePath + ".cache";
+}
+
+uint64_t SceneCache::hashFile(const unsigned char *data, size_t size) {
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool SceneCache::load(const std::string &path, uint64_t sourceHash, uint64_t sourceSize,
+                      RenderData &renderData) {
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+        return false;
+    }
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(SceneCacheHeader)) {
+        return false;
+    }
+    SceneCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+        header.version != cacheVersion || header.sourceHash != sourceHash ||
+        header.sourceSize != sourceSize || cacheSize(header) != file.size()) {
+        return false;
+    }
+
+    const unsigned char *in = file.data() + sizeof(header);
+    auto readArray = [&in](auto &vector, uint32_t count) {
+        vector.resize(count);
+        std::memcpy(vector.data(), in, count * sizeof(vector[0]));
+        in += count * sizeof(vector[0]);
+    };
+
+    std::vector<SceneLightData> lights;
+    readArray(lights, header.lightCount);
+    std::vector<MaterialRecord> records;
+    readArray(records, header.materialCount);
+    RenderShapes shapes;
+    readArray(shapes.ctms, header.shapeCount);
+    std::vector<uint32_t> types;
+    readArray(types, header.shapeCount);
+    readArray(shapes.materials, header.shapeCount);
+    readArray(shapes.instanceLists, header.instanceListCount);
+    const char *strings = reinterpret_cast<const char *>(in);
+
+    std::vector<SceneMaterial> materials(header.materialCount);
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+        const MaterialRecord &record = records[i];
+        SceneMaterial &material = materials[i];
+        material.clear();
+        material.cAmbient = record.cAmbient;
+        material.cDiffuse = record.cDiffuse;
+        material.cSpecular = record.cSpecular;
+        material.cReflective = record.cReflective;
+        material.cTransparent = record.cTransparent;
+        material.cEmissive = record.cEmissive;
+        material.shininess = record.shininess;
+        material.ior = record.ior;
+        material.blend = record.blend;
+        if (!readMap(record.textureMap, strings, header.stringBytes, material.textureMap) ||
+            !readMap(record.bumpMap, strings, header.stringBytes, material.bumpMap)) {
+            return false;
+        }
+    }
+    shapes.types.resize(header.shapeCount);
+    for (uint32_t i = 0; i < header.shapeCount; i++) {
+        if (types[i] > uint32_t(PrimitiveType::PRIMITIVE_MESH) ||
+            shapes.materials[i] >= header.materialCount) {
+            return false;
+        }
+        shapes.types[i] = PrimitiveType(types[i]);
+    }
+    // The lists have to cover the shapes in order
+    uint32_t covered = 0;
+    for (const RenderShapes::InstanceList &list : shapes.instanceLists) {
+        if (list.first != covered || list.count == 0 || list.count > header.shapeCount - covered) {
+            return false;
+        }
+        covered += list.count;
+    }
+    if (covered != header.shapeCount) {
+        return false;
+    }
+
+    renderData.globalData = header.globalData;
+    renderData.cameraData = header.cameraData;
+    renderData.lights = std::move(lights);
+    renderData.materials = std::move(materials);
+    renderData.shapes = std::move(shapes);
+    return true;
+}
+
+bool SceneCache::store(const std::string &path, uint64_t sourceHash, uint64_t sourceSize,
+                       const RenderData &renderData) {
+    const RenderShapes &shapes = renderData.shapes;
+
+    std::string strings;
+    std::vector<MaterialRecord> records;
+    for (const SceneMaterial &material : renderData.materials) {
+        MaterialRecord record = {};
+        record.cAmbient = material.cAmbient;
+        record.cDiffuse = material.cDiffuse;
+        record.cSpecular = material.cSpecular;
+        record.cReflective = material.cReflective;
+        record.cTransparent = material.cTransparent;
+        record.cEmissive = material.cEmissive;
+        record.shininess = material.shininess;
+        record.ior = material.ior;
+        record.blend = material.blend;
+        record.textureMap = writeMap(material.textureMap, strings);
+        record.bumpMap = writeMap(material.bumpMap, strings);
+        records.push_back(record);
+    }
+    std::vector<uint32_t> types;
+    for (PrimitiveType type : shapes.types) {
+        types.push_back(uint32_t(type));
+    }
+
+    SceneCacheHeader header = {};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.globalData = renderData.globalData;
+    header.cameraData = renderData.cameraData;
+    header.lightCount = uint32_t(renderData.lights.size());
+    header.materialCount = uint32_t(records.size());
+    header.shapeCount = uint32_t(shapes.size());
+    header.instanceListCount = uint32_t(shapes.instanceLists.size());
+    header.stringBytes = uint32_t(strings.size());
+
+    std::vector<unsigned char> buffer(cacheSize(header));
+    unsigned char *out = buffer.data();
+    auto write = [&out](const void *data, size_t size) {
+        std::memcpy(out, data, size);
+        out += size;
+    };
+    write(&header, sizeof(header));
+    write(renderData.lights.data(), renderData.lights.size() * sizeof(SceneLightData));
+    write(records.data(), records.size() * sizeof(MaterialRecord));
+    write(shapes.ctms.data(), shapes.size() * sizeof(glm::mat4));
+    write(types.data(), types.size() * sizeof(uint32_t));
+    write(shapes.materials.data(), shapes.size() * sizeof(uint32_t));
+    write(shapes.instanceLists.data(),
+          shapes.instanceLists.size() * sizeof(RenderShapes::InstanceList));
+    write(strings.data(), strings.size());
+
+    // Written under a temporary name, so a crash never leaves a truncated
+    // cache behind
+    std::string temporaryPath = path + ".tmp";
+    FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to write " << temporaryPath << std::endl;
+        return false;
+    }
+    bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    written = std::fclose(file) == 0 && written;
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write " << path << std::endl;
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
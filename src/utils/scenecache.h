@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct RenderData;
+
+// Compiled form of a parsed scene, written next to its scenefile so later
+// loads skip the JSON parse and the scene graph. The file holds the
+// flattened scene as it is in RenderData: global and camera data, lights,
+// the material table, then the shape arrays and instance lists. It is read
+// through a memory mapping and the arrays are copied straight out of it. A
+// cache is only used if it was compiled from a scenefile with the same size
+// and content hash.
+class SceneCache {
+public:
+    // The path of the cache for the scenefile at path
+    static std::string cachePath(const std::string &scenePath);
+
+    // Hash of the scenefile contents the cache is validated against
+    static uint64_t hashFile(const unsigned char *data, size_t size);
+
+    // Fill renderData from the cache at path. Leaves renderData unchanged
+    // and returns false if the cache is missing, stale or damaged.
+    static bool load(const std::string &path, uint64_t sourceHash, uint64_t sourceSize,
+                     RenderData &renderData);
+
+    static bool store(const std::string &path, uint64_t sourceHash, uint64_t sourceSize,
+                      const RenderData &renderData);
+};
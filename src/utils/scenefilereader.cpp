@@ -24,33 +24,9 @@ ScenefileReader::ScenefileReader(const std::string &name) {
     memset(&m_cameraData, 0, sizeof(SceneCameraData));
     memset(&m_globalData, 0, sizeof(SceneGlobalData));
 
-    m_root = new SceneNode;
+    m_root = m_arena.create<SceneNode>();
 
     m_templates.clear();
-    m_nodes.clear();
-
-    m_nodes.push_back(m_root);
-}
-
-ScenefileReader::~ScenefileReader() {
-    // Delete all Scene Nodes
-    for (unsigned int node = 0; node < m_nodes.size(); node++) {
-        for (size_t i = 0; i < (m_nodes[node])->transformations.size(); i++)
-        {
-            delete (m_nodes[node])->transformations[i];
-        }
-        for (size_t i = 0; i < (m_nodes[node])->primitives.size(); i++)
-        {
-            delete (m_nodes[node])->primitives[i];
-        }
-        (m_nodes[node])->transformations.clear();
-        (m_nodes[node])->primitives.clear();
-        (m_nodes[node])->children.clear();
-        delete m_nodes[node];
-    }
-
-    m_nodes.clear();
-    m_templates.clear();
 }
 
 SceneGlobalData ScenefileReader::getGlobalData() const {
@@ -220,7 +196,7 @@ bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *no
     }
 
     // Create a default light
-    SceneLight *light = new SceneLight();
+    SceneLight *light = m_arena.create<SceneLight>();
     memset(light, 0, sizeof(SceneLight));
     node->lights.push_back(light);
 
@@ -566,8 +542,7 @@ bool ScenefileReader::parseTemplateGroupData(const QJsonObject &templateGroup) {
         std::cout << "templateGroups cannot have the same" << std::endl;
     }
 
-    SceneNode *templateNode = new SceneNode;
-    m_nodes.push_back(templateNode);
+    SceneNode *templateNode = m_arena.create<SceneNode>();
     m_templates[templateGroup["name"].toString().toStdString()] = templateNode;
 
     return parseGroupData(templateGroup, templateNode);
@@ -604,7 +579,7 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             return false;
         }
 
-        SceneTransformation *translation = new SceneTransformation();
+        SceneTransformation *translation = m_arena.create<SceneTransformation>();
         translation->type = TransformationType::TRANSFORMATION_TRANSLATE;
         translation->translate.x = translateArray[0].toDouble();
         translation->translate.y = translateArray[1].toDouble();
@@ -630,7 +605,7 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             return false;
         }
 
-        SceneTransformation *rotation = new SceneTransformation();
+        SceneTransformation *rotation = m_arena.create<SceneTransformation>();
         rotation->type = TransformationType::TRANSFORMATION_ROTATE;
         rotation->rotate.x = rotateArray[0].toDouble();
         rotation->rotate.y = rotateArray[1].toDouble();
@@ -657,7 +632,7 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             return false;
         }
 
-        SceneTransformation *scale = new SceneTransformation();
+        SceneTransformation *scale = m_arena.create<SceneTransformation>();
         scale->type = TransformationType::TRANSFORMATION_SCALE;
         scale->scale.x = scaleArray[0].toDouble();
         scale->scale.y = scaleArray[1].toDouble();
@@ -679,7 +654,7 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
             return false;
         }
 
-        SceneTransformation *matrixTransformation = new SceneTransformation();
+        SceneTransformation *matrixTransformation = m_arena.create<SceneTransformation>();
         matrixTransformation->type = TransformationType::TRANSFORMATION_MATRIX;
 
         float *matrixPtr = glm::value_ptr(matrixTransformation->matrix);
@@ -789,8 +764,7 @@ bool ScenefileReader::parseGroups(const QJsonValue &groups, SceneNode *parent) {
             }
         }
 
-        SceneNode *node = new SceneNode;
-        m_nodes.push_back(node);
+        SceneNode *node = m_arena.create<SceneNode>();
         parent->children.push_back(node);
 
         if (!parseGroupData(group.toObject(), node)) {
@@ -831,7 +805,7 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
     std::string primType = prim["type"].toString().toStdString();
 
     // Default primitive
-    ScenePrimitive *primitive = new ScenePrimitive();
+    ScenePrimitive *primitive = m_arena.create<ScenePrimitive>();
     SceneMaterial &mat = primitive->material;
     mat.clear();
     primitive->type = PrimitiveType::PRIMITIVE_CUBE;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "arena.h"
 #include "scenedata.h"
 
 #include <vector>
@@ -14,9 +15,6 @@ public:
     // Create a ScenefileReader, passing it the scene file.
     ScenefileReader(const std::string &filename);
 
-    // Clean up all data for the scene
-    ~ScenefileReader();
-
     // Parse the XML scene file. Returns false if scene is invalid.
     bool readJSON();
 
@@ -45,6 +43,8 @@ private:
     SceneGlobalData m_globalData;
     SceneCameraData m_cameraData;
 
+    // Every node, transformation, primitive and light of the scene graph,
+    // freed together with the reader
+    Arena m_arena;
     SceneNode *m_root;
-    std::vector<SceneNode *> m_nodes;
 };
@@ -1,35 +1,196 @@
 #include "sceneparser.h"
+#include "mappedfile.h"
+#include "scenecache.h"
 #include "scenefilereader.h"
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <unordered_map>
+
+void RenderShapes::clear() {
+    ctms.clear();
+    types.clear();
+    materials.clear();
+    instanceLists.clear();
+    meshes.clear();
+    lods.clear();
+    visible.clear();
+}
+
+// Indices of the materials in RenderData::materials. Primitives reused
+// through templates are looked up by address; others are compared by value,
+// since scenes tend to give many primitives the same material.
+class SceneParser::MaterialTable {
+public:
+    explicit MaterialTable(std::vector<SceneMaterial> &materials) : m_materials(materials) {}
+
+    uint32_t index(const ScenePrimitive *primitive) {
+        auto known = m_byPrimitive.find(primitive);
+        if (known != m_byPrimitive.end()) {
+            return known->second;
+        }
+        const SceneMaterial &material = primitive->material;
+        size_t hash = hashMaterial(material);
+        uint32_t index = uint32_t(m_materials.size());
+        auto range = m_byHash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (equal(m_materials[it->second], material)) {
+                index = it->second;
+                break;
+            }
+        }
+        if (index == m_materials.size()) {
+            m_materials.push_back(material);
+            m_byHash.emplace(hash, index);
+        }
+        m_byPrimitive.emplace(primitive, index);
+        return index;
+    }
+
+private:
+    // The numeric fields, in declaration order
+    static void numbers(const SceneMaterial &m, float out[27]) {
+        const SceneColor *colors[] = {&m.cAmbient, &m.cDiffuse, &m.cSpecular,
+                                      &m.cReflective, &m.cTransparent, &m.cEmissive};
+        for (int i = 0; i < 6; i++) {
+            std::memcpy(&out[4 * i], colors[i], 4 * sizeof(float));
+        }
+        out[24] = m.shininess;
+        out[25] = m.ior;
+        out[26] = m.blend;
+    }
+
+    static bool equalMap(const SceneFileMap &a, const SceneFileMap &b) {
+        return a.isUsed == b.isUsed && (!a.isUsed || (a.filename == b.filename &&
+                                                      a.repeatU == b.repeatU &&
+                                                      a.repeatV == b.repeatV));
+    }
+
+    static bool equal(const SceneMaterial &a, const SceneMaterial &b) {
+        float x[27], y[27];
+        numbers(a, x);
+        numbers(b, y);
+        return std::equal(x, x + 27, y) && equalMap(a.textureMap, b.textureMap) &&
+               equalMap(a.bumpMap, b.bumpMap);
+    }
+
+    static size_t hashMaterial(const SceneMaterial &material) {
+        float x[27];
+        numbers(material, x);
+        size_t hash = std::hash<std::string>()(material.textureMap.filename);
+        for (float value : x) {
+            // +0 folds -0 into 0, which compares equal
+            hash = hash * 31 + std::hash<float>()(value + 0.0f);
+        }
+        return hash;
+    }
+
+    std::vector<SceneMaterial> &m_materials;
+    std::unordered_map<const ScenePrimitive *, uint32_t> m_byPrimitive;
+    std::unordered_multimap<size_t, uint32_t> m_byHash;
+};
 
 bool SceneParser::parse(std::string filepath, RenderData &renderData) {
-    ScenefileReader fileReader = ScenefileReader(filepath);
-    bool success = fileReader.readJSON();
-    if (!success) {
-        return false;
+    // A compiled copy of the scene skips the JSON parse, as long as it was
+    // compiled from this exact file. Resource paths have no cache.
+    bool cacheable = false;
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    std::string cachePath = SceneCache::cachePath(filepath);
+    std::error_code error;
+    if (std::filesystem::is_regular_file(filepath, error)) {
+        MappedFile source;
+        if (source.open(filepath)) {
+            cacheable = true;
+            sourceHash = SceneCache::hashFile(source.data(), source.size());
+            sourceSize = source.size();
+        }
     }
 
-    // TODO: Use your Lab 5 code here
+    if (cacheable && SceneCache::load(cachePath, sourceHash, sourceSize, renderData)) {
+        std::cout << "Loaded " << filepath << " from " << cachePath << std::endl;
+    } else {
+        ScenefileReader fileReader = ScenefileReader(filepath);
+        bool success = fileReader.readJSON();
+        if (!success) {
+            return false;
+        }
 
-    // Task 5: populate renderData with global data, and camera data;
-    renderData.globalData = fileReader.getGlobalData();
-    renderData.cameraData = fileReader.getCameraData();
-    // Task 6: populate renderData's list of primitives and their transforms.
-    //         This will involve traversing the scene graph, and we recommend you
-    //         create a helper function to do so!
+        renderData.globalData = fileReader.getGlobalData();
+        renderData.cameraData = fileReader.getCameraData();
 
-    SceneNode* rootNode = fileReader.getRootNode();
-    glm::mat4 identityMatrix = glm::mat4(1.0f); // Identity matrix as the initial parent transform
+        renderData.lights.clear();
+        renderData.materials.clear();
+        renderData.shapes.clear();
 
-    traverseSceneGraph(rootNode, identityMatrix, renderData);
+        SceneNode* rootNode = fileReader.getRootNode();
+        glm::mat4 identityMatrix = glm::mat4(1.0f); // Identity matrix as the initial parent transform
+
+        MaterialTable materials(renderData.materials);
+        std::vector<const ScenePrimitive *> sources;
+        traverseSceneGraph(rootNode, identityMatrix, renderData, materials, sources);
+        groupInstances(renderData.shapes, sources);
+
+        if (cacheable) {
+            SceneCache::store(cachePath, sourceHash, sourceSize, renderData);
+        }
+    }
+
+    // Chosen when the shapes are drawn
+    RenderShapes &shapes = renderData.shapes;
+    shapes.meshes.assign(shapes.size(), ShapeCache::Mesh());
+    shapes.lods.assign(shapes.size(), -1);
+    shapes.visible.assign(shapes.size(), 1);
 
     return true;
+}
 
+void SceneParser::groupInstances(RenderShapes &shapes,
+                                 const std::vector<const ScenePrimitive *> &sources) {
+    // Lists in the order their primitive is first used, so a scene without
+    // templates keeps its order
+    std::unordered_map<const ScenePrimitive *, uint32_t> listOf;
+    std::vector<RenderShapes::InstanceList> lists;
+    std::vector<uint32_t> shapeList(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        auto [found, added] = listOf.emplace(sources[i], uint32_t(lists.size()));
+        if (added) {
+            lists.push_back({0, 0});
+        }
+        shapeList[i] = found->second;
+        lists[found->second].count++;
+    }
+    uint32_t first = 0;
+    for (RenderShapes::InstanceList &list : lists) {
+        list.first = first;
+        first += list.count;
+    }
+
+    RenderShapes grouped;
+    grouped.ctms.resize(shapes.size());
+    grouped.types.resize(shapes.size());
+    grouped.materials.resize(shapes.size());
+    std::vector<uint32_t> next(lists.size());
+    for (size_t i = 0; i < lists.size(); i++) {
+        next[i] = lists[i].first;
+    }
+    for (size_t i = 0; i < shapes.size(); i++) {
+        uint32_t to = next[shapeList[i]]++;
+        grouped.ctms[to] = shapes.ctms[i];
+        grouped.types[to] = shapes.types[i];
+        grouped.materials[to] = shapes.materials[i];
+    }
+    grouped.instanceLists = std::move(lists);
+    shapes = std::move(grouped);
 }
-void SceneParser::traverseSceneGraph(SceneNode* node, const glm::mat4& parentTransform, RenderData& renderData) {
+
+void SceneParser::traverseSceneGraph(SceneNode* node, const glm::mat4& parentTransform,
+                                     RenderData& renderData, MaterialTable &materials,
+                                     std::vector<const ScenePrimitive *> &sources) {
     if (!node) return;
 
     // Start with the parent's transformation
@@ -86,17 +247,18 @@ void SceneParser::traverseSceneGraph(SceneNode* node, const glm::mat4& parentTra
         renderData.lights.push_back(lightData);
     }
 
-    // Process the primitives at this node
+    // Process the primitives at this node. Mesh files are not loaded, so
+    // their file names are left behind.
+    RenderShapes &shapes = renderData.shapes;
     for (const ScenePrimitive* primitive : node->primitives) {
-        RenderShapeData shapeData;
-        shapeData.primitive = *primitive; // Copy the primitive data
-        shapeData.ctm = currentTransform; // Set the cumulative transformation matrix
-
-        renderData.shapes.push_back(shapeData);
+        shapes.ctms.push_back(currentTransform);
+        shapes.types.push_back(primitive->type);
+        shapes.materials.push_back(materials.index(primitive));
+        sources.push_back(primitive);
     }
 
     // Recursively traverse child nodes
     for (SceneNode* child : node->children) {
-        traverseSceneGraph(child, currentTransform, renderData);
+        traverseSceneGraph(child, currentTransform, renderData, materials, sources);
     }
 }
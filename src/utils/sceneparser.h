@@ -2,23 +2,38 @@
 
 
 #include "scenedata.h"
+#include "shapecache.h"
 #include <vector>
 #include <string>
 #include <GL/glew.h>
 
-// Struct which contains data for a single primitive, to be used for rendering
-struct RenderShapeData {
-    ScenePrimitive primitive;
-    glm::mat4 ctm; // the cumulative transformation matrix
+// The primitives of a scene as parallel arrays, one entry per shape, so
+// per-frame loops over shapes read contiguous memory
+struct RenderShapes {
+    // Consecutive shapes drawn from the same primitive: every use of a
+    // primitive in a template group, or a single shape elsewhere. They
+    // share the primitive's type and material and only differ in their CTM,
+    // so they can be drawn as instances of one mesh.
+    struct InstanceList {
+        uint32_t first;
+        uint32_t count;
+    };
 
-    GLuint VAO = 0;
-    GLuint VBO = 0;
-    GLuint EBO = 0;
+    std::vector<glm::mat4> ctms; // the cumulative transformation matrices
+    std::vector<PrimitiveType> types;
+    std::vector<uint32_t> materials; // indices into RenderData::materials
+    std::vector<InstanceList> instanceLists; // covering the shapes in order
 
-    size_t indexCount = 0;
-    size_t vertexCount = 0;
-    bool hasIndices = false;
+    // The tessellation and its level of detail, set by LevelOfDetail; -1
+    // until the shape has been drawn
+    std::vector<ShapeCache::Mesh> meshes;
+    std::vector<int> lods;
+    // Whether the shape is in the view frustum, set by ShapeBvh each frame
+    std::vector<uint8_t> visible;
 
+    size_t size() const { return types.size(); }
+    bool empty() const { return types.empty(); }
+    void clear();
 };
 
 // Struct which contains all the data needed to render a scene
@@ -27,7 +42,9 @@ struct RenderData {
     SceneCameraData cameraData;
 
     std::vector<SceneLightData> lights;
-    std::vector<RenderShapeData> shapes;
+    // Every distinct material in the scene, once
+    std::vector<SceneMaterial> materials;
+    RenderShapes shapes;
 };
 
 class SceneParser {
@@ -37,5 +54,16 @@ public:
     // @param renderData  On return, this will contain the metadata of the loaded scene.
     // @return            A boolean value indicating whether the parse was successful.
     static bool parse(std::string filepath, RenderData &renderData);
-    static void traverseSceneGraph(SceneNode* node, const glm::mat4& parentTransform, RenderData& renderData);
+
+private:
+    class MaterialTable;
+    // Appends every shape below node to shapes, along with the primitive it
+    // was drawn from
+    static void traverseSceneGraph(SceneNode* node, const glm::mat4& parentTransform,
+                                   RenderData& renderData, MaterialTable &materials,
+                                   std::vector<const ScenePrimitive *> &sources);
+    // Reorder the shapes so uses of the same primitive are adjacent, and
+    // record them as instance lists
+    static void groupInstances(RenderShapes &shapes,
+                               const std::vector<const ScenePrimitive *> &sources);
 };
@@ -8,16 +8,50 @@
 #include <QFile>
 #include <QTextStream>
 #include <iostream>
+#include <string>
 
 class ShaderLoader{
 public:
-    static GLuint createShaderProgram(const char * vertex_file_path, const char * fragment_file_path){
+    // defines is inserted into the fragment shader right after its #version
+    // line, e.g. "#define FILTER_BLUR\n", to compile one variant of it
+    static GLuint createShaderProgram(const char * vertex_file_path, const char * fragment_file_path,
+                                      const std::string &defines = std::string()){
+        return createProgramFromSource(readShader(vertex_file_path),
+                                       readShader(fragment_file_path, defines));
+    }
+
+    // Read a shader file, with defines inserted after its #version line
+    static std::string readShader(const char *filepath, const std::string &defines = std::string()){
+        std::string code;
+        QString filepathStr = QString(filepath);
+        QFile file(filepathStr);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QTextStream stream(&file);
+            code = stream.readAll().toStdString();
+        }else{
+            throw std::runtime_error(std::string("Failed to open shader: ")+filepath);
+        }
+        if (!defines.empty()) {
+            // #version has to stay the first line
+            size_t lineEnd = code.find('\n');
+            code.insert(lineEnd == std::string::npos ? code.size() : lineEnd + 1, defines);
+        }
+        return code;
+    }
+
+    // Compile and link a program. With retrievable set, the driver is asked
+    // to keep the linked binary for glGetProgramBinary.
+    static GLuint createProgramFromSource(const std::string &vertexCode, const std::string &fragmentCode,
+                                          bool retrievable = false){
         // Create and compile the shaders.
-        GLuint vertexShaderID = createShader(GL_VERTEX_SHADER, vertex_file_path);
-        GLuint fragmentShaderID = createShader(GL_FRAGMENT_SHADER, fragment_file_path);
+        GLuint vertexShaderID = createShader(GL_VERTEX_SHADER, vertexCode);
+        GLuint fragmentShaderID = createShader(GL_FRAGMENT_SHADER, fragmentCode);
 
         // Link the shader program.
         GLuint programID = glCreateProgram();
+        if (retrievable) {
+            glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
         glAttachShader(programID, vertexShaderID);
         glAttachShader(programID, fragmentShaderID);
         glLinkProgram(programID);
@@ -45,20 +79,9 @@ public:
     }
 
 private:
-    static GLuint createShader(GLenum shaderType, const char *filepath){
+    static GLuint createShader(GLenum shaderType, const std::string &code){
         GLuint shaderID = glCreateShader(shaderType);
 
-        // Read shader file.
-        std::string code;
-        QString filepathStr = QString(filepath);
-        QFile file(filepathStr);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream stream(&file);
-            code = stream.readAll().toStdString();
-        }else{
-            throw std::runtime_error(std::string("Failed to open shader: ")+filepath);
-        }
-
         // Compile shader code.
         const char *codePtr = code.c_str();
         glShaderSource(shaderID, 1, &codePtr, nullptr); // Assumes code is null terminated
@@ -0,0 +1,144 @@
+#include "shapebvh.h"
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Shapes per leaf
+const uint32_t leafSize = 4;
+
+// The world box of a shape: the unit cube through its CTM, as a center and
+// half extents
+void shapeBox(const glm::mat4 &ctm, glm::vec3 &center, glm::vec3 &extent) {
+    center = glm::vec3(ctm[3]);
+    extent = 0.5f * (glm::abs(glm::vec3(ctm[0])) + glm::abs(glm::vec3(ctm[1])) +
+                     glm::abs(glm::vec3(ctm[2])));
+}
+
+// Test a box against the planes in mask. Returns false if it is outside
+// one of them, otherwise drops the planes it is entirely inside from mask.
+bool testBox(const glm::vec4 planes[6], const glm::vec3 &center, const glm::vec3 &extent,
+             uint32_t &mask) {
+    for (int p = 0; p < 6; p++) {
+        if (!(mask & (1u << p))) {
+            continue;
+        }
+        glm::vec3 normal = glm::vec3(planes[p]);
+        float distance = glm::dot(normal, center) + planes[p].w;
+        float radius = glm::dot(glm::abs(normal), extent);
+        if (distance + radius < 0.0f) {
+            return false;
+        }
+        if (distance - radius >= 0.0f) {
+            mask &= ~(1u << p);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void ShapeBvh::build(const RenderShapes &shapes) {
+    m_nodes.clear();
+    m_shapes.resize(shapes.size());
+    m_centers.resize(shapes.size());
+    m_extents.resize(shapes.size());
+    for (uint32_t i = 0; i < shapes.size(); i++) {
+        m_shapes[i] = i;
+        shapeBox(shapes.ctms[i], m_centers[i], m_extents[i]);
+    }
+    if (!shapes.empty()) {
+        m_nodes.reserve(2 * shapes.size() / leafSize + 1);
+        buildNode(0, uint32_t(shapes.size()));
+    }
+    m_centers.clear();
+    m_extents.clear();
+}
+
+uint32_t ShapeBvh::buildNode(uint32_t first, uint32_t count) {
+    uint32_t index = uint32_t(m_nodes.size());
+    m_nodes.push_back(Node());
+
+    glm::vec3 min(INFINITY), max(-INFINITY);
+    glm::vec3 centerMin(INFINITY), centerMax(-INFINITY);
+    for (uint32_t i = first; i < first + count; i++) {
+        const glm::vec3 &center = m_centers[m_shapes[i]];
+        const glm::vec3 &extent = m_extents[m_shapes[i]];
+        min = glm::min(min, center - extent);
+        max = glm::max(max, center + extent);
+        centerMin = glm::min(centerMin, center);
+        centerMax = glm::max(centerMax, center);
+    }
+
+    uint32_t right = 0;
+    if (count > leafSize) {
+        glm::vec3 spread = centerMax - centerMin;
+        int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+        uint32_t half = count / 2;
+        std::nth_element(m_shapes.begin() + first, m_shapes.begin() + first + half,
+                         m_shapes.begin() + first + count, [this, axis](uint32_t a, uint32_t b) {
+                             return m_centers[a][axis] < m_centers[b][axis];
+                         });
+        buildNode(first, half);
+        right = buildNode(first + half, count - half);
+    }
+    m_nodes[index] = {min, max, first, count, right};
+    return index;
+}
+
+size_t ShapeBvh::cull(RenderShapes &shapes, const Camera &camera) const {
+    std::fill(shapes.visible.begin(), shapes.visible.end(), 0);
+    if (m_nodes.empty()) {
+        return 0;
+    }
+
+    // The frustum planes from the rows of the view projection matrix,
+    // pointing inwards: left, right, bottom, top, near, far
+    glm::mat4 viewProjection = camera.projectionMatrix * camera.viewMatrix;
+    glm::mat4 rows = glm::transpose(viewProjection);
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    };
+
+    size_t visible = 0;
+    // Nodes to visit, with the planes they still have to be tested against
+    struct Entry {
+        uint32_t node;
+        uint32_t planeMask;
+    };
+    Entry stack[64];
+    int depth = 0;
+    stack[depth++] = {0, 0x3f};
+    while (depth > 0) {
+        Entry entry = stack[--depth];
+        const Node &node = m_nodes[entry.node];
+        uint32_t mask = entry.planeMask;
+        if (!testBox(planes, 0.5f * (node.min + node.max), 0.5f * (node.max - node.min), mask)) {
+            continue;
+        }
+        if (mask == 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                shapes.visible[m_shapes[i]] = 1;
+            }
+            visible += node.count;
+        } else if (!node.right) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                glm::vec3 center, extent;
+                shapeBox(shapes.ctms[m_shapes[i]], center, extent);
+                uint32_t shapeMask = mask;
+                if (testBox(planes, center, extent, shapeMask)) {
+                    shapes.visible[m_shapes[i]] = 1;
+                    visible++;
+                }
+            }
+        } else {
+            stack[depth++] = {node.right, mask};
+            stack[depth++] = {entry.node + 1, mask};
+        }
+    }
+    return visible;
+}
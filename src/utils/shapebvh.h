@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "sceneparser.h"
+
+class Camera;
+
+// Bounding volume hierarchy over the world-space boxes of the scene shapes,
+// used to skip the shapes outside the view frustum. Every unit primitive
+// fits in the cube from -0.5 to 0.5, so a shape's box is that cube
+// transformed by its CTM. The tree is split at the median of the longest
+// axis until a node holds a few shapes, and is culled top down: a node
+// outside a frustum plane drops its whole subtree, and a node inside a plane
+// is not tested against it again below, so a subtree entirely on screen is
+// accepted without visiting it. Shapes in leaves that straddle a plane are
+// tested one by one. Scene shapes do not move once loaded, so the tree is
+// only built when the scene changes.
+class ShapeBvh {
+public:
+    // Build the tree over the shapes of a new scene
+    void build(const RenderShapes &shapes);
+
+    // Set shapes.visible for the camera's frustum. Returns the number of
+    // visible shapes.
+    size_t cull(RenderShapes &shapes, const Camera &camera) const;
+
+private:
+    struct Node {
+        glm::vec3 min;
+        glm::vec3 max;
+        uint32_t first; // into m_shapes
+        uint32_t count;
+        uint32_t right; // second child, or 0 for a leaf; the first is next
+    };
+
+    uint32_t buildNode(uint32_t first, uint32_t count);
+
+    std::vector<Node> m_nodes; // depth first, root first
+    std::vector<uint32_t> m_shapes; // shape indices, in leaf order
+    // Shape boxes by shape, while building
+    std::vector<glm::vec3> m_centers;
+    std::vector<glm::vec3> m_extents;
+};
@@ -0,0 +1,135 @@
+#include "shapecache.h"
+#include "cone.h"
+#include "cube.h"
+#include "cylinder.h"
+#include "meshindexer.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Floats per vertex: position and normal
+const int vertexFloats = 6;
+
+} // namespace
+
+ShapeCache::Mesh ShapeCache::mesh(PrimitiveType type, int param1, int param2) {
+    // A cube only has one parameter, so every param2 shares its mesh
+    Key key = {type, param1, type == PrimitiveType::PRIMITIVE_CUBE ? 0 : param2};
+    auto found = m_meshes.find(key);
+    if (found != m_meshes.end()) {
+        return found->second;
+    }
+
+    std::vector<float> triangles;
+    switch (type) {
+    case PrimitiveType::PRIMITIVE_CUBE: {
+        Cube cube;
+        cube.updateParams(param1);
+        triangles = cube.generateShape();
+        break;
+    }
+    case PrimitiveType::PRIMITIVE_CONE: {
+        Cone cone;
+        cone.updateParams(param1, param2);
+        triangles = cone.generateShape();
+        break;
+    }
+    case PrimitiveType::PRIMITIVE_CYLINDER: {
+        Cylinder cylinder;
+        cylinder.updateParams(param1, param2);
+        triangles = cylinder.generateShape();
+        break;
+    }
+    case PrimitiveType::PRIMITIVE_SPHERE: {
+        Sphere sphere;
+        sphere.updateParams(param1, param2);
+        triangles = sphere.generateShape();
+        break;
+    }
+    case PrimitiveType::PRIMITIVE_MESH:
+        break;
+    }
+    IndexedMesh indexed = indexTriangles(triangles, vertexFloats);
+    size_t vertexCount = indexed.vertices.size() / vertexFloats;
+
+    Mesh mesh;
+    mesh.baseVertex = GLint(m_vertices.size() / vertexFloats);
+    mesh.indexCount = GLsizei(indexed.indices.size());
+    m_vertices.insert(m_vertices.end(), indexed.vertices.begin(), indexed.vertices.end());
+    if (vertexCount <= 65536) {
+        mesh.indexType = GL_UNSIGNED_SHORT;
+        mesh.indexOffset = m_indices.size();
+        m_indices.resize(m_indices.size() + indexed.indices.size() * sizeof(uint16_t));
+        uint16_t *out = reinterpret_cast<uint16_t *>(&m_indices[mesh.indexOffset]);
+        for (uint32_t index : indexed.indices) {
+            *out++ = uint16_t(index);
+        }
+    } else {
+        mesh.indexType = GL_UNSIGNED_INT;
+        // 32-bit indices have to be 4-byte aligned in the buffer
+        m_indices.resize((m_indices.size() + 3) & ~size_t(3));
+        mesh.indexOffset = m_indices.size();
+        m_indices.resize(m_indices.size() + indexed.indices.size() * sizeof(uint32_t));
+        std::memcpy(&m_indices[mesh.indexOffset], indexed.indices.data(),
+                    indexed.indices.size() * sizeof(uint32_t));
+    }
+    m_meshes.emplace(key, mesh);
+    return mesh;
+}
+
+void ShapeCache::uploadTail(GLenum target, Buffer &buffer, const void *data, size_t size) {
+    if (size > buffer.capacity) {
+        // Grown geometrically, so adding a tessellation rarely copies the
+        // whole buffer again
+        buffer.capacity = std::max(size, 2 * buffer.capacity);
+        glBufferData(target, buffer.capacity, nullptr, GL_STATIC_DRAW);
+        buffer.uploaded = 0;
+    }
+    if (size > buffer.uploaded) {
+        glBufferSubData(target, buffer.uploaded, size - buffer.uploaded,
+                        static_cast<const unsigned char *>(data) + buffer.uploaded);
+        buffer.uploaded = size;
+    }
+}
+
+void ShapeCache::upload() {
+    size_t vertexBytes = m_vertices.size() * sizeof(float);
+    if (m_vbo.uploaded == vertexBytes && m_ebo.uploaded == m_indices.size()) {
+        return;
+    }
+    if (!m_vao) {
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_vbo.id);
+        glGenBuffers(1, &m_ebo.id);
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo.id);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexFloats * sizeof(GLfloat), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexFloats * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo.id);
+    }
+
+    // The element buffer binding belongs to the vertex array
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo.id);
+    uploadTail(GL_ARRAY_BUFFER, m_vbo, m_vertices.data(), vertexBytes);
+    uploadTail(GL_ELEMENT_ARRAY_BUFFER, m_ebo, m_indices.data(), m_indices.size());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void ShapeCache::finish() {
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo.id);
+    glDeleteBuffers(1, &m_ebo.id);
+    m_vao = 0;
+    m_vbo = Buffer();
+    m_ebo = Buffer();
+    m_meshes.clear();
+    m_vertices.clear();
+    m_indices.clear();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "scenedata.h"
+
+// Tessellations of the scene primitives, shared by every shape that uses
+// them. Each (type, param1, param2) is generated once, indexed by
+// indexTriangles, and appended to one vertex and one index buffer, and
+// shapes draw their range of them through one vertex array, so a scene of a
+// hundred identical spheres stores and uploads a single sphere. Vertices
+// are interleaved position and normal, as default.vert expects. Indices are
+// relative to the mesh's base vertex and 16 bits wide unless the mesh has
+// more vertices than that can address. Meshes stay cached when the scene
+// changes.
+class ShapeCache {
+public:
+    // Ranges of the shared buffers holding one tessellation
+    struct Mesh {
+        GLint baseVertex = 0;
+        GLsizei indexCount = 0;
+        GLenum indexType = GL_UNSIGNED_SHORT;
+        size_t indexOffset = 0; // in bytes
+    };
+
+    // The tessellation of type at these parameters, generated on first use.
+    // Geometry generated since the last upload() is not in the buffer yet.
+    // Meshes from files are not supported and come back empty.
+    Mesh mesh(PrimitiveType type, int param1, int param2);
+
+    // Copy the meshes generated since the last call to the GPU. Requires a
+    // current GL context.
+    void upload();
+
+    GLuint vertexArray() const { return m_vao; }
+
+    // Draw mesh with vertexArray() bound
+    static void draw(const Mesh &mesh) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, mesh.indexType,
+                                 (void*)mesh.indexOffset, mesh.baseVertex);
+    }
+
+    // Draw instanceCount copies of mesh with vertexArray() bound
+    static void drawInstanced(const Mesh &mesh, GLsizei instanceCount) {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.indexCount, mesh.indexType,
+                                          (void*)mesh.indexOffset, instanceCount,
+                                          mesh.baseVertex);
+    }
+
+    size_t meshCount() const { return m_meshes.size(); }
+
+    // Release the GL objects and forget every mesh. Requires a current GL
+    // context.
+    void finish();
+
+private:
+    struct Key {
+        PrimitiveType type;
+        int param1;
+        int param2;
+        bool operator==(const Key &other) const {
+            return type == other.type && param1 == other.param1 && param2 == other.param2;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return (size_t(key.type) * 31 + size_t(key.param1)) * 1009 + size_t(key.param2);
+        }
+    };
+
+    std::unordered_map<Key, Mesh, KeyHash> m_meshes;
+    // Every mesh, in generation order
+    std::vector<float> m_vertices;
+    std::vector<unsigned char> m_indices; // mixed 16 and 32 bit
+
+    // Contents of m_vertices or m_indices mirrored in a GL buffer
+    struct Buffer {
+        GLuint id = 0;
+        size_t uploaded = 0; // bytes
+        size_t capacity = 0; // bytes
+    };
+    static void uploadTail(GLenum target, Buffer &buffer, const void *data, size_t size);
+
+    GLuint m_vao = 0;
+    Buffer m_vbo;
+    Buffer m_ebo;
+};
@@ -0,0 +1,50 @@
+#include "shapeinstances.h"
+#include "levelofdetail.h"
+
+void ShapeInstances::update(const RenderShapes &shapes) {
+    m_batches.clear();
+    m_shapes.clear();
+    for (const RenderShapes::InstanceList &list : shapes.instanceLists) {
+        uint32_t end = list.first + list.count;
+        if (list.count == 1) {
+            if (shapes.visible[list.first]) {
+                m_batches.push_back({shapes.meshes[list.first], shapes.materials[list.first],
+                                     uint32_t(m_shapes.size()), 1});
+                m_shapes.push_back(list.first);
+            }
+            continue;
+        }
+
+        // One batch per level in use; instances keep their order within it.
+        // The shapes of a list share a primitive, so a level is one mesh.
+        uint32_t counts[LevelOfDetail::levelCount] = {};
+        ShapeCache::Mesh meshes[LevelOfDetail::levelCount];
+        for (uint32_t i = list.first; i < end; i++) {
+            if (shapes.visible[i]) {
+                counts[shapes.lods[i]]++;
+                meshes[shapes.lods[i]] = shapes.meshes[i];
+            }
+        }
+        uint32_t next[LevelOfDetail::levelCount];
+        uint32_t first = uint32_t(m_shapes.size());
+        for (int level = 0; level < LevelOfDetail::levelCount; level++) {
+            next[level] = first;
+            if (counts[level]) {
+                m_batches.push_back({meshes[level], shapes.materials[list.first], first,
+                                     counts[level]});
+                first += counts[level];
+            }
+        }
+        m_shapes.resize(first);
+        for (uint32_t i = list.first; i < end; i++) {
+            if (shapes.visible[i]) {
+                m_shapes[next[shapes.lods[i]]++] = i;
+            }
+        }
+    }
+}
+
+void ShapeInstances::clear() {
+    m_batches.clear();
+    m_shapes.clear();
+}
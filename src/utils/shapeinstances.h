@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "sceneparser.h"
+#include "shapecache.h"
+
+// Splits the scene's instance lists into batches: visible shapes of one
+// list drawn with the same mesh. Every use of a template primitive shares
+// its material, so a batch is a run of identical meshes and materials that
+// only differ in their CTMs, and a template used a thousand times becomes
+// a handful of batches instead of a thousand shapes. RenderQueue orders and
+// draws the batches.
+class ShapeInstances {
+public:
+    struct Batch {
+        ShapeCache::Mesh mesh;
+        uint32_t material; // index into RenderData::materials
+        uint32_t first;    // into shapes()
+        uint32_t count;
+    };
+
+    // Batch the visible shapes by their current meshes
+    void update(const RenderShapes &shapes);
+
+    const std::vector<Batch> &batches() const { return m_batches; }
+    // Indices of the batched shapes, in batch order
+    const std::vector<uint32_t> &shapes() const { return m_shapes; }
+
+    void clear();
+
+private:
+    std::vector<Batch> m_batches;
+    std::vector<uint32_t> m_shapes;
+};
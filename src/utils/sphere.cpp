@@ -1,48 +1,70 @@
-#include "Sphere.h"
-#include <glm/glm.hpp>
+#include "sphere.h"
+#include "glm/ext/scalar_constants.hpp"
+
 #include <algorithm>
-#include "realtime.h"
-#include "glm/gtc/type_ptr.hpp"
-#include "utils/cube.h"
-#include "utils/sphere.h"
-#include "utils/cone.h"
-#include "utils/cylinder.h"
-
-#include "utils/shaderloader.h"
-#include <QCoreApplication>
-#include <QMouseEvent>
-#include <QKeyEvent>
-#include <iostream>
-#include "settings.h"
-#include <glm/gtx/string_cast.hpp>
-#include <Box2D/Box2D.h>
 
 void Sphere::updateParams(int param1, int param2) {
-    m_vertexData.clear();
-    m_param1 = std::max(3, param1); // Ensure at least 3 segments to form a polygon
-    m_param2 = param2; // Might not be used for a simple 2D circle
+    m_param1 = std::max(2, param1); // Latitude bands
+    m_param2 = std::max(3, param2); // Longitude wedges
     setVertexData();
 }
 
-void Sphere::setVertexData() {
-    m_vertexData.clear();
-    // We'll create a circle of radius 0.5f centered at (0,0)
-    float r = 0.5f;
-    int numSegments = m_param1;
-    float angleStep = 2.0f * glm::pi<float>() / numSegments;
-
-    // Insert center of the circle
-    insertVec2(m_vertexData, glm::vec2(0.0f, 0.0f));
-
-    // Insert the circle vertices around the center
-    for (int i = 0; i <= numSegments; i++) {
-        float angle = i * angleStep;
-        float x = r * cos(angle);
-        float y = r * sin(angle);
-        insertVec2(m_vertexData, glm::vec2(x, y));
+void Sphere::makeTile(glm::vec3 topLeft,
+                      glm::vec3 topRight,
+                      glm::vec3 bottomLeft,
+                      glm::vec3 bottomRight) {
+    // On a sphere centered at the origin the normal is the direction of the
+    // position
+    insertVec3(m_vertexData, topLeft);
+    insertVec3(m_vertexData, glm::normalize(topLeft));
+
+    insertVec3(m_vertexData, bottomLeft);
+    insertVec3(m_vertexData, glm::normalize(bottomLeft));
+
+    insertVec3(m_vertexData, bottomRight);
+    insertVec3(m_vertexData, glm::normalize(bottomRight));
+
+    insertVec3(m_vertexData, topLeft);
+    insertVec3(m_vertexData, glm::normalize(topLeft));
+
+    insertVec3(m_vertexData, bottomRight);
+    insertVec3(m_vertexData, glm::normalize(bottomRight));
+
+    insertVec3(m_vertexData, topRight);
+    insertVec3(m_vertexData, glm::normalize(topRight));
+}
+
+void Sphere::makeWedge(float currTheta, float nextTheta) {
+    const float PI = glm::pi<float>();
+    for (int i = 0; i < m_param1; ++i) {
+        float phi0 = PI * i / m_param1;
+        float phi1 = PI * (i + 1) / m_param1;
+
+        auto point = [this](float phi, float theta) {
+            return glm::vec3(m_radius * sin(phi) * sin(theta),
+                             m_radius * cos(phi),
+                             m_radius * sin(phi) * cos(theta));
+        };
+        makeTile(point(phi0, currTheta), point(phi0, nextTheta),
+                 point(phi1, currTheta), point(phi1, nextTheta));
     }
 }
 
-// For a 2D shape, we only need to insert vec2 positions.
-// No normals are required in a 2D pipeline, unless you have another reason to store them.
+void Sphere::makeSphere() {
+    const float PI = glm::pi<float>();
+    for (int i = 0; i < m_param2; ++i) {
+        makeWedge(2.0f * PI * i / m_param2, 2.0f * PI * (i + 1) / m_param2);
+    }
+}
 
+void Sphere::setVertexData() {
+    m_vertexData.clear();
+    makeSphere();
+}
+
+// Inserts a glm::vec3 into a vector of floats.
+void Sphere::insertVec3(std::vector<float> &data, glm::vec3 v) {
+    data.push_back(v.x);
+    data.push_back(v.y);
+    data.push_back(v.z);
+}
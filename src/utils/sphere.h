@@ -7,7 +7,7 @@ class Sphere
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+    const std::vector<float> &generateShape() const { return m_vertexData; }
 
 private:
     void insertVec3(std::vector<float> &data, glm::vec3 v);
@@ -23,8 +23,4 @@ private:
     float m_radius = 0.5;
     int m_param1;
     int m_param2;
-    void    insertVec2(std::vector<float> &data, glm::vec2 v) {
-        data.push_back(v.x);
-        data.push_back(v.y);
-    }
 };
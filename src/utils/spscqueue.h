@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fixed-capacity lock-free queue for exactly one producer thread and one
+// consumer thread. push() and pop() never block; they fail when the queue is
+// full or empty.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity = 0) : m_items(capacity) {}
+
+    // Resize the queue. Only valid while no other thread is using it.
+    void reset(size_t capacity) {
+        m_items.assign(capacity, T());
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+    }
+
+    // Producer side
+    bool push(const T &item) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == m_items.size()) {
+            return false;
+        }
+        m_items[head % m_items.size()] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T &item) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_items[tail % m_items.size()];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> m_items;
+    // Monotonic counts of pushed and popped items; kept on separate cache
+    // lines so the two threads do not contend
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
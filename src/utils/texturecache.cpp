@@ -0,0 +1,53 @@
+#include "texturecache.h"
+
+#include <QImage>
+#include <iostream>
+
+bool TextureCache::buildArray(const std::vector<QString> &paths, int layerSize) {
+    if (m_arrayTexture != 0) {
+        return true;
+    }
+
+    glGenTextures(1, &m_arrayTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrayTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerSize, layerSize, (GLsizei)paths.size(),
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    bool success = true;
+    for (int i = 0; i < (int)paths.size(); i++) {
+        QImage img;
+        if (!img.load(paths[i])) {
+            std::cerr << "Failed to load texture: " << paths[i].toStdString() << std::endl;
+            success = false;
+            continue;
+        }
+        // The planet images are all close to square; stretching them onto a
+        // common square layer keeps the circle texture coordinates unchanged.
+        img = img.convertToFormat(QImage::Format_RGBA8888)
+                  .scaled(layerSize, layerSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, layerSize, layerSize, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, img.constBits());
+        m_layers[paths[i]] = i;
+    }
+
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return success;
+}
+
+int TextureCache::layer(const QString &path) const {
+    auto it = m_layers.find(path);
+    return it == m_layers.end() ? -1 : it->second;
+}
+
+void TextureCache::clear() {
+    if (m_arrayTexture != 0) {
+        glDeleteTextures(1, &m_arrayTexture);
+        m_arrayTexture = 0;
+    }
+    m_layers.clear();
+}
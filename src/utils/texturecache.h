@@ -0,0 +1,35 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <QString>
+#include <unordered_map>
+#include <vector>
+
+// Owns the textures of the 2D scene. Images are decoded from the resource
+// system once and packed into a single mipmapped GL_TEXTURE_2D_ARRAY, so
+// rebuilding a scene only looks up layer indices and every textured body
+// samples the same texture object.
+class TextureCache {
+public:
+    // Decode the images and upload them as the layers of the array texture,
+    // each resized to layerSize x layerSize. Does nothing if the array has
+    // already been built. Requires a current GL context.
+    // @return  false if any image failed to load; that image gets no layer.
+    bool buildArray(const std::vector<QString> &paths, int layerSize);
+
+    // The layer holding the image at path, or -1 if it is not in the array.
+    int layer(const QString &path) const;
+
+    GLuint arrayTexture() const { return m_arrayTexture; }
+
+    // Delete the GL texture. Requires a current GL context.
+    void clear();
+
+private:
+    GLuint m_arrayTexture = 0;
+    std::unordered_map<QString, int> m_layers;
+};